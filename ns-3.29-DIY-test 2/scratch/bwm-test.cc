@@ -28,7 +28,13 @@ bool enQDCUsageTrace = true;
 bool enTenantActFSTrace = true;
 bool enUnitFlowAlcFSTrace = true;
 bool enUnitFlowUsageTrace = true;
+bool enBinaryTrace = false;
+double traceInterval = 0; //summarize the flow and queue disc class traces per interval in seconds, 0 to trace every change
+double traceSampleInterval = 0.01;
 uint32_t coordinatorNode = -1;
+std::string shardNodes = ""; //format: node1,node2,...
+std::string shardBounds = ""; //format: lastTenantId1,lastTenantId2,...
+std::string tenantReconfigFile = ""; //format: /line1 time tenantId /line2 x1,y1 x2,y2 or - /line3 host1,w1 host2,w2 or -
 
 //Global data structure
 NodeContainer nodes;
@@ -41,24 +47,50 @@ std::ofstream rttOutput;
 std::ofstream flowAlcFSOutput;
 std::ofstream flowUsageOutput;
 std::ofstream tenantActFSOutput;
-std::ofstream qdcUsageOutput;
-std::ofstream qdcRateOutput;
+std::ofstream qdcUsageOutput; //bytes dequeued per report epoch
+std::ofstream qdcRateOutput; //bps
+
+//Binary trace sink and its streams, used instead of the text streams with enBinaryTrace
+Ptr<BwmTraceSink> traceSink;
+uint32_t rxStream;
+uint32_t cwndStream;
+uint32_t rttStream;
+uint32_t flowAlcFSStream;
+uint32_t flowUsageStream;
+uint32_t tenantActFSStream;
+uint32_t qdcUsageStream;
+uint32_t qdcRateStream;
+
+//Interval aggregators of the flow and queue disc class traces, used with traceInterval
+Ptr<BwmTraceAggregator> flowAlcFSAggregator;
+Ptr<BwmTraceAggregator> flowUsageAggregator;
+Ptr<BwmTraceAggregator> qdcUsageAggregator;
+Ptr<BwmTraceAggregator> qdcRateAggregator;
 
 void 
 RttTrace (uint32_t flowId, Time oldValue, Time newValue)
 {
+  if (traceSink)
+    {
+      traceSink->Write (rttStream, Simulator::Now ().GetSeconds (), flowId, newValue.GetMicroSeconds ());
+      return;
+    }
   rttOutput << Simulator::Now ().GetSeconds () << ","
 	    << flowId << ","
-	    << newValue.GetMicroSeconds () << std::endl;
+	    << newValue.GetMicroSeconds () << "\n";
 }
 
 void
 CwndTrace (uint32_t flowId, uint32_t oldValue, uint32_t newValue)
 {
-
+  if (traceSink)
+    {
+      traceSink->Write (cwndStream, Simulator::Now ().GetSeconds (), flowId, newValue);
+      return;
+    }
   cwndOutput << Simulator::Now ().GetSeconds () << ","
              << flowId << ","
-             << newValue << std::endl;
+             << newValue << "\n";
 }
 
 void
@@ -81,11 +113,16 @@ RxTrace (Ptr<const Packet> packet, const TcpHeader& header, Ptr<const TcpSocketB
   packet->PeekPacketTag (tidTag);
   FlowIdTag fidTag;
   packet->PeekPacketTag (fidTag);
-  
+
+  if (traceSink)
+    {
+      traceSink->Write (rxStream, Simulator::Now ().GetSeconds (), tidTag.GetTenantId (), fidTag.GetFlowId (), packet->GetSize ());
+      return;
+    }
   rxOutput << Simulator::Now ().GetSeconds () << ","
            << tidTag.GetTenantId () << ","
            << fidTag.GetFlowId () << ","
-           << packet->GetSize () << std::endl;
+           << packet->GetSize () << "\n";
 
 }
 
@@ -112,7 +149,7 @@ UnitFlowAlcFSTrace (uint32_t traceId, double oldValue, double newValue)
 {
   flowAlcFSOutput << Simulator::Now ().GetSeconds () << ","
                   << traceId << ","
-                  << newValue << std::endl;
+                  << newValue << "\n";
 }
 
 void
@@ -120,7 +157,7 @@ UnitFlowUsageTrace (uint32_t traceId, double oldValue, double newValue)
 {
   flowUsageOutput << Simulator::Now ().GetSeconds () << ","
                   << traceId << ","
-                  << newValue << std::endl;
+                  << newValue << "\n";
 }
 
 void
@@ -128,28 +165,84 @@ TenantActFSTrace (uint32_t tenantId, double oldValue, double newValue)
 {
   tenantActFSOutput << Simulator::Now ().GetSeconds () << ","
                     << tenantId << ","
-                    << newValue << std::endl;
+                    << newValue << "\n";
 }
 
 void
-QDCRateTrace (uint32_t traceId, DataRate oldValue, DataRate newValue)
+QDCRateTrace (BwmQueueDiscClass *qDiscClass, DataRate oldValue, DataRate newValue)
 {
+  // queue disc classes are reused by later unit flows, so look up the current trace id
   qdcRateOutput << Simulator::Now ().GetSeconds () << ","
-                << traceId << ","
-                << (double)newValue.GetBitRate () << std::endl;
+                << qDiscClass->GetTraceId () << ","
+                << (double)newValue.GetBitRate () << "\n";
 }
 
 void
-QDCUsageTrace (uint32_t traceId, double oldValue, double newValue)
+QDCUsageTrace (BwmQueueDiscClass *qDiscClass, double oldValue, double newValue)
 {
   qdcUsageOutput << Simulator::Now ().GetSeconds () << ","
-                 << traceId << ","
-                 << newValue << std::endl;
+                 << qDiscClass->GetTraceId () << ","
+                 << newValue << "\n";
+}
+
+void
+SummaryTrace (std::ofstream *output, uint32_t stream, uint32_t id, double min, double max, double mean, double last)
+{
+  if (traceSink)
+    {
+      // the second id is the statistic: 0 min, 1 max, 2 mean, 3 last
+      double now = Simulator::Now ().GetSeconds ();
+      traceSink->Write (stream, now, id, 0, min);
+      traceSink->Write (stream, now, id, 1, max);
+      traceSink->Write (stream, now, id, 2, mean);
+      traceSink->Write (stream, now, id, 3, last);
+      return;
+    }
+  *output << Simulator::Now ().GetSeconds () << ","
+          << id << ","
+          << min << ","
+          << max << ","
+          << mean << ","
+          << last << "\n";
+}
+
+Ptr<BwmTraceAggregator>
+CreateAggregator (std::ofstream *output, uint32_t stream)
+{
+  Ptr<BwmTraceAggregator> aggregator = CreateObject<BwmTraceAggregator> ();
+  aggregator->SetAttribute ("Interval", TimeValue (Seconds (traceInterval)));
+  aggregator->SetAttribute ("SampleInterval", TimeValue (Seconds (std::min (traceSampleInterval, traceInterval))));
+  aggregator->TraceConnectWithoutContext ("Summary", MakeBoundCallback (SummaryTrace, output, stream));
+  return aggregator;
 }
 
 void
 UnitFlowCreateTrace (Ptr<UnitFlow> flow)
 {
+  if (traceInterval > 0)
+    {
+      if (enUnitFlowAlcFSTrace)
+        {
+          flowAlcFSAggregator->AddSource (flow, MakeCallback (&UnitFlow::GetAllocatedFS, flow), flow->GetTraceId ());
+        }
+      if (enUnitFlowUsageTrace)
+        {
+          flowUsageAggregator->AddSource (flow, MakeCallback (&UnitFlow::GetBandwidthUsage, flow), flow->GetTraceId ());
+        }
+      return;
+    }
+  if (traceSink)
+    {
+      if (enUnitFlowAlcFSTrace)
+        {
+          traceSink->ConnectDouble (flow, "AllocatedFairShare", flowAlcFSStream, flow->GetTraceId ());
+        }
+      if (enUnitFlowUsageTrace)
+        {
+          traceSink->ConnectDouble (flow, "Usage", flowUsageStream, flow->GetTraceId ());
+        }
+      return;
+    }
   if (enUnitFlowAlcFSTrace)
     {
       flow->TraceConnectWithoutContext ("AllocatedFairShare", MakeBoundCallback ( UnitFlowAlcFSTrace, flow->GetTraceId ()));
@@ -160,9 +253,27 @@ UnitFlowCreateTrace (Ptr<UnitFlow> flow)
     }
 }
 
+void
+UnitFlowRemoveTrace (Ptr<UnitFlow> flow)
+{
+  if (traceInterval > 0)
+    {
+      flowAlcFSAggregator->RemoveSources (flow);
+      flowUsageAggregator->RemoveSources (flow);
+    }
+}
+
 void
 TenantCreateTrace (Ptr<Tenant> tenant)
 {
+  if (traceSink)
+    {
+      if (enTenantActFSTrace)
+        {
+          traceSink->ConnectDouble (tenant, "ActualFairShare", tenantActFSStream, tenant->GetTenantId ());
+        }
+      return;
+    }
   if (enTenantActFSTrace)
     {
       tenant->TraceConnectWithoutContext ("ActualFairShare", MakeBoundCallback (TenantActFSTrace, tenant->GetTenantId ()));
@@ -172,13 +283,43 @@ TenantCreateTrace (Ptr<Tenant> tenant)
 void
 QueueDiscClassCreateTrace (Ptr<BwmQueueDiscClass> qDiscClass)
 {
+  // queue disc classes are reused by later unit flows, so look up the current trace id;
+  // the callbacks are stored in the class's own trace sources, so they must not hold a Ptr to it
+  BwmQueueDiscClass *rawClass = PeekPointer (qDiscClass);
+  Callback<uint32_t> traceId = MakeCallback (&BwmQueueDiscClass::GetTraceId, rawClass);
+  if (traceInterval > 0)
+    {
+      if (enQDCRateTrace)
+        {
+          qdcRateAggregator->AddDataRateSource (qDiscClass, MakeCallback (&BwmQueueDiscClass::GetRate, rawClass), traceId);
+        }
+      if (enQDCUsageTrace)
+        {
+          // GetUsage counts up from the last report and would sample a sawtooth,
+          // the closed epoch is what the per-change trace writes as well
+          qdcUsageAggregator->AddSource (qDiscClass, MakeCallback (&BwmQueueDiscClass::GetEpochUsage, rawClass), traceId);
+        }
+      return;
+    }
+  if (traceSink)
+    {
+      if (enQDCRateTrace)
+        {
+          traceSink->ConnectDataRate (qDiscClass, "Rate", qdcRateStream, traceId);
+        }
+      if (enQDCUsageTrace)
+        {
+          traceSink->ConnectDouble (qDiscClass, "Usage", qdcUsageStream, traceId);
+        }
+      return;
+    }
   if (enQDCRateTrace)
     {
-      qDiscClass->TraceConnectWithoutContext ("Rate", MakeBoundCallback (QDCRateTrace, qDiscClass->GetTraceId ()));
+      qDiscClass->TraceConnectWithoutContext ("Rate", MakeBoundCallback (QDCRateTrace, rawClass));
     }
   if (enQDCUsageTrace)
     {
-      qDiscClass->TraceConnectWithoutContext ("Usage", MakeBoundCallback (QDCUsageTrace, qDiscClass->GetTraceId ()));
+      qDiscClass->TraceConnectWithoutContext ("Usage", MakeBoundCallback (QDCUsageTrace, rawClass));
     }
 }
 
@@ -260,9 +401,32 @@ SetupTopology (const std::string &file, const std::string & tenantConfigFile)
   coordinator->SetAttribute("ProgressFactor",DoubleValue(0.15));
   coordinator->TraceConnectWithoutContext ("TenantCreate", MakeCallback (TenantCreateTrace));
   coordinator->TraceConnectWithoutContext ("UnitFlowCreate", MakeCallback (UnitFlowCreateTrace));
+  coordinator->TraceConnectWithoutContext ("UnitFlowRemove", MakeCallback (UnitFlowRemoveTrace));
+
+  //install shard coordinators, the coordinator above becomes the root
+  std::replace (shardNodes.begin (), shardNodes.end (), ',', ' ');
+  std::replace (shardBounds.begin (), shardBounds.end (), ',', ' ');
+  std::stringstream shardNodeStream (shardNodes);
+  std::stringstream shardBoundStream (shardBounds);
+  uint32_t shardNode, shardBound;
+  while (shardNodeStream >> shardNode && shardBoundStream >> shardBound)
+    {
+      NS_ASSERT_MSG (shardNode < nodes.GetN (), "Invalid shard node: " << shardNode);
+      Ptr<BwmCoordinator> shard = coordinatorFactory.Create<BwmCoordinator> ();
+      nodes.Get (shardNode)->AddApplication (shard);
+      shard->SetStartTime (Seconds (globalStartTime));
+      shard->SetStopTime (Seconds (globalStopTime));
+      shard->SetAttribute("ProgressFactor",DoubleValue(0.15));
+      coordinator->AddShard (shard, shardBound);
+    }
   coordinator->InputConfiguration (tenantConfigFile);
+  if (!tenantReconfigFile.empty ())
+    {
+      coordinator->InputReconfiguration (tenantReconfigFile);
+    }
 
   //setup switches and hosts
+  std::map<uint32_t, Ptr<BwmLocalAgent> > hostAgents;
   Ipv4AddressHelper ipv4 ("10.0.0.0", "255.255.255.0");
   NS_LOG_INFO ("Create channels");
   PointToPointHelper p2p;
@@ -277,6 +441,7 @@ SetupTopology (const std::string &file, const std::string & tenantConfigFile)
       p2p.SetChannelAttribute ("Delay", StringValue (linkDelay));
 
       NetDeviceContainer devices = p2p.Install (nodes.Get (src), nodes.Get (dst));
+      coordinator->AddLink (src, dst, DataRate (dataRate).GetBitRate ());
       
       /// queue disc should be added before IP address is assigned
       NS_LOG_INFO ("Install queue disc");
@@ -293,24 +458,34 @@ SetupTopology (const std::string &file, const std::string & tenantConfigFile)
           // auto tokenBucket = DynamicCast<TbfQueueDisc> (hostQueue.Get (0));
           // auto qdisc = DynamicCast<BwmQueueDisc> (tokenBucket->GetQueueDiscClass (0)->GetQueueDisc ());
 
-          //set up the local agent for the queue disc
-          Ptr<BwmLocalAgent> agent = agentFactory.Create<BwmLocalAgent> ();
-          qdisc->SetupLocalAgent (agent);
-          qdisc->TraceConnectWithoutContext ("FlowCreate", MakeCallback (QueueDiscClassCreateTrace));
-          agent->SetQueueDisc (qdisc);
-
-          //install the agent to the host
-          nodes.Get (src)->AddApplication (agent);
-          agent->SetStartTime (Seconds (globalStartTime));
-          agent->SetStopTime (Seconds (globalStopTime));
-          agent->SetCoordinator (coordinator);
-          agent->SetHostId (src);
-          if (enCAWC)
+          //set up the local agent for the queue disc, a host with several links has one agent for all its devices
+          auto agentIt = hostAgents.find (src);
+          if (agentIt != hostAgents.end ())
+            {
+              agentIt->second->AddQueueDisc (qdisc);
+              qdisc->SetupLocalAgent (agentIt->second);
+            }
+          else
             {
-              //if enable congestion-aware work-conserving mechanism, setup the ipv4 layer
-              NS_LOG_INFO ("Setup CAWC for Node " << src);
-              agent->SetupCAWC (nodes.Get (src)->GetObject<Ipv4> ());
+              Ptr<BwmLocalAgent> agent = agentFactory.Create<BwmLocalAgent> ();
+              hostAgents[src] = agent;
+              qdisc->SetupLocalAgent (agent);
+              agent->SetQueueDisc (qdisc);
+
+              //install the agent to the host
+              nodes.Get (src)->AddApplication (agent);
+              agent->SetStartTime (Seconds (globalStartTime));
+              agent->SetStopTime (Seconds (globalStopTime));
+              agent->SetCoordinator (coordinator);
+              agent->SetHostId (src);
+              if (enCAWC)
+                {
+                  //if enable congestion-aware work-conserving mechanism, setup the ipv4 layer
+                  NS_LOG_INFO ("Setup CAWC for Node " << src);
+                  agent->SetupCAWC (nodes.Get (src)->GetObject<Ipv4> ());
+                }
             }
+          qdisc->TraceConnectWithoutContext ("FlowCreate", MakeCallback (QueueDiscClassCreateTrace));
 
           //install switch queue
           TrafficControlHelper tch2;
@@ -451,6 +626,7 @@ main (int argc, char *argv[])
   cmd.AddValue ("flowFile", "Path to flow file", flowFile);
   cmd.AddValue ("bwmConfigFile", "Path to bwm configuration file", bwmConfigFile);
   cmd.AddValue ("tenantConfigFile", "Path to global configuration file", tenantConfigFile);
+  cmd.AddValue ("tenantReconfigFile", "Path to tenant changes applied during the simulation", tenantReconfigFile);
   cmd.AddValue ("tracePath", "Path to trace dir", tracePath);
   cmd.AddValue ("startTime", "Global start time", globalStartTime);
   cmd.AddValue ("stopTime", "Global stop time", globalStopTime);
@@ -460,30 +636,72 @@ main (int argc, char *argv[])
   cmd.AddValue ("enBwmTest", "Enable Bandwidth Manager Test", enBwmTest);
   cmd.AddValue ("enCAWC", "Enable Congestion Aware Work-Conserving Mechanism", enCAWC);
   cmd.AddValue ("coordinatorNode", "The node equipped with coordinator", coordinatorNode);
+  cmd.AddValue ("shardNodes", "Comma separated nodes equipped with shard coordinators", shardNodes);
+  cmd.AddValue ("shardBounds", "Comma separated largest tenant ids owned by each shard", shardBounds);
   cmd.AddValue ("enQDCRateTrace", "Enable Rtt Trace", enQDCRateTrace);
   cmd.AddValue ("enQDCUsageTrace", "Enable Rtt Trace", enQDCUsageTrace);
   cmd.AddValue ("enTenantActFSTrace", "Enable Rtt Trace", enTenantActFSTrace);
   cmd.AddValue ("enUnitFlowAlcFSTrace", "Enable Rtt Trace", enUnitFlowAlcFSTrace);
   cmd.AddValue ("enUnitFlowUsageTrace", "Enable Rtt Trace", enUnitFlowUsageTrace);
+  cmd.AddValue ("enBinaryTrace", "Write buffered binary traces (*.bin), convert them with bwm-trace-convert", enBinaryTrace);
+  cmd.AddValue ("traceInterval", "Summarize the flow and queue disc class traces as time,id,min,max,mean,last "
+                "every interval in seconds (queue disc class usage in bytes per report epoch), 0 to trace every change", traceInterval);
+  cmd.AddValue ("traceSampleInterval", "Time between two samples of a summarized trace in seconds", traceSampleInterval);
   cmd.Parse (argc, argv);
 
+  // open the traces first, tenants are created and traced while the topology is set up
+  if (enBinaryTrace)
+    {
+      traceSink = CreateObject<BwmTraceSink> ();
+      rxStream = traceSink->AddStream (tracePath + "/rx-trace.bin", 2, true);
+      cwndStream = traceSink->AddStream (tracePath + "/cwnd-trace.bin", 1, true);
+      rttStream = traceSink->AddStream (tracePath + "/rtt-trace.bin", 1, true);
+      // summaries are written as one record per statistic
+      uint32_t idNum = traceInterval > 0 ? 2 : 1;
+      flowAlcFSStream = traceSink->AddStream (tracePath + "/flow-alc-fs-trace.bin", idNum);
+      flowUsageStream = traceSink->AddStream (tracePath + "/flow-usage-trace.bin", idNum);
+      tenantActFSStream = traceSink->AddStream (tracePath + "/tenant-act-fs-trace.bin", 1);
+      qdcUsageStream = traceSink->AddStream (tracePath + "/qdc-usage-trace.bin", idNum);
+      qdcRateStream = traceSink->AddStream (tracePath + "/qdc-rate-trace.bin", idNum);
+      uint32_t streams[] = {rxStream, cwndStream, rttStream, flowAlcFSStream, flowUsageStream,
+                            tenantActFSStream, qdcUsageStream, qdcRateStream};
+      for (uint32_t stream : streams)
+        {
+          if (stream == (uint32_t)-1)
+            {
+              NS_LOG_WARN ("Cannot open trace files via " << tracePath);
+              return 0;
+            }
+        }
+    }
+  else
+    {
+      rxOutput.open (tracePath + "/rx-trace.txt");
+      if (rxOutput.fail())
+        {
+          NS_LOG_WARN ("Cannot open Rx trace file via " << tracePath);
+          return 0;
+        }
+      cwndOutput.open (tracePath + "/cwnd-trace.txt");
+      rttOutput.open (tracePath + "/rtt-trace.txt");
+      flowAlcFSOutput.open (tracePath + "/flow-alc-fs-trace.txt");
+      flowUsageOutput.open (tracePath + "/flow-usage-trace.txt");
+      tenantActFSOutput.open (tracePath + "/tenant-act-fs-trace.txt");
+      qdcUsageOutput.open (tracePath + "/qdc-usage-trace.txt");
+      qdcRateOutput.open (tracePath + "/qdc-rate-trace.txt");
+    }
+  if (traceInterval > 0)
+    {
+      flowAlcFSAggregator = CreateAggregator (&flowAlcFSOutput, flowAlcFSStream);
+      flowUsageAggregator = CreateAggregator (&flowUsageOutput, flowUsageStream);
+      qdcUsageAggregator = CreateAggregator (&qdcUsageOutput, qdcUsageStream);
+      qdcRateAggregator = CreateAggregator (&qdcRateOutput, qdcRateStream);
+    }
+
   ReadBwmConfig (bwmConfigFile);
   SetupTopology (topologyFile, tenantConfigFile);
   SetupApp (flowFile);
 
-  rxOutput.open (tracePath + "/rx-trace.txt");
-  if (rxOutput.fail())
-    {
-      NS_LOG_WARN ("Cannot open Rx trace file via " << tracePath);
-      return 0;
-    }
-  cwndOutput.open (tracePath + "/cwnd-trace.txt");
-  rttOutput.open (tracePath + "/rtt-trace.txt");
-  flowAlcFSOutput.open (tracePath + "/flow-alc-fs-trace.txt");
-  flowUsageOutput.open (tracePath + "/flow-usage-trace.txt");
-  tenantActFSOutput.open (tracePath + "/tenant-act-fs-trace.txt");
-  qdcUsageOutput.open (tracePath + "/qdc-usage-trace.txt");
-  qdcRateOutput.open (tracePath + "/qdc-rate-trace.txt");
 
   Config::SetDefault ("ns3::ConfigStore::Filename", StringValue (tracePath + "/config.txt"));
   Config::SetDefault ("ns3::ConfigStore::FileFormat", StringValue ("RawText"));
@@ -498,5 +716,9 @@ main (int argc, char *argv[])
   NS_LOG_INFO ("Simulation End");
 
   rxOutput.close ();
+  if (traceSink)
+    {
+      traceSink->Close ();
+    }
   return 0;
 }
@@ -0,0 +1,196 @@
+#include "ns3/core-module.h"
+#include "ns3/bandwidth-manager-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <utility>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BandwidthFunctionBench");
+
+/**
+ * The original vector-of-pairs bandwidth function with linear scans,
+ * kept here as the baseline of the comparison.
+ */
+class PairTableBandwidthFunction {
+public:
+  PairTableBandwidthFunction ()
+  {
+    AddVertex (0, 0);
+  }
+
+  void
+  AddVertex (double fairShare, double bandwidth)
+  {
+    m_vertexTable.push_back (std::make_pair (fairShare, bandwidth));
+  }
+
+  double
+  GetBandwidth (double fairShare) const
+  {
+    if (fairShare == BandwidthFunction::INF)
+      {
+        return m_vertexTable.back ().second;
+      }
+
+    for (auto it = m_vertexTable.begin (); it != m_vertexTable.end (); it++)
+      {
+        auto nextIt = it + 1;
+        if (it->first == fairShare)
+          {
+            if (nextIt != m_vertexTable.end () && nextIt->first == it->first)
+              {
+                return nextIt->second;
+              }
+            return it->second;
+          }
+        if (nextIt == m_vertexTable.end ())
+          {
+            return it->second;
+          }
+        if (fairShare < nextIt->first)
+          {
+            return it->second + ((fairShare - it->first) / (nextIt->first - it->first)) * (nextIt->second - it->second);
+          }
+      }
+    return 0.0;
+  }
+
+  double
+  GetFairShare (double bandwidth) const
+  {
+    if (bandwidth == BandwidthFunction::INF)
+      {
+        return BandwidthFunction::INF;
+      }
+
+    for (auto it = m_vertexTable.begin (); it != m_vertexTable.end (); it++)
+      {
+        if (it->second == bandwidth)
+          {
+            return it->first;
+          }
+        auto nextIt = it + 1;
+        if (nextIt == m_vertexTable.end ())
+          {
+            return BandwidthFunction::INF;
+          }
+        if (bandwidth < nextIt->second)
+          {
+            return it->first + ((bandwidth - it->second) / (nextIt->second - it->second)) * (nextIt->first - it->first);
+          }
+      }
+    return 0.0;
+  }
+
+  double
+  GetNextInterestingPointByFS (double currentFairShare) const
+  {
+    for (auto it : m_vertexTable)
+      {
+        if (it.first > currentFairShare)
+          {
+            return it.first;
+          }
+      }
+    return BandwidthFunction::INF;
+  }
+
+private:
+  std::vector<std::pair<double, double> > m_vertexTable;
+};
+
+/**
+ * Time one kind of lookup over the query set and return nanoseconds per call.
+ */
+template <typename Lookup>
+double
+TimeLookups (Lookup lookup, const std::vector<double>& queries, uint32_t rounds, double& checksum)
+{
+  auto begin = std::chrono::steady_clock::now ();
+  for (uint32_t r = 0; r < rounds; r++)
+    {
+      for (auto q : queries)
+        {
+          checksum += lookup (q);
+        }
+    }
+  auto end = std::chrono::steady_clock::now ();
+  double elapsed = std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count ();
+  return elapsed / (static_cast<double> (rounds) * queries.size ());
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t queryNum = 4096;
+  uint32_t rounds = 200;
+
+  CommandLine cmd;
+  cmd.AddValue ("queries", "Number of distinct lookup arguments", queryNum);
+  cmd.AddValue ("rounds", "Number of passes over the lookup arguments", rounds);
+  cmd.Parse (argc, argv);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  double checksum = 0;
+
+  std::cout << "vertices,lookup,pair-table-ns,indexed-ns,speedup" << std::endl;
+  uint32_t sizes[] = {2, 16, 256};
+  for (uint32_t vertexNum : sizes)
+    {
+      // build the same concave function in both representations
+      Ptr<BandwidthFunction> indexed = CreateObject<BandwidthFunction> ();
+      PairTableBandwidthFunction pairTable;
+      double fairShare = 0;
+      double bandwidth = 0;
+      for (uint32_t i = 1; i < vertexNum; i++)
+        {
+          fairShare += 1 + rng->GetValue (0, 10);
+          bandwidth += 1e6 * rng->GetValue (0.1, 10) / i;
+          indexed->AddVertex (fairShare, bandwidth);
+          pairTable.AddVertex (fairShare, bandwidth);
+        }
+
+      std::vector<double> fsQueries;
+      std::vector<double> bwQueries;
+      for (uint32_t i = 0; i < queryNum; i++)
+        {
+          fsQueries.push_back (rng->GetValue (0, fairShare * 1.1));
+          bwQueries.push_back (rng->GetValue (0, bandwidth));
+        }
+
+      double pairNs, indexedNs;
+
+      pairNs = TimeLookups ([&] (double q) { return pairTable.GetBandwidth (q); }, fsQueries, rounds, checksum);
+      indexedNs = TimeLookups ([&] (double q) { return indexed->GetBandwidth (q); }, fsQueries, rounds, checksum);
+      std::cout << vertexNum << ",GetBandwidth," << pairNs << "," << indexedNs << "," << pairNs / indexedNs << std::endl;
+
+      pairNs = TimeLookups ([&] (double q) { return pairTable.GetFairShare (q); }, bwQueries, rounds, checksum);
+      indexedNs = TimeLookups ([&] (double q) { return indexed->GetFairShare (q); }, bwQueries, rounds, checksum);
+      std::cout << vertexNum << ",GetFairShare," << pairNs << "," << indexedNs << "," << pairNs / indexedNs << std::endl;
+
+      pairNs = TimeLookups ([&] (double q) { return pairTable.GetNextInterestingPointByFS (q); }, fsQueries, rounds, checksum);
+      indexedNs = TimeLookups ([&] (double q) { return indexed->GetNextInterestingPointByFS (q); }, fsQueries, rounds, checksum);
+      std::cout << vertexNum << ",GetNextInterestingPointByFS," << pairNs << "," << indexedNs << "," << pairNs / indexedNs << std::endl;
+
+      // make sure both representations agree
+      for (auto q : fsQueries)
+        {
+          double expected = pairTable.GetBandwidth (q);
+          NS_ABORT_MSG_IF (std::fabs (indexed->GetBandwidth (q) - expected) > 1e-6 * std::max (1.0, expected),
+                           "Mismatched bandwidth at fair share " << q);
+        }
+      for (auto q : bwQueries)
+        {
+          double expected = pairTable.GetFairShare (q);
+          NS_ABORT_MSG_IF (std::fabs (indexed->GetFairShare (q) - expected) > 1e-6 * std::max (1.0, expected),
+                           "Mismatched fair share at bandwidth " << q);
+        }
+    }
+
+  NS_LOG_INFO ("Checksum " << checksum);
+  return 0;
+}
@@ -0,0 +1,157 @@
+#ifndef BWM_BENCH_FIXTURE_H
+#define BWM_BENCH_FIXTURE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ns3/bandwidth-manager-module.h"
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+
+/**
+ * The setup shared by the bandwidth manager benchmarks: a tenant
+ * configuration, a host whose device feeds a BwmQueueDisc driven by a local
+ * agent, and the packets of synthetic unit flows.
+ */
+
+namespace ns3 {
+
+/**
+ * Configure tenants 1 to tenantNum of a coordinator, each with the bandwidth
+ * function and the host weights returned for its id.
+ *
+ * The configuration goes through a private temporary file, so concurrent
+ * benchmarks and the working directory are left alone.
+ */
+inline void
+BwmBenchConfigureTenants (Ptr<BwmCoordinator> coordinator, uint32_t tenantNum,
+                          std::function<std::string (uint32_t)> bf,
+                          std::function<std::string (uint32_t)> hostWeights)
+{
+  char path[] = "/tmp/bwm-bench-tenants-XXXXXX";
+  int fd = mkstemp (path);
+  NS_ABORT_MSG_IF (fd == -1, "Cannot create a temporary tenant configuration");
+  close (fd);
+
+  std::ofstream fout (path);
+  for (uint32_t tenant = 1; tenant <= tenantNum; tenant++)
+    {
+      fout << tenant << "\n" << bf (tenant) << "\n" << hostWeights (tenant) << "\n";
+    }
+  fout.close ();
+
+  coordinator->InputConfiguration (path);
+  std::remove (path);
+}
+
+/**
+ * As above, with the default host weights.
+ */
+inline void
+BwmBenchConfigureTenants (Ptr<BwmCoordinator> coordinator, uint32_t tenantNum,
+                          std::function<std::string (uint32_t)> bf)
+{
+  BwmBenchConfigureTenants (coordinator, tenantNum, bf, [] (uint32_t) { return std::string ("0,1"); });
+}
+
+/**
+ * As above, all tenants sharing one bandwidth function.
+ */
+inline void
+BwmBenchConfigureTenants (Ptr<BwmCoordinator> coordinator, uint32_t tenantNum, std::string bf)
+{
+  BwmBenchConfigureTenants (coordinator, tenantNum, [bf] (uint32_t) { return bf; });
+}
+
+/**
+ * Wire a local agent to the queue disc of its device and to a coordinator.
+ */
+inline void
+BwmBenchWireAgent (Ptr<BwmQueueDisc> qdisc, Ptr<BwmLocalAgent> agent, Ptr<BwmCoordinator> coordinator)
+{
+  qdisc->SetupLocalAgent (agent);
+  agent->SetQueueDisc (qdisc);
+  agent->SetCoordinator (coordinator);
+}
+
+/**
+ * A host with one device feeding a bandwidth manager queue disc, node 0, and
+ * the coordinator on the other end of the device, node 1.
+ */
+struct BwmBenchHost
+{
+  NodeContainer nodes;                  //!< The host and the coordinator node
+  NetDeviceContainer devices;           //!< The devices of the link between them
+  Ipv4InterfaceContainer interfaces;    //!< The addresses of the devices
+  Ptr<BwmQueueDisc> qdisc;              //!< The queue disc of the host device
+  Ptr<BwmLocalAgent> agent;             //!< The local agent of the host
+  Ptr<BwmCoordinator> coordinator;      //!< The coordinator
+
+  /**
+   * Build the host and install the agent and the coordinator as applications.
+   * \param simple the helper of the link, its device attributes set by the caller
+   * \param tch the helper installing the BwmQueueDisc
+   * \param hostAgent the agent of the host, its attributes set by the caller
+   * \param tenantNum the number of tenants
+   * \param bf the bandwidth function of every tenant
+   */
+  BwmBenchHost (SimpleNetDeviceHelper simple, TrafficControlHelper tch, Ptr<BwmLocalAgent> hostAgent,
+                uint32_t tenantNum, std::string bf)
+    : agent (hostAgent)
+  {
+    nodes.Create (2);
+    devices = simple.Install (nodes);
+    InternetStackHelper internet;
+    internet.Install (nodes);
+    qdisc = DynamicCast<BwmQueueDisc> (tch.Install (devices.Get (0)).Get (0));
+    Ipv4AddressHelper ipv4 ("10.0.0.0", "255.255.255.0");
+    interfaces = ipv4.Assign (devices);
+
+    coordinator = CreateObject<BwmCoordinator> ();
+    nodes.Get (1)->AddApplication (coordinator);
+    BwmBenchConfigureTenants (coordinator, tenantNum, bf);
+
+    nodes.Get (0)->AddApplication (agent);
+    BwmBenchWireAgent (qdisc, agent, coordinator);
+  }
+
+  /**
+   * Start the applications, the benchmarks then drive the queue disc outside the event loop.
+   */
+  void Start (void)
+  {
+    Simulator::Stop (MicroSeconds (1));
+    Simulator::Run ();
+  }
+};
+
+/**
+ * Build one packet of unit flow flow, sent from 10.128.0.0 + flow by tenant
+ * flow % tenantNum + 1.
+ */
+inline Ptr<QueueDiscItem>
+BwmBenchBuildItem (uint32_t flow, uint32_t tenantNum, Ipv4Address dst,
+                   uint32_t size = 100, Address macDst = Address ())
+{
+  Ipv4Header header;
+  header.SetSource (Ipv4Address (Ipv4Address ("10.128.0.0").Get () + flow));
+  header.SetDestination (dst);
+  header.SetProtocol (6);
+  header.SetPayloadSize (size);
+  Ptr<Packet> packet = Create<Packet> (size);
+  TenantIdTag tidTag;
+  tidTag.SetTenantId (flow % tenantNum + 1);
+  packet->AddPacketTag (tidTag);
+  packet->AddPacketTag (FlowIdTag (flow));
+  return Create<Ipv4QueueDiscItem> (packet, macDst, Ipv4L3Protocol::PROT_NUMBER, header);
+}
+
+}
+
+#endif
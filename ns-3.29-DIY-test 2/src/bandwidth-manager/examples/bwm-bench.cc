@@ -0,0 +1,421 @@
+#include "ns3/applications-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/map-scheduler.h"
+#include "bwm-bench-fixture.h"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BwmBench");
+
+/**
+ * The default scheduler, counting the events it hands to the simulator.
+ */
+class BwmBenchScheduler : public MapScheduler
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::BwmBenchScheduler")
+      .SetParent<MapScheduler> ()
+      .SetGroupName ("BandwidthManager")
+      .AddConstructor<BwmBenchScheduler> ()
+    ;
+    return tid;
+  }
+
+  virtual Event RemoveNext (void)
+  {
+    s_events++;
+    return MapScheduler::RemoveNext ();
+  }
+
+  static uint64_t s_events; //!< Events removed from the scheduler, cancelled ones included
+};
+
+uint64_t BwmBenchScheduler::s_events = 0;
+
+/**
+ * A synthetic unit flow: one UDP sender of a tenant between two hosts.
+ */
+struct BenchFlow
+{
+  uint32_t traceId;
+  uint32_t tenantId;
+  uint32_t src;
+  uint32_t dst;
+  double start;
+  double stop;
+};
+
+double g_measureStart = 0;                        //!< Begin of the measurement window
+std::map<uint32_t, uint64_t> g_rxBytes;          //!< Bytes received in the window, traceId -> bytes
+std::vector<BwmCoordinator::Allocation> g_target; //!< Water-filling of the transformed functions at the end of the window
+
+void
+TxTrace (uint32_t tenantId, uint32_t traceId, Ptr<const Packet> packet)
+{
+  TenantIdTag tidTag;
+  tidTag.SetTenantId (tenantId);
+  packet->AddPacketTag (tidTag);
+  packet->AddPacketTag (FlowIdTag (traceId));
+}
+
+void
+RxTrace (Ptr<const Packet> packet, const Address &from)
+{
+  FlowIdTag fidTag;
+  if (Simulator::Now ().GetSeconds () >= g_measureStart && packet->PeekPacketTag (fidTag))
+    {
+      g_rxBytes[fidTag.GetFlowId ()] += packet->GetSize ();
+    }
+}
+
+void
+ComputeTarget (Ptr<BwmCoordinator> coordinator)
+{
+  coordinator->ComputeWaterFilling (g_target);
+}
+
+/**
+ * Weight of a tenant, scaling its bandwidth function.
+ */
+uint32_t
+TenantWeight (uint32_t tenant)
+{
+  return 1 + (tenant - 1) % 4;
+}
+
+/**
+ * Weight of a host in the bandwidth functions of a tenant.
+ */
+double
+HostWeight (uint32_t tenant, uint32_t host)
+{
+  return 1 + (tenant + host) % 2;
+}
+
+/**
+ * The ideal weighted max-min allocation of the unit flows, computed from the
+ * configuration alone and not from the functions the coordinator transformed.
+ *
+ * A tenant shares its bandwidth function among its unit flows in proportion
+ * to the summed weights of their end hosts, each unit flow is capped by its
+ * offered rate, and the common fair share is raised until every unit flow
+ * crosses a saturated host link or reaches the end of its function.
+ */
+std::map<uint32_t, double>
+ComputeIdeal (const std::vector<BenchFlow> &flows, const std::map<uint32_t, Ptr<BandwidthFunction> > &tenantBFs,
+              uint32_t hostNum, double capacity, double offered)
+{
+  // the uplink of host h is link 2h, its downlink 2h + 1
+  std::map<uint32_t, double> tenantWeights;
+  for (auto &flow : flows)
+    {
+      tenantWeights[flow.tenantId] += HostWeight (flow.tenantId, flow.src) + HostWeight (flow.tenantId, flow.dst);
+    }
+  auto rateAt = [&] (const BenchFlow &flow, double fairShare)
+    {
+      double share = (HostWeight (flow.tenantId, flow.src) + HostWeight (flow.tenantId, flow.dst))
+        / tenantWeights[flow.tenantId];
+      return std::min (share * tenantBFs.at (flow.tenantId)->GetBandwidth (fairShare), offered);
+    };
+  double maxFairShare = 0;
+  for (auto &it : tenantBFs)
+    {
+      maxFairShare = std::max (maxFairShare, it.second->GetVertex (it.second->GetNVertices () - 1).first);
+    }
+
+  std::vector<double> rates (flows.size (), 0);
+  std::vector<bool> frozen (flows.size (), false);
+  auto loads = [&] (double fairShare)
+    {
+      std::vector<double> load (2 * hostNum, 0);
+      for (uint32_t i = 0; i < flows.size (); i++)
+        {
+          double rate = frozen[i] ? rates[i] : rateAt (flows[i], fairShare);
+          load[2 * flows[i].src] += rate;
+          load[2 * flows[i].dst + 1] += rate;
+        }
+      return load;
+    };
+  auto feasible = [&] (double fairShare)
+    {
+      for (double load : loads (fairShare))
+        {
+          if (load > capacity * (1 + 1e-12))
+            {
+              return false;
+            }
+        }
+      return true;
+    };
+
+  double level = 0;
+  uint32_t activeNum = flows.size ();
+  while (activeNum > 0)
+    {
+      if (feasible (maxFairShare))
+        {
+          level = maxFairShare;
+          break;
+        }
+      // the loads grow with the fair share, find where the first link saturates
+      double lo = level;
+      double hi = maxFairShare;
+      for (uint32_t step = 0; step < 100; step++)
+        {
+          double mid = (lo + hi) / 2;
+          (feasible (mid) ? lo : hi) = mid;
+        }
+      level = lo;
+      std::vector<double> over = loads (hi);
+      for (uint32_t i = 0; i < flows.size (); i++)
+        {
+          if (!frozen[i] && (over[2 * flows[i].src] > capacity || over[2 * flows[i].dst + 1] > capacity))
+            {
+              rates[i] = rateAt (flows[i], level);
+              frozen[i] = true;
+              activeNum--;
+            }
+        }
+    }
+
+  std::map<uint32_t, double> ideal;
+  for (uint32_t i = 0; i < flows.size (); i++)
+    {
+      ideal[flows[i].traceId] = frozen[i] ? rates[i] : rateAt (flows[i], level);
+    }
+  return ideal;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t hostNum = 8;
+  uint32_t tenantNum = 4;
+  uint32_t flowNum = 32;
+  double churn = 0;
+  double simTime = 2;
+  double measureTime = 0.5;
+  std::string linkRate = "100Mbps";
+  std::string offeredRate = "100Mbps";
+  uint32_t packetSize = 1000;
+  uint32_t seed = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("hosts", "Number of hosts attached to one switch", hostNum);
+  cmd.AddValue ("tenants", "Number of tenants", tenantNum);
+  cmd.AddValue ("flows", "Number of concurrent unit flows", flowNum);
+  cmd.AddValue ("churn", "Unit flows replaced per second", churn);
+  cmd.AddValue ("time", "Simulated seconds", simTime);
+  cmd.AddValue ("measure", "Length of the final window the errors are measured in", measureTime);
+  cmd.AddValue ("linkRate", "Rate of the host links", linkRate);
+  cmd.AddValue ("offeredRate", "Sending rate of every unit flow", offeredRate);
+  cmd.AddValue ("size", "Packet size in bytes", packetSize);
+  cmd.AddValue ("seed", "Seed of the scenario", seed);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (hostNum < 2, "At least two hosts are needed");
+  NS_ABORT_MSG_IF (flowNum > tenantNum * hostNum * (hostNum - 1), "More unit flows than (tenant, src, dst) tuples");
+  RngSeedManager::SetSeed (seed);
+  ObjectFactory schedulerFactory;
+  schedulerFactory.SetTypeId (BwmBenchScheduler::GetTypeId ());
+  Simulator::SetScheduler (schedulerFactory);
+
+  // a star of hosts around one switch, the last node
+  NodeContainer nodes;
+  nodes.Create (hostNum + 1);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  // tenants get weighted bandwidth functions and weight their hosts differently;
+  // the agents start in the order of their hosts, so host h gets host id h
+  double capacity = DataRate (linkRate).GetBitRate ();
+  Ptr<BwmCoordinator> coordinator = CreateObject<BwmCoordinator> ();
+  nodes.Get (0)->AddApplication (coordinator);
+  std::map<uint32_t, Ptr<BandwidthFunction> > tenantBFs;
+  for (uint32_t tenant = 1; tenant <= tenantNum; tenant++)
+    {
+      tenantBFs[tenant] = CreateObject<BandwidthFunction> ();
+      tenantBFs[tenant]->AddVertex (10, TenantWeight (tenant) * capacity / 10);
+      tenantBFs[tenant]->AddVertex (100, TenantWeight (tenant) * capacity);
+    }
+  BwmBenchConfigureTenants (coordinator, tenantNum, [&tenantBFs] (uint32_t tenant)
+    {
+      std::ostringstream bf;
+      for (uint32_t i = 1; i < tenantBFs[tenant]->GetNVertices (); i++)
+        {
+          auto vertex = tenantBFs[tenant]->GetVertex (i);
+          bf << (i > 1 ? " " : "") << vertex.first << "," << vertex.second;
+        }
+      return bf.str ();
+    }, [hostNum] (uint32_t tenant)
+    {
+      std::ostringstream weights;
+      for (uint32_t host = 0; host < hostNum; host++)
+        {
+          weights << (host > 0 ? " " : "") << host << "," << HostWeight (tenant, host);
+        }
+      return weights.str ();
+    });
+
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute ("DataRate", StringValue (linkRate));
+  p2p.SetChannelAttribute ("Delay", StringValue ("10us"));
+  Ipv4AddressHelper ipv4 ("10.0.0.0", "255.255.255.0");
+  std::vector<Ipv4Address> hostAddrs;
+  for (uint32_t host = 0; host < hostNum; host++)
+    {
+      NetDeviceContainer devices = p2p.Install (nodes.Get (host), nodes.Get (hostNum));
+      coordinator->AddLink (host, hostNum, capacity);
+
+      TrafficControlHelper tch;
+      tch.SetRootQueueDisc ("ns3::BwmQueueDisc", "MaxSize", QueueSizeValue (QueueSize ("1000p")));
+      Ptr<BwmQueueDisc> qdisc = DynamicCast<BwmQueueDisc> (tch.Install (devices.Get (0)).Get (0));
+      Ptr<BwmLocalAgent> agent = CreateObject<BwmLocalAgent> ();
+      agent->SetAttribute ("IdleTimeout", TimeValue (MilliSeconds (50)));
+      nodes.Get (host)->AddApplication (agent);
+      BwmBenchWireAgent (qdisc, agent, coordinator);
+
+      hostAddrs.push_back (ipv4.Assign (devices).GetAddress (0));
+      ipv4.NewNetwork ();
+    }
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  // one sink per host
+  uint16_t port = 9;
+  for (uint32_t host = 0; host < hostNum; host++)
+    {
+      PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+      ApplicationContainer sink = sinkHelper.Install (nodes.Get (host));
+      sink.Get (0)->TraceConnectWithoutContext ("Rx", MakeCallback (&RxTrace));
+    }
+
+  // the initial unit flows, then one replacement every 1 / churn seconds
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  std::set<std::tuple<uint32_t, uint32_t, uint32_t> > usedTuples;
+  std::vector<BenchFlow> flows;
+  std::vector<uint32_t> live;
+  double startTime = 0.1;
+  auto newFlow = [&] (double start)
+    {
+      BenchFlow flow;
+      do
+        {
+          flow.tenantId = random->GetInteger (1, tenantNum);
+          flow.src = random->GetInteger (0, hostNum - 1);
+          flow.dst = (flow.src + random->GetInteger (1, hostNum - 1)) % hostNum;
+        }
+      while (usedTuples.size () < tenantNum * hostNum * (hostNum - 1)
+             && !usedTuples.insert (std::make_tuple (flow.tenantId, flow.src, flow.dst)).second);
+      flow.traceId = flows.size ();
+      flow.start = start;
+      flow.stop = simTime;
+      flows.push_back (flow);
+      return flow.traceId;
+    };
+  for (uint32_t i = 0; i < flowNum; i++)
+    {
+      live.push_back (newFlow (startTime));
+    }
+  if (churn > 0)
+    {
+      for (double t = startTime + 1 / churn; t < simTime; t += 1 / churn)
+        {
+          uint32_t victim = random->GetInteger (0, live.size () - 1);
+          flows[live[victim]].stop = t;
+          live[victim] = newFlow (t);
+        }
+    }
+
+  for (auto &flow : flows)
+    {
+      OnOffHelper onoff ("ns3::UdpSocketFactory", InetSocketAddress (hostAddrs[flow.dst], port));
+      onoff.SetConstantRate (DataRate (offeredRate), packetSize);
+      ApplicationContainer sender = onoff.Install (nodes.Get (flow.src));
+      sender.Start (Seconds (flow.start));
+      sender.Stop (Seconds (flow.stop));
+      sender.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&TxTrace, flow.tenantId, flow.traceId));
+    }
+
+  g_measureStart = simTime - measureTime;
+  Simulator::Schedule (Seconds (simTime) - NanoSeconds (1), &ComputeTarget, coordinator);
+
+  BwmProfiler::Enable (true);
+  Simulator::Stop (Seconds (simTime));
+  auto begin = std::chrono::steady_clock::now ();
+  Simulator::Run ();
+  auto end = std::chrono::steady_clock::now ();
+  double wallSeconds = std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count () * 1e-9;
+
+  // the allocation error compares the unit flows sending through the whole window with
+  // the ideal weighted max-min allocation among the unit flows alive at the end; the
+  // enforcement error compares them with the rates the coordinator computes from its own
+  // transformed functions, it tells how closely the hosts follow the coordinator
+  std::vector<BenchFlow> alive;
+  for (auto &flow : flows)
+    {
+      if (flow.stop >= simTime)
+        {
+          alive.push_back (flow);
+        }
+    }
+  std::map<uint32_t, double> ideal = ComputeIdeal (alive, tenantBFs, hostNum, capacity,
+                                                   DataRate (offeredRate).GetBitRate ());
+  double errorSum = 0;
+  double idealSum = 0;
+  uint32_t measured = 0;
+  for (auto &flow : alive)
+    {
+      if (flow.start > g_measureStart)
+        {
+          continue;
+        }
+      double rate = g_rxBytes[flow.traceId] * 8 / measureTime;
+      errorSum += std::fabs (rate - ideal[flow.traceId]);
+      idealSum += ideal[flow.traceId];
+      measured++;
+    }
+  double enforcementSum = 0;
+  double targetSum = 0;
+  for (auto &allocation : g_target)
+    {
+      const BenchFlow &flow = flows[allocation.flow->GetTraceId ()];
+      if (flow.start > g_measureStart || flow.stop < simTime)
+        {
+          continue;
+        }
+      double rate = g_rxBytes[flow.traceId] * 8 / measureTime;
+      enforcementSum += std::fabs (rate - allocation.rate);
+      targetSum += allocation.rate;
+    }
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  std::cout << "hosts,tenants,flows,churn,sim-seconds,wall-seconds,wall-per-sim-second,events,"
+            << "peak-rss-kb,coordinator-seconds,agent-seconds,qdisc-seconds,measured-flows,allocation-error,enforcement-error"
+            << std::endl;
+  std::cout << hostNum << "," << tenantNum << "," << flowNum << "," << churn << ","
+            << simTime << "," << wallSeconds << "," << wallSeconds / simTime << ","
+            << BwmBenchScheduler::s_events << "," << usage.ru_maxrss << ","
+            << BwmProfiler::GetSeconds (BwmProfiler::COORDINATOR) << ","
+            << BwmProfiler::GetSeconds (BwmProfiler::AGENT) << ","
+            << BwmProfiler::GetSeconds (BwmProfiler::QDISC) << ","
+            << measured << "," << (idealSum > 0 ? errorSum / idealSum : 0) << ","
+            << (targetSum > 0 ? enforcementSum / targetSum : 0) << std::endl;
+
+  BwmProfiler::Enable (false);
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "bwm-bench-fixture.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BwmDequeueBench");
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t flowNum = 10000;
+  uint32_t tenantNum = 100;
+  double activeRatio = 0.01;
+  uint32_t burst = 8;
+  uint32_t rounds = 10;
+
+  CommandLine cmd;
+  cmd.AddValue ("flows", "Number of queue disc classes", flowNum);
+  cmd.AddValue ("tenants", "Number of tenants the flows are spread over", tenantNum);
+  cmd.AddValue ("active", "Ratio of backlogged classes in a round", activeRatio);
+  cmd.AddValue ("burst", "Number of packets queued by each backlogged class", burst);
+  cmd.AddValue ("rounds", "Number of timed rounds, each with fresh backlogged classes", rounds);
+  cmd.Parse (argc, argv);
+
+  // a host with one device feeding a bandwidth manager queue disc,
+  // the tenants all share one concave bandwidth function
+  SimpleNetDeviceHelper simple;
+  simple.SetDeviceAttribute ("DataRate", DataRateValue (DataRate ("10Gbps")));
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::BwmQueueDisc",
+                        "MaxSize", QueueSizeValue (QueueSize ("100000000p")));
+  BwmBenchHost host (simple, tch, CreateObject<BwmLocalAgent> (), tenantNum, "10,50000000 20,80000000");
+  Ptr<BwmQueueDisc> qdisc = host.qdisc;
+
+  // start the applications, the packets are then queued outside the event loop
+  host.Start ();
+
+  Ipv4Address dst = host.interfaces.GetAddress (1);
+
+  // create all classes, then leave them idle
+  for (uint32_t flow = 0; flow < flowNum; flow++)
+    {
+      qdisc->Enqueue (BwmBenchBuildItem (flow, tenantNum, dst));
+    }
+  while (qdisc->Dequeue ())
+    {
+    }
+
+  // every round backlogs classes that still have full token buckets
+  uint32_t activeNum = std::max (1.0, flowNum * activeRatio);
+  uint32_t stride = std::max (1u, flowNum / (activeNum * rounds));
+  double totalNs = 0;
+  uint64_t packets = 0;
+  uint32_t flow = 0;
+  for (uint32_t r = 0; r < rounds; r++)
+    {
+      for (uint32_t i = 0; i < activeNum; i++, flow = (flow + stride) % flowNum)
+        {
+          for (uint32_t j = 0; j < burst; j++)
+            {
+              qdisc->Enqueue (BwmBenchBuildItem (flow, tenantNum, dst));
+            }
+        }
+
+      auto begin = std::chrono::steady_clock::now ();
+      while (qdisc->Dequeue ())
+        {
+          packets++;
+        }
+      auto end = std::chrono::steady_clock::now ();
+      totalNs += std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count ();
+    }
+
+  std::cout << "classes,active,packets,seconds,ns-per-dequeue" << std::endl;
+  std::cout << flowNum << "," << activeNum << "," << packets << "," << totalNs * 1e-9 << ","
+            << totalNs / packets << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
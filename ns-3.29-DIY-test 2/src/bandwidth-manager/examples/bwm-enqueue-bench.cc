@@ -0,0 +1,101 @@
+#include "bwm-bench-fixture.h"
+
+#include <chrono>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BwmEnqueueBench");
+
+/**
+ * Build the items of one round: every flow sends burst packets back to back.
+ */
+std::vector<Ptr<QueueDiscItem> >
+BuildRound (uint32_t flowNum, uint32_t tenantNum, uint32_t burst, Ipv4Address dst)
+{
+  std::vector<Ptr<QueueDiscItem> > items;
+  items.reserve (flowNum * burst);
+  for (uint32_t flow = 0; flow < flowNum; flow++)
+    {
+      for (uint32_t i = 0; i < burst; i++)
+        {
+          items.push_back (BwmBenchBuildItem (flow, tenantNum, dst));
+        }
+    }
+  return items;
+}
+
+/**
+ * Enqueue all items of a round and return the elapsed nanoseconds.
+ */
+double
+TimeRound (Ptr<QueueDisc> qdisc, const std::vector<Ptr<QueueDiscItem> > &items, uint32_t &accepted)
+{
+  auto begin = std::chrono::steady_clock::now ();
+  for (auto item : items)
+    {
+      accepted += qdisc->Enqueue (item);
+    }
+  auto end = std::chrono::steady_clock::now ();
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t flowNum = 10000;
+  uint32_t tenantNum = 100;
+  uint32_t slots = 1031;
+  uint32_t rounds = 10;
+
+  CommandLine cmd;
+  cmd.AddValue ("flows", "Number of concurrent unit flows", flowNum);
+  cmd.AddValue ("tenants", "Number of tenants the flows are spread over", tenantNum);
+  cmd.AddValue ("slots", "Number of flows the flow table holds before it grows", slots);
+  cmd.AddValue ("rounds", "Number of timed rounds per traffic pattern", rounds);
+  cmd.Parse (argc, argv);
+
+  // a host with one device feeding a bandwidth manager queue disc,
+  // the tenants all share one concave bandwidth function
+  SimpleNetDeviceHelper simple;
+  simple.SetDeviceAttribute ("DataRate", DataRateValue (DataRate ("10Gbps")));
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::BwmQueueDisc",
+                        "MaxSize", QueueSizeValue (QueueSize ("100000000p")),
+                        "Flows", UintegerValue (slots));
+  BwmBenchHost host (simple, tch, CreateObject<BwmLocalAgent> (), tenantNum, "10,50000000 20,80000000");
+  Ptr<BwmQueueDisc> qdisc = host.qdisc;
+
+  // start the applications, the packets are then enqueued outside the event loop
+  host.Start ();
+
+  Ipv4Address dst = host.interfaces.GetAddress (1);
+  uint32_t accepted = 0;
+
+  // the first round registers all unit flows
+  std::vector<Ptr<QueueDiscItem> > items = BuildRound (flowNum, tenantNum, 1, dst);
+  double createNs = TimeRound (qdisc, items, accepted);
+
+  std::cout << "flows,pattern,packets,seconds,packets-per-sec" << std::endl;
+  std::cout << flowNum << ",create," << items.size () << "," << createNs * 1e-9 << ","
+            << items.size () / (createNs * 1e-9) << std::endl;
+
+  uint32_t bursts[] = {1, 8};
+  for (uint32_t burst : bursts)
+    {
+      double totalNs = 0;
+      uint64_t packets = 0;
+      for (uint32_t r = 0; r < rounds; r++)
+        {
+          items = BuildRound (flowNum, tenantNum, burst, dst);
+          totalNs += TimeRound (qdisc, items, accepted);
+          packets += items.size ();
+        }
+      std::cout << flowNum << ",burst-" << burst << "," << packets << "," << totalNs * 1e-9 << ","
+                << packets / (totalNs * 1e-9) << std::endl;
+    }
+
+  NS_LOG_INFO ("Accepted " << accepted << " packets");
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,348 @@
+#include "bwm-bench-fixture.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BwmMicroBench");
+
+/**
+ * One measured kernel configuration.
+ */
+struct BenchResult
+{
+  std::string kernel;   //!< The timed operation
+  uint32_t flows;       //!< Number of flows, tuples or queries the operation works on
+  uint32_t vertices;    //!< Number of vertices of the bandwidth functions, 0 if unrelated
+  uint64_t ops;         //!< Number of timed operations
+  double seconds;       //!< Wall-clock time of all operations
+};
+
+std::vector<BenchResult> g_results; //!< Results in the order they were measured
+double g_checksum = 0;             //!< Keeps the compiler from dropping the timed work
+
+/**
+ * Time body, which performs ops operations, and record the result.
+ */
+template <typename Body>
+void
+Measure (std::string kernel, uint32_t flows, uint32_t vertices, uint64_t ops, Body body)
+{
+  auto begin = std::chrono::steady_clock::now ();
+  body ();
+  auto end = std::chrono::steady_clock::now ();
+  double seconds = std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count () * 1e-9;
+  g_results.push_back ({kernel, flows, vertices, ops, seconds});
+}
+
+/**
+ * A concave bandwidth function with the given number of vertices, origin included.
+ */
+Ptr<BandwidthFunction>
+BuildBF (uint32_t vertexNum, Ptr<UniformRandomVariable> rng, double &maxFairShare, double &maxBandwidth)
+{
+  Ptr<BandwidthFunction> bf = CreateObject<BandwidthFunction> ();
+  maxFairShare = 0;
+  maxBandwidth = 0;
+  for (uint32_t i = 1; i < vertexNum; i++)
+    {
+      maxFairShare += 1 + rng->GetValue (0, 10);
+      maxBandwidth += 1e6 * rng->GetValue (0.1, 10) / i;
+      bf->AddVertex (maxFairShare, maxBandwidth);
+    }
+  return bf;
+}
+
+void
+BenchBandwidthFunction (Ptr<UniformRandomVariable> rng, uint32_t queryNum, uint32_t rounds)
+{
+  uint32_t sizes[] = {2, 16, 256};
+  for (uint32_t vertexNum : sizes)
+    {
+      double maxFairShare, maxBandwidth;
+      Ptr<BandwidthFunction> bf = BuildBF (vertexNum, rng, maxFairShare, maxBandwidth);
+      std::vector<double> fsQueries;
+      std::vector<double> bwQueries;
+      for (uint32_t i = 0; i < queryNum; i++)
+        {
+          fsQueries.push_back (rng->GetValue (0, maxFairShare * 1.1));
+          bwQueries.push_back (rng->GetValue (0, maxBandwidth));
+        }
+      uint64_t ops = static_cast<uint64_t> (queryNum) * rounds;
+
+      Measure ("bf-get-bandwidth", queryNum, vertexNum, ops, [&] ()
+        {
+          for (uint32_t r = 0; r < rounds; r++)
+            {
+              for (auto q : fsQueries)
+                {
+                  g_checksum += bf->GetBandwidth (q);
+                }
+            }
+        });
+      Measure ("bf-get-fair-share", queryNum, vertexNum, ops, [&] ()
+        {
+          for (uint32_t r = 0; r < rounds; r++)
+            {
+              for (auto q : bwQueries)
+                {
+                  g_checksum += bf->GetFairShare (q);
+                }
+            }
+        });
+      Measure ("bf-next-point-by-fs", queryNum, vertexNum, ops, [&] ()
+        {
+          for (uint32_t r = 0; r < rounds; r++)
+            {
+              for (auto q : fsQueries)
+                {
+                  g_checksum += bf->GetNextInterestingPointByFS (q);
+                }
+            }
+        });
+    }
+}
+
+/**
+ * A unit flow with the one-vertex function the coordinator configures for a host pair.
+ */
+Ptr<UnitFlow>
+BuildUnitFlow (uint32_t flowId, uint32_t tenantId, double fairShare, double bandwidth)
+{
+  Ptr<UnitFlow> flow = CreateObject<UnitFlow> ();
+  flow->SetFlowId (flowId);
+  flow->SetTraceId (flowId);
+  flow->SetTenantId (tenantId);
+  Ptr<BandwidthFunction> bf = CreateObject<BandwidthFunction> ();
+  bf->AddVertex (fairShare, bandwidth);
+  flow->SetConfiguredBF (bf);
+  return flow;
+}
+
+void
+BenchTransform (Ptr<UniformRandomVariable> rng, uint32_t rounds)
+{
+  uint32_t flowSizes[] = {10, 100, 1000};
+  uint32_t vertexSizes[] = {2, 16, 64};
+  for (uint32_t flowNum : flowSizes)
+    {
+      for (uint32_t vertexNum : vertexSizes)
+        {
+          std::stringstream bfStr;
+          double fairShare = 0;
+          double bandwidth = 0;
+          for (uint32_t i = 1; i < vertexNum; i++)
+            {
+              fairShare += 10;
+              bandwidth += 1e9 / i;
+              bfStr << fairShare << "," << bandwidth << " ";
+            }
+
+          // a full transformation of a tenant whose flows all just joined
+          double fullSeconds = 0;
+          double joinSeconds = 0;
+          for (uint32_t r = 0; r < rounds; r++)
+            {
+              Ptr<Tenant> tenant = CreateObject<Tenant> ();
+              tenant->SetTenantId (1);
+              tenant->SetBF (bfStr.str ());
+              for (uint32_t i = 0; i < flowNum; i++)
+                {
+                  double weight = 1 + rng->GetInteger (0, 3);
+                  tenant->AddUnitFlow (BuildUnitFlow (i, 1, 1e8 / weight, 1e8));
+                }
+              auto begin = std::chrono::steady_clock::now ();
+              tenant->TransformComponentialBF ();
+              auto end = std::chrono::steady_clock::now ();
+              fullSeconds += std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count () * 1e-9;
+
+              // then one more flow joins the settled tenant
+              tenant->AddUnitFlow (BuildUnitFlow (flowNum, 1, 1e8 / 2, 1e8));
+              begin = std::chrono::steady_clock::now ();
+              tenant->TransformComponentialBF ();
+              end = std::chrono::steady_clock::now ();
+              joinSeconds += std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count () * 1e-9;
+            }
+          g_results.push_back ({"transform-full", flowNum, vertexNum, rounds, fullSeconds});
+          g_results.push_back ({"transform-join", flowNum, vertexNum, rounds, joinSeconds});
+        }
+    }
+}
+
+void
+BenchAssignFlowId (uint32_t tupleNum, uint32_t rounds)
+{
+  Ptr<BwmLocalAgent> agent = CreateObject<BwmLocalAgent> ();
+  std::vector<Ipv4Address> srcs;
+  for (uint32_t i = 0; i < tupleNum; i++)
+    {
+      srcs.push_back (Ipv4Address (Ipv4Address ("10.128.0.0").Get () + i));
+    }
+  Ipv4Address dst ("10.0.0.2");
+
+  Measure ("assign-flow-id", tupleNum, 0, static_cast<uint64_t> (tupleNum) * rounds, [&] ()
+    {
+      for (uint32_t r = 0; r < rounds; r++)
+        {
+          for (uint32_t i = 0; i < tupleNum; i++)
+            {
+              g_checksum += agent->AssignFlowId (i % 100 + 1, srcs[i], dst);
+            }
+        }
+    });
+}
+
+void
+BenchQueueDisc (uint32_t flowNum, uint32_t tenantNum, uint32_t rounds)
+{
+  // a device feeding a bandwidth manager queue disc, the agent is wired by hand
+  // and never started, so the classes keep the default rate of their limiter
+  NodeContainer nodes;
+  nodes.Create (1);
+  SimpleNetDeviceHelper simple;
+  NetDeviceContainer devices = simple.Install (nodes);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::BwmQueueDisc", "MaxSize", QueueSizeValue (QueueSize ("100000000p")));
+  Ptr<BwmQueueDisc> qdisc = DynamicCast<BwmQueueDisc> (tch.Install (devices.Get (0)).Get (0));
+  qdisc->Initialize ();
+
+  Ptr<BwmCoordinator> coordinator = CreateObject<BwmCoordinator> ();
+  BwmBenchConfigureTenants (coordinator, tenantNum, "10,50000000 20,80000000");
+
+  Ptr<BwmLocalAgent> agent = CreateObject<BwmLocalAgent> ();
+  BwmBenchWireAgent (qdisc, agent, coordinator);
+  coordinator->RegisterHost (agent);
+
+  Ipv4Address dst ("10.0.0.2");
+  std::vector<Ptr<QueueDiscItem> > items;
+  auto buildRound = [&] ()
+    {
+      items.clear ();
+      for (uint32_t flow = 0; flow < flowNum; flow++)
+        {
+          items.push_back (BwmBenchBuildItem (flow, tenantNum, dst));
+        }
+    };
+
+  // the first round creates the classes and registers the unit flows
+  buildRound ();
+  Measure ("qdisc-enqueue-new-flow", flowNum, 0, flowNum, [&] ()
+    {
+      for (auto item : items)
+        {
+          g_checksum += qdisc->Enqueue (item);
+        }
+    });
+  while (qdisc->Dequeue ())
+    {
+    }
+
+  // then every round queues one packet per known class and drains the queue disc
+  double enqueueSeconds = 0;
+  double dequeueSeconds = 0;
+  uint64_t enqueued = 0;
+  uint64_t dequeued = 0;
+  for (uint32_t r = 0; r < rounds; r++)
+    {
+      buildRound ();
+      auto begin = std::chrono::steady_clock::now ();
+      for (auto item : items)
+        {
+          enqueued += qdisc->Enqueue (item);
+        }
+      auto end = std::chrono::steady_clock::now ();
+      enqueueSeconds += std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count () * 1e-9;
+
+      begin = std::chrono::steady_clock::now ();
+      while (qdisc->Dequeue ())
+        {
+          dequeued++;
+        }
+      end = std::chrono::steady_clock::now ();
+      dequeueSeconds += std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count () * 1e-9;
+    }
+  g_results.push_back ({"qdisc-enqueue", flowNum, 0, enqueued, enqueueSeconds});
+  g_results.push_back ({"qdisc-dequeue", flowNum, 0, dequeued, dequeueSeconds});
+
+  coordinator->Dispose ();
+  agent->Dispose ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string format = "csv";
+  std::string kernels = "bf,transform,flow-id,qdisc";
+  uint32_t queryNum = 4096;
+  uint32_t rounds = 10;
+  uint32_t flowNum = 10000;
+  uint32_t tenantNum = 100;
+
+  CommandLine cmd;
+  cmd.AddValue ("format", "Output format, csv or json", format);
+  cmd.AddValue ("kernels", "Comma separated kernels to run: bf, transform, flow-id, qdisc", kernels);
+  cmd.AddValue ("queries", "Number of distinct bandwidth function lookup arguments", queryNum);
+  cmd.AddValue ("rounds", "Number of timed rounds per kernel configuration", rounds);
+  cmd.AddValue ("flows", "Number of unit flows of the flow id and queue disc kernels", flowNum);
+  cmd.AddValue ("tenants", "Number of tenants the queue disc flows are spread over", tenantNum);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (format != "csv" && format != "json", "Unknown output format " << format);
+  auto selected = [&kernels] (std::string kernel)
+    {
+      return ("," + kernels + ",").find ("," + kernel + ",") != std::string::npos;
+    };
+
+  // the kernels are called directly, the simulator never runs
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  if (selected ("bf"))
+    {
+      BenchBandwidthFunction (rng, queryNum, rounds * 20);
+    }
+  if (selected ("transform"))
+    {
+      BenchTransform (rng, rounds);
+    }
+  if (selected ("flow-id"))
+    {
+      BenchAssignFlowId (flowNum, rounds * 20);
+    }
+  if (selected ("qdisc"))
+    {
+      BenchQueueDisc (flowNum, tenantNum, rounds);
+    }
+
+  if (format == "csv")
+    {
+      std::cout << "kernel,flows,vertices,ops,seconds,ns-per-op" << std::endl;
+      for (auto &result : g_results)
+        {
+          std::cout << result.kernel << "," << result.flows << "," << result.vertices << ","
+                    << result.ops << "," << result.seconds << ","
+                    << result.seconds * 1e9 / result.ops << std::endl;
+        }
+    }
+  else
+    {
+      std::cout << "[" << std::endl;
+      for (uint32_t i = 0; i < g_results.size (); i++)
+        {
+          const BenchResult &result = g_results[i];
+          std::cout << "  {\"kernel\": \"" << result.kernel << "\", \"flows\": " << result.flows
+                    << ", \"vertices\": " << result.vertices << ", \"ops\": " << result.ops
+                    << ", \"seconds\": " << result.seconds
+                    << ", \"ns_per_op\": " << result.seconds * 1e9 / result.ops << "}"
+                    << (i + 1 < g_results.size () ? "," : "") << std::endl;
+        }
+      std::cout << "]" << std::endl;
+    }
+
+  NS_LOG_INFO ("Checksum " << g_checksum);
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "bwm-bench-fixture.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BwmRateLimiterBench");
+
+/**
+ * Read the resident set size of the process in bytes.
+ */
+uint64_t
+GetResidentBytes (void)
+{
+  std::ifstream fin ("/proc/self/status");
+  std::string line;
+  while (std::getline (fin, line))
+    {
+      if (line.compare (0, 6, "VmRSS:") == 0)
+        {
+          std::istringstream iss (line.substr (6));
+          uint64_t kb = 0;
+          iss >> kb;
+          return kb * 1024;
+        }
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t flowNum = 10000;
+  uint32_t tenantNum = 100;
+  uint32_t burst = 4;
+  uint32_t packetSize = 1000;
+  double simTime = 0.05;
+  std::string limiter = "Tbf";
+
+  CommandLine cmd;
+  cmd.AddValue ("flows", "Number of rate-limited unit flows", flowNum);
+  cmd.AddValue ("tenants", "Number of tenants the flows are spread over", tenantNum);
+  cmd.AddValue ("burst", "Number of packets queued by each flow", burst);
+  cmd.AddValue ("size", "Packet size in bytes", packetSize);
+  cmd.AddValue ("time", "Simulated seconds to drain the queued packets", simTime);
+  cmd.AddValue ("limiter", "Rate limiter of the queue disc, Tbf or Carousel", limiter);
+  cmd.Parse (argc, argv);
+
+  // a host with one device feeding a bandwidth manager queue disc,
+  // the tenants all share one concave bandwidth function
+  SimpleNetDeviceHelper simple;
+  simple.SetDeviceAttribute ("DataRate", DataRateValue (DataRate ("10Gbps")));
+  // a short device queue makes the device wake the queue disc after each transmission
+  simple.SetQueue ("ns3::DropTailQueue<Packet>", "MaxSize", QueueSizeValue (QueueSize ("2p")));
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::BwmQueueDisc",
+                        "MaxSize", QueueSizeValue (QueueSize ("100000000p")),
+                        "Flows", UintegerValue (flowNum),
+                        "RateLimiter", StringValue (limiter));
+  BwmBenchHost host (simple, tch, CreateObject<BwmLocalAgent> (), tenantNum, "10,50000000 20,80000000");
+  Ptr<BwmQueueDisc> qdisc = host.qdisc;
+  // only the sending side is measured, the receiver discards everything
+  Ptr<RateErrorModel> discard = CreateObject<RateErrorModel> ();
+  discard->SetRate (1.0);
+  discard->SetUnit (RateErrorModel::ERROR_UNIT_PACKET);
+  host.devices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (discard));
+
+  host.Start ();
+
+  Ipv4Address dst = host.interfaces.GetAddress (1);
+  Address macDst = host.devices.Get (1)->GetAddress ();
+
+  // the flows are created outside the event loop, their memory is the growth of the process
+  uint64_t residentBefore = GetResidentBytes ();
+  for (uint32_t flow = 0; flow < flowNum; flow++)
+    {
+      for (uint32_t i = 0; i < burst; i++)
+        {
+          qdisc->Enqueue (BwmBenchBuildItem (flow, tenantNum, dst, packetSize, macDst));
+        }
+    }
+  uint64_t residentAfter = GetResidentBytes ();
+
+  uint32_t children = 0;
+  for (uint32_t i = 0; i < qdisc->GetNQueueDiscClasses (); i++)
+    {
+      children += 1 + qdisc->GetQueueDiscClass (i)->GetQueueDisc ()->GetNQueueDiscClasses ();
+    }
+
+  // drain the flows at their rates
+  uint32_t dequeuedBefore = qdisc->GetStats ().nTotalDequeuedPackets;
+  auto begin = std::chrono::steady_clock::now ();
+  Simulator::ScheduleNow (&QueueDisc::Run, qdisc);
+  Simulator::Stop (Seconds (simTime));
+  Simulator::Run ();
+  auto end = std::chrono::steady_clock::now ();
+  double totalNs = std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count ();
+  uint32_t packets = qdisc->GetStats ().nTotalDequeuedPackets - dequeuedBefore;
+
+  std::cout << "limiter,flows,bytes-per-flow,child-queue-discs,packets,seconds,ns-per-packet" << std::endl;
+  std::cout << limiter << "," << flowNum << "," << (double)(residentAfter - residentBefore) / flowNum << ","
+            << children << "," << packets << "," << totalNs * 1e-9 << "," << totalNs / packets << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
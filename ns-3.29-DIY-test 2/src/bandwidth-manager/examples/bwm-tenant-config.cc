@@ -0,0 +1,80 @@
+#include "ns3/core-module.h"
+#include "ns3/bandwidth-manager-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BwmTenantConfigTool");
+
+/**
+ * Converts text tenant configurations into the binary format read by
+ * BwmCoordinator::InputConfiguration and validates binary ones.
+ *
+ *   bwm-tenant-config --convert=tenant.txt --output=tenant.bin
+ *   bwm-tenant-config --validate=tenant.bin
+ */
+int
+main (int argc, char *argv[])
+{
+  std::string textPath;
+  std::string binaryPath;
+  std::string validatePath;
+  bool verbose = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("convert", "Text configuration to convert", textPath);
+  cmd.AddValue ("output", "Binary configuration written by --convert", binaryPath);
+  cmd.AddValue ("validate", "Binary configuration to validate", validatePath);
+  cmd.AddValue ("verbose", "Print every tenant of a validated configuration", verbose);
+  cmd.Parse (argc, argv);
+
+  if (textPath.empty () && validatePath.empty ())
+    {
+      std::cerr << "Nothing to do, give --convert and --output or --validate" << std::endl;
+      return 2;
+    }
+
+  std::string error;
+  if (!textPath.empty ())
+    {
+      if (binaryPath.empty ())
+        {
+          std::cerr << "--convert needs an --output file" << std::endl;
+          return 2;
+        }
+      if (!BwmTenantConfig::Convert (textPath, binaryPath, error))
+        {
+          std::cerr << "Conversion failed: " << error << std::endl;
+          return 1;
+        }
+      std::cout << "Converted " << textPath << " into " << binaryPath << std::endl;
+    }
+
+  if (!validatePath.empty ())
+    {
+      Ptr<BwmTenantConfig> config = Create<BwmTenantConfig> ();
+      if (!config->Open (validatePath, error))
+        {
+          std::cerr << "Invalid configuration: " << error << std::endl;
+          return 1;
+        }
+      std::cout << validatePath << " is valid, " << config->GetNTenants () << " tenants" << std::endl;
+      for (uint32_t i = 0; verbose && i < config->GetNTenants (); i++)
+        {
+          const BwmTenantConfig::Entry *entry = config->GetEntry (i);
+          std::cout << "tenant " << entry->tenantId << ":";
+          const BwmTenantConfig::Vertex *vertices = config->GetVertices (entry);
+          for (uint32_t v = 0; v < entry->vertexNum; v++)
+            {
+              std::cout << " " << vertices[v].fairShare << "," << vertices[v].bandwidth;
+            }
+          std::cout << " |";
+          const BwmTenantConfig::HostWeight *weights = config->GetHostWeights (entry);
+          for (uint32_t w = 0; w < entry->weightNum; w++)
+            {
+              std::cout << " " << weights[w].hostId << "," << weights[w].weight;
+            }
+          std::cout << std::endl;
+        }
+    }
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include "ns3/core-module.h"
+#include "ns3/bandwidth-manager-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BwmTraceConvertTool");
+
+/**
+ * Converts the binary trace streams written by BwmTraceSink into the text
+ * traces the plotting scripts read.
+ *
+ *   bwm-trace-convert --input=rx-trace.bin
+ *   bwm-trace-convert --input=rx-trace.bin --output=rx.csv
+ *
+ * Without --output the text file is the input with ".bin" replaced by ".txt".
+ * Several inputs are given as a comma-separated list, they ignore --output.
+ */
+int
+main (int argc, char *argv[])
+{
+  std::string inputPaths;
+  std::string outputPath;
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Binary trace streams to convert, comma-separated", inputPaths);
+  cmd.AddValue ("output", "Text trace written for a single input", outputPath);
+  cmd.Parse (argc, argv);
+
+  std::vector<std::string> inputs;
+  std::istringstream inputIn (inputPaths);
+  std::string path;
+  while (std::getline (inputIn, path, ','))
+    {
+      if (!path.empty ())
+        {
+          inputs.push_back (path);
+        }
+    }
+  if (inputs.empty ())
+    {
+      std::cerr << "Nothing to do, give --input" << std::endl;
+      return 2;
+    }
+
+  int status = 0;
+  for (const std::string &input : inputs)
+    {
+      std::string output = outputPath;
+      if (output.empty () || inputs.size () > 1)
+        {
+          std::string::size_type pos = input.rfind (".bin");
+          output = (pos != std::string::npos && pos + 4 == input.size () ? input.substr (0, pos) : input) + ".txt";
+        }
+
+      std::string error;
+      if (!BwmTraceSink::ConvertToCsv (input, output, error))
+        {
+          std::cerr << "Conversion failed: " << error << std::endl;
+          status = 1;
+          continue;
+        }
+      std::cout << "Converted " << input << " into " << output << std::endl;
+    }
+  return status;
+}
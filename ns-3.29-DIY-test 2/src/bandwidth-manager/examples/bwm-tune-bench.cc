@@ -0,0 +1,103 @@
+#include "bwm-bench-fixture.h"
+
+#include <chrono>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BwmTuneBench");
+
+/**
+ * Run the simulator for a number of tune cycles and return the elapsed nanoseconds.
+ */
+double
+TimeTicks (uint32_t ticks, Time tuneCycle)
+{
+  Simulator::Stop (tuneCycle * ticks);
+  auto begin = std::chrono::steady_clock::now ();
+  Simulator::Run ();
+  auto end = std::chrono::steady_clock::now ();
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count ();
+}
+
+/**
+ * Register the unit flows on one host and time the tune ticks of the local agent.
+ */
+void
+RunBench (uint32_t flowNum, uint32_t tenantNum, uint32_t ticks, double tolerance)
+{
+  Time tuneCycle = MilliSeconds (1);
+
+  // reports are pushed out of the timed window, only the tune timer fires
+  Ptr<BwmLocalAgent> agent = CreateObject<BwmLocalAgent> ();
+  agent->SetAttribute ("TuneCycle", TimeValue (tuneCycle));
+  agent->SetAttribute ("ReportCycle", TimeValue (Seconds (1000)));
+  agent->SetAttribute ("RateTolerance", DoubleValue (tolerance));
+
+  // a host with one device feeding a bandwidth manager queue disc, the tenants all
+  // share one concave bandwidth function, small enough to leave the device unsaturated
+  SimpleNetDeviceHelper simple;
+  simple.SetDeviceAttribute ("DataRate", DataRateValue (DataRate ("10Gbps")));
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::BwmQueueDisc",
+                        "MaxSize", QueueSizeValue (QueueSize ("100000000p")));
+  BwmBenchHost host (simple, tch, agent, tenantNum, "10,50000 20,80000");
+
+  host.Start ();
+
+  // one packet per unit flow registers the flows, then let the device drain them
+  Ipv4Address dst = host.interfaces.GetAddress (1);
+  for (uint32_t flow = 0; flow < flowNum; flow++)
+    {
+      host.qdisc->Enqueue (BwmBenchBuildItem (flow, tenantNum, dst));
+    }
+  TimeTicks (20, tuneCycle);
+
+  // steady: the fair shares stay at the floor, so the rates do not move
+  agent->SetNewTargetStatus (0);
+  double steadyNs = TimeTicks (ticks, tuneCycle);
+  std::cout << flowNum << "," << tolerance << ",steady," << ticks << "," << steadyNs * 1e-9 << ","
+            << steadyNs * 1e-3 / ticks << std::endl;
+
+  // moving: the fair shares converge towards a new target, every rate changes
+  agent->SetNewTargetStatus (15);
+  double movingNs = TimeTicks (ticks, tuneCycle);
+  std::cout << flowNum << "," << tolerance << ",moving," << ticks << "," << movingNs * 1e-9 << ","
+            << movingNs * 1e-3 / ticks << std::endl;
+
+  Simulator::Destroy ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t flowNum = 0;
+  uint32_t tenantNum = 100;
+  uint32_t ticks = 100;
+  double tolerance = 0;
+
+  CommandLine cmd;
+  cmd.AddValue ("flows", "Number of local unit flows, zero runs 1000 and 10000", flowNum);
+  cmd.AddValue ("tenants", "Number of tenants the flows are spread over", tenantNum);
+  cmd.AddValue ("ticks", "Number of timed tune ticks per pattern", ticks);
+  cmd.AddValue ("tolerance", "Relative rate change below which a class keeps its rate", tolerance);
+  cmd.Parse (argc, argv);
+
+  std::vector<uint32_t> flowNums;
+  if (flowNum == 0)
+    {
+      flowNums.push_back (1000);
+      flowNums.push_back (10000);
+    }
+  else
+    {
+      flowNums.push_back (flowNum);
+    }
+
+  std::cout << "flows,tolerance,pattern,ticks,seconds,us-per-tick" << std::endl;
+  for (uint32_t flows : flowNums)
+    {
+      RunBench (flows, tenantNum, ticks, tolerance);
+    }
+  return 0;
+}
@@ -2,6 +2,9 @@
 
 #include "bandwidth-function.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("BandwidthFunction");
@@ -36,57 +39,40 @@ BandwidthFunction::GetBandwidth (double fairShare) const
   // meet INF, return the upper bound
   if (fairShare == BandwidthFunction::INF)
     {
-      return m_vertexTable.back ().second;
+      return m_bandwidths.back ();
     }
 
-  auto it = m_vertexTable.begin ();
-  while (it != m_vertexTable.end ())
-  {
-    // compare the fair share of current point to the argument
-    if (it->first == fairShare)
-      {
-        auto nextIt = it + 1;
-        // check whether there exist two points with the same fair share
-        if (nextIt != m_vertexTable.end () && nextIt->first == it->first)
-          {
-            // the second point exists, use the bandwidth of second point
-            return nextIt->second;
-          }
-        else
-          {
-            // no second point, use the original bandwidth
-            return it->second;
-          }
-      }
-    else
-      {
-        // notice that the fair share of current point must be not greater than the argument
-        NS_ASSERT (it->first < fairShare);
-
-        auto nextIt = it + 1;
-        // check whether there exists a next point
-        if (nextIt != m_vertexTable.end ())
-          {
-            // a next point exists, check whether it is located in section [it->first, nextIt->first)
-            if (fairShare < nextIt->first)
-              {
-                // the target point denoted by the argument is located in this section
-                // compute the bandwidth value of argument using two endpoints of this section
-                double result = it->second + ((fairShare - it->first) / (nextIt->first - it->first)) * (nextIt->second - it->second);
-                return result;
-              }
-          }
-        else
-          {
-            // no next point, use the bandwidth of current point
-            return it->second;
-          }
-      }
-    
-    it++;
-  }
-  
-  return 0.0;
+  // locate the last point whose fair share is not greater than the argument,
+  // if several points share the same fair share, the last (highest) one is used
+  uint32_t next = UpperBound (m_fairShares, fairShare);
+  NS_ASSERT (next > 0);
+  uint32_t index = next - 1;
+
+  // the slope of the last point is zero, so the bandwidth keeps flat behind it
+  return m_bandwidths[index] + (fairShare - m_fairShares[index]) * m_slopes[index];
+}
+
+void
+BandwidthFunction::GetSegment (double fairShare, double &start, double &end, double &bandwidth, double &slope) const
+{
+  // meet INF, a flat segment at the upper bound that holds no finite fair share
+  if (fairShare == BandwidthFunction::INF)
+    {
+      start = BandwidthFunction::INF;
+      end = 0;
+      bandwidth = m_bandwidths.back ();
+      slope = 0;
+      return;
+    }
+
+  uint32_t next = UpperBound (m_fairShares, fairShare);
+  NS_ASSERT (next > 0);
+  uint32_t index = next - 1;
+
+  start = m_fairShares[index];
+  end = next < m_fairShares.size () ? m_fairShares[next] : std::numeric_limits<double>::infinity ();
+  bandwidth = m_bandwidths[index];
+  slope = m_slopes[index];
 }
 
 double
@@ -98,55 +84,32 @@ BandwidthFunction::GetFairShare (double bandwidth) const
       return BandwidthFunction::INF;
     }
 
-  auto it = m_vertexTable.begin ();
-  while (it != m_vertexTable.end ())
-  {
-    // compare the bandwidth of current point to the argument
-    if (it->second == bandwidth)
-      {
-        return it->first;
-      }
-    else
-      {
-        // notice that the bandwidth of current point must be not greater than the argument
-        NS_ASSERT (it->second < bandwidth);
-
-        auto nextIt = it + 1;
-        // check whether there exists a next point
-        if (nextIt != m_vertexTable.end ())
-          {
-            // a next point exists, check whether it is located in section [it->second, nextIt->second)
-            if (bandwidth < nextIt->second)
-              {
-                // the target point denoted by the argument is located in this section
-                // compute the bandwidth value of argument using two endpoints of this section
-                double result = it->first + ((bandwidth - it->second) / (nextIt->second - it->second)) * (nextIt->first - it->first);
-                return result;
-              }
-          }
-        else
-          {
-            // no next point, the fair share corresponding to the argument doesn't exist
-            return BandwidthFunction::INF;
-          }
-      }
-    
-    it++;
-  }
-
-  return 0.0;
+  // locate the first point whose bandwidth is not less than the argument
+  uint32_t index = LowerBound (m_bandwidths, bandwidth);
+  if (index == m_bandwidths.size ())
+    {
+      // no such point, the fair share corresponding to the argument doesn't exist
+      return BandwidthFunction::INF;
+    }
+  if (m_bandwidths[index] == bandwidth)
+    {
+      return m_fairShares[index];
+    }
+
+  // the argument is located in section (index - 1, index)
+  NS_ASSERT (index > 0);
+  index--;
+  return m_fairShares[index] + (bandwidth - m_bandwidths[index]) * m_inverseSlopes[index];
 }
 
 double
 BandwidthFunction::GetNextInterestingPointByBW (double currentBandwidth) const
 {
-  for (auto it : m_vertexTable)
+  // find the point that is just above current bandwidth
+  uint32_t index = UpperBound (m_bandwidths, currentBandwidth);
+  if (index < m_bandwidths.size ())
     {
-      if (it.second > currentBandwidth)
-        {
-          // find the point that is just above current bandwidth
-          return it.second;
-        }
+      return m_bandwidths[index];
     }
 
   // no next interesting point
@@ -156,13 +119,11 @@ BandwidthFunction::GetNextInterestingPointByBW (double currentBandwidth) const
 double
 BandwidthFunction::GetNextInterestingPointByFS (double currentFairShare) const
 {
-  for (auto it : m_vertexTable)
+  // find the point that is just behind current fair share.
+  uint32_t index = UpperBound (m_fairShares, currentFairShare);
+  if (index < m_fairShares.size ())
     {
-      if (it.first > currentFairShare)
-        {
-          // find the point that is just behind current fair share.
-          return it.first;
-        }
+      return m_fairShares[index];
     }
 
   // no next interesting point
@@ -172,21 +133,89 @@ BandwidthFunction::GetNextInterestingPointByFS (double currentFairShare) const
 bool
 BandwidthFunction::AddVertex (double fairShare, double bandwidth)
 {
-  if (m_vertexTable.empty () == false && bandwidth < m_vertexTable.back ().second) return false;
+  if (m_fairShares.empty () == false
+      && (bandwidth < m_bandwidths.back () || fairShare < m_fairShares.back ()))
+    {
+      return false;
+    }
+
+  if (m_fairShares.empty () == false)
+    {
+      // the last point now starts a real segment, compute its slopes
+      double deltaFS = fairShare - m_fairShares.back ();
+      double deltaBW = bandwidth - m_bandwidths.back ();
+      m_slopes.back () = deltaFS > 0 ? deltaBW / deltaFS : 0.0;
+      m_inverseSlopes.back () = deltaBW > 0 ? deltaFS / deltaBW : 0.0;
+    }
 
-  auto newVertex = std::make_pair (fairShare, bandwidth);
-  m_vertexTable.push_back (newVertex);
+  m_fairShares.push_back (fairShare);
+  m_bandwidths.push_back (bandwidth);
+  m_slopes.push_back (0.0);
+  m_inverseSlopes.push_back (0.0);
   return true;
 }
 
+uint32_t
+BandwidthFunction::GetNVertices (void) const
+{
+  return m_fairShares.size ();
+}
+
+std::pair<double, double>
+BandwidthFunction::GetVertex (uint32_t index) const
+{
+  NS_ASSERT (index < m_fairShares.size ());
+  return std::make_pair (m_fairShares[index], m_bandwidths[index]);
+}
+
+uint32_t
+BandwidthFunction::UpperBound (const std::vector<double>& column, double value)
+{
+  if (column.size () <= LINEAR_SEARCH_LIMIT)
+    {
+      // the column is sorted, so counting the elements not greater than the value
+      // gives the index of the first greater one, without any branch in the loop
+      uint32_t count = 0;
+      for (uint32_t i = 0; i < column.size (); i++)
+        {
+          count += (column[i] <= value);
+        }
+      return count;
+    }
+
+  return std::upper_bound (column.begin (), column.end (), value) - column.begin ();
+}
+
+uint32_t
+BandwidthFunction::LowerBound (const std::vector<double>& column, double value)
+{
+  if (column.size () <= LINEAR_SEARCH_LIMIT)
+    {
+      uint32_t count = 0;
+      for (uint32_t i = 0; i < column.size (); i++)
+        {
+          count += (column[i] < value);
+        }
+      return count;
+    }
+
+  return std::lower_bound (column.begin (), column.end (), value) - column.begin ();
+}
+
 std::ostream&
 operator << (std::ostream& out, const BandwidthFunction& bf)
 {
-  for (auto pair : bf.m_vertexTable)
+  for (uint32_t i = 0; i < bf.m_fairShares.size (); i++)
     {
-      out << pair.first << "," << pair.second << " ";
+      out << bf.m_fairShares[i] << "," << bf.m_bandwidths[i] << " ";
     }
   return out;
 }
 
+bool
+operator == (const BandwidthFunction& left, const BandwidthFunction& right)
+{
+  return left.m_fairShares == right.m_fairShares && left.m_bandwidths == right.m_bandwidths;
+}
+
 }
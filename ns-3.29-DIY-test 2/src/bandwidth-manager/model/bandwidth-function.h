@@ -14,6 +14,12 @@ namespace ns3 {
  * 
  * A bandwidth function is a linear monotonically increasing fucntion
  * that map fair share to bandwidth
+ *
+ * The vertices are stored as two sorted columns (fair share and bandwidth)
+ * together with the precomputed slope of each segment, so that every lookup
+ * is a search over a contiguous array of doubles followed by one multiply-add.
+ * Small tables are searched by a branch-free counting loop, larger ones by
+ * binary search.
  */
 class BandwidthFunction : public Object {
 public:
@@ -39,9 +45,19 @@ public:
    * \return the minimum fair share that can reach the bandwidth
    */
   double GetFairShare (double bandwidth) const;
+  /**
+   * \brief Get the linear segment containing the fair share.
+   *
+   * Inside [start, end) the bandwidth equals bandwidth + (fairShare - start) * slope,
+   * so callers can evaluate many fair shares of the segment without searching.
+   * INF lies in the flat segment [INF, 0) at the upper bound, as in GetBandwidth.
+   */
+  void GetSegment (double fairShare, double &start, double &end, double &bandwidth, double &slope) const;
   /**
    * \brief Add a new vertex to this bandwidth function.
    * \return true if the operation succeeds, false otherwise
+   *
+   * Both coordinates of the new vertex must be not less than those of the last vertex.
    */
   bool AddVertex (double fairShare, double bandwidth);
   /**
@@ -54,15 +70,46 @@ public:
    * \return if there exists an interesting point, the bandwidth of the next interesting point, otherwise -1.
    */
   double GetNextInterestingPointByBW (double currentBandwidth) const;
+  /**
+   * \brief Get the number of vertices of this bandwidth function.
+   * \return the number of vertices, including the origin
+   */
+  uint32_t GetNVertices (void) const;
+  /**
+   * \brief Get a vertex of this bandwidth function.
+   * \return the (fair share, bandwidth) pair of the vertex denoted by index
+   */
+  std::pair<double, double> GetVertex (uint32_t index) const;
   /**
    * \brief Overload the output operator to print bandwidth function.
    * \return The output stream.
    */
   friend std::ostream& operator << (std::ostream& out, const BandwidthFunction& bf);
+  /**
+   * \brief Compare the vertices of two bandwidth functions.
+   * \return true if both functions have exactly the same vertices.
+   */
+  friend bool operator == (const BandwidthFunction& left, const BandwidthFunction& right);
 
   static constexpr double INF = -1;
+  static constexpr uint32_t LINEAR_SEARCH_LIMIT = 16; //!< Tables up to this size are searched without branches
+
 private:
-  std::vector<std::pair<double, double>> m_vertexTable; //!< the vertex table that records each non-trivival point 
+  /**
+   * \brief Search a sorted column for the first element greater than the value.
+   * \return the index of the element, or the size of the column if there is none
+   */
+  static uint32_t UpperBound (const std::vector<double>& column, double value);
+  /**
+   * \brief Search a sorted column for the first element not less than the value.
+   * \return the index of the element, or the size of the column if there is none
+   */
+  static uint32_t LowerBound (const std::vector<double>& column, double value);
+
+  std::vector<double> m_fairShares; //!< Fair share of each non-trivival point, in ascending order
+  std::vector<double> m_bandwidths; //!< Bandwidth of each non-trivival point, in ascending order
+  std::vector<double> m_slopes; //!< Slope (bandwidth / fair share) of the segment starting at each point
+  std::vector<double> m_inverseSlopes; //!< Slope (fair share / bandwidth) of the segment starting at each point
 };
 
 }
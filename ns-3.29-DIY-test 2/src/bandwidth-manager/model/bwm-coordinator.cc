@@ -1,15 +1,25 @@
 #include "ns3/log.h"
 #include "ns3/string.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4.h"
+#include "ns3/node-list.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/bwm-control-header.h"
+#include "ns3/bwm-profiler.h"
 
 #include "bwm-coordinator.h"
 #include "bwm-local-agent.h"
 #include "bandwidth-function.h"
 
+#include <algorithm>
 #include <sstream>
 #include <fstream>
-#include <queue>
-#include <functional>
 
 namespace ns3 {
 
@@ -42,6 +52,12 @@ UnitFlow::UnitFlow ()
     m_tenantId (0),
     m_configuredBF (NULL),
     m_transformedBF (NULL),
+    m_accountedUsage (0),
+    m_pinnedFS (-1),
+    m_srcHostId (-1),
+    m_dstHostId (-1),
+    m_deviceRateLimit (0),
+    m_transformPending (false),
     m_usage (0),
     m_allocatedFS (0),
     m_congestionFactor (0)
@@ -75,7 +91,7 @@ UnitFlow::GetTransformedBF ()
 void
 UnitFlow::SetTransformedBF (Ptr<BandwidthFunction> transformedBF)
 {
-  NS_LOG_UNCOND ("Trans TBF: " << *transformedBF << " for flow " << m_traceId);
+  NS_LOG_DEBUG ("Trans TBF: " << *transformedBF << " for flow " << m_traceId);
   m_transformedBF = transformedBF;
 }
 
@@ -151,6 +167,68 @@ UnitFlow::GetCongestionFactor (void) const
   return m_congestionFactor;
 }
 
+void
+UnitFlow::SetPinnedFS (double fairShare)
+{
+  m_pinnedFS = fairShare;
+}
+
+double
+UnitFlow::GetPinnedFS (void) const
+{
+  return m_pinnedFS;
+}
+
+void
+UnitFlow::SetAccountedUsage (double usage)
+{
+  m_accountedUsage = usage;
+}
+
+double
+UnitFlow::GetAccountedUsage (void) const
+{
+  return m_accountedUsage;
+}
+
+void
+UnitFlow::SetEndHosts (uint32_t srcHostId, uint32_t dstHostId, double deviceRateLimit)
+{
+  m_srcHostId = srcHostId;
+  m_dstHostId = dstHostId;
+  m_deviceRateLimit = deviceRateLimit;
+}
+
+uint32_t
+UnitFlow::GetSrcHostId (void) const
+{
+  return m_srcHostId;
+}
+
+uint32_t
+UnitFlow::GetDstHostId (void) const
+{
+  return m_dstHostId;
+}
+
+double
+UnitFlow::GetDeviceRateLimit (void) const
+{
+  return m_deviceRateLimit;
+}
+
+void
+UnitFlow::SetTransformPending (bool pending)
+{
+  m_transformPending = pending;
+}
+
+bool
+UnitFlow::IsTransformPending (void) const
+{
+  return m_transformPending;
+}
+
 double
 UnitFlow::GetAllocatedRate (void) const
 {
@@ -182,6 +260,8 @@ Tenant::GetTypeId ()
 Tenant::Tenant ()
   : m_tenantId (0),
     m_BF (NULL),
+    m_transformDirty (false),
+    m_usageSum (0),
     m_actualFairShare (0)
 {
 
@@ -207,65 +287,100 @@ Tenant::SetTenantId (uint32_t tenantId)
 void
 Tenant::SetBF (std::string bfStr)
 {
-  std::istringstream sin (bfStr);
-
   // analyze the bandwidth function of new tenant
+  std::vector<BwmTenantConfig::Vertex> vertices;
+  std::string error;
+  if (!BwmTenantConfig::ParseVertices (bfStr, vertices, error))
+    {
+      NS_FATAL_ERROR ("Invalid bandwidth function of tenant " << m_tenantId << ": " << error);
+    }
+
   Ptr<BandwidthFunction> newBF (new BandwidthFunction);
-  std::string pointPair;
-  while (sin >> pointPair)
+  for (auto &vertex : vertices)
     {
-      // extract the info of point
-      int split = pointPair.find (',');
-      std::string fairShare = pointPair.substr (0, split);
-      std::string bandwidth = pointPair.substr (split + 1, pointPair.length ());
-      if (fairShare.length () == 0 || bandwidth.length () == 0)
-        {
-          NS_LOG_WARN ("Invalid input format!");
-          NS_ASSERT (0);
-        }
-      
-      // add a new point to the bandwidth function of new tenant
-      newBF->AddVertex (atof (fairShare.c_str ()), atof (bandwidth.c_str ()));
+      newBF->AddVertex (vertex.fairShare, vertex.bandwidth);
     }
 
   m_BF = newBF;
+  m_transformDirty = true;
+}
+
+void
+Tenant::SetBF (Ptr<BandwidthFunction> bf)
+{
+  m_BF = bf;
+  m_transformDirty = true;
+}
+
+Ptr<BandwidthFunction>
+Tenant::GetBF () const
+{
+  return m_BF;
 }
 
 void
 Tenant::SetHostWeightTable (std::string entryListStr)
 {
-  std::istringstream sin (entryListStr);
+  for (auto &entry : ParseHostWeights (entryListStr))
+    {
+      // add a new entry to the host weight table of new tenant
+      m_hostWeightTable.insert (std::make_pair (entry.hostId, entry.weight));
+    }
+}
 
-  std::string hwPair;
-  while (sin >> hwPair)
+void
+Tenant::SetHostWeight (uint32_t hostId, double weight)
+{
+  m_hostWeightTable.insert (std::make_pair (hostId, weight));
+}
+
+std::vector<uint32_t>
+Tenant::UpdateHostWeightTable (std::string entryListStr)
+{
+  std::vector<uint32_t> changedHosts;
+  for (auto &entry : ParseHostWeights (entryListStr))
     {
-      // extract the info of host-weight pair
-      int split = hwPair.find (',');
-      std::string hostId = hwPair.substr (0, split);
-      std::string weight = hwPair.substr (split + 1, hwPair.length ());
-      if (hostId.length () == 0 || weight.length () == 0)
+      // a host without an entry has the default weight
+      if (GetHostWeight (entry.hostId) != entry.weight)
         {
-          NS_LOG_WARN ("Invalid input format!");
-          NS_ASSERT (0);
+          changedHosts.push_back (entry.hostId);
         }
-      
-      // add a new entry to the host weight table of new tenant
-      m_hostWeightTable.insert (std::make_pair (atoi (hostId.c_str ()), atof (weight.c_str ())));
+      m_hostWeightTable[entry.hostId] = entry.weight;
     }
+  return changedHosts;
 }
 
-double
-Tenant::GetActualFS ()
+std::vector<BwmTenantConfig::HostWeight>
+Tenant::ParseHostWeights (std::string entryListStr) const
 {
-  double usageSum=0;
-  for (auto it : m_flowTable)
+  std::vector<BwmTenantConfig::HostWeight> weights;
+  std::string error;
+  if (!BwmTenantConfig::ParseHostWeights (entryListStr, weights, error))
     {
-      usageSum += it.second->GetBandwidthUsage();
+      NS_FATAL_ERROR ("Invalid host weights of tenant " << m_tenantId << ": " << error);
     }
-  m_actualFairShare = m_BF->GetFairShare(usageSum);
+  return weights;
+}
+
+double
+Tenant::GetActualFS ()
+{
+  SetActualFS (ComputeActualFS ());
   return m_actualFairShare;
 }
 
+double
+Tenant::ComputeActualFS () const
+{
+  return m_BF->GetFairShare (m_usageSum);
+}
+
+void
+Tenant::SetActualFS (double fairShare)
+{
+  m_actualFairShare = fairShare;
+}
+
 double
 Tenant::GetHostWeight (uint32_t hostId)
 {
@@ -280,55 +395,64 @@ Tenant::GetHostWeight (uint32_t hostId)
 }
 
 void
-Tenant::TransformComponentialBF ()
+Tenant::ApplyAggregateDelta (Ptr<BandwidthFunction> bf, int32_t sign)
 {
-  // collect bandwidth functions of all unit flows
-  std::vector<Ptr<BandwidthFunction> > BFArray;
-  for (auto flow : m_flowTable)
+  // decompose the bandwidth function into slope changes and jumps at its vertices,
+  // the sum of all decompositions describes the aggregated bandwidth function
+  double prevSlope = 0.0;
+  uint32_t vertexNum = bf->GetNVertices ();
+  for (uint32_t i = 0; i < vertexNum; i++)
     {
-      BFArray.push_back (flow.second->GetConfiguredBF ());
-    }
+      auto vertex = bf->GetVertex (i);
 
-  // compute the aggregated bandwidth function
+      double slope = 0.0;
+      if (i + 1 < vertexNum)
+        {
+          auto nextVertex = bf->GetVertex (i + 1);
+          if (nextVertex.first > vertex.first)
+            {
+              slope = (nextVertex.second - vertex.second) / (nextVertex.first - vertex.first);
+            }
+        }
 
-  Ptr<BandwidthFunction> aggregateBF (new BandwidthFunction);
-  /// initialize the heap of interesting points
-  auto BFCmp = [] (std::pair<double, int> left, std::pair<double, int> right) -> bool { return left.first < right.first; };
-  /* std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, BC_Cmp1> interestingPointsList; */
-  std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::function<bool (std::pair<double, int> left, std::pair<double, int> right)>> interestingPointsList(BFCmp);
-  int counter = 0;
-  for (auto bf : BFArray)
-    {
-      if (bf->GetNextInterestingPointByFS (0) > 0)
+      double jump = 0.0;
+      if (i > 0 && bf->GetVertex (i - 1).first == vertex.first)
         {
-          interestingPointsList.push (std::make_pair (bf->GetNextInterestingPointByFS (0), counter));
+          jump = vertex.second - bf->GetVertex (i - 1).second;
         }
-      counter++;
-    }
-  
-  /// check each interesting point and compute aggregated bandwidth value for them
-  while (interestingPointsList.empty () != true)
-    {
-      double minPoint = interestingPointsList.top ().first;
-      //// sum bandwidth values of all bandwith functions at the min point
-      double sum = 0.0;
-      for (auto bf : BFArray)
+
+      AggregateDelta &delta = m_aggregateDeltas[vertex.first];
+      delta.slope += sign * (slope - prevSlope);
+      delta.jump += sign * jump;
+      delta.refCount += sign;
+      if (delta.refCount == 0)
         {
-          sum += bf->GetBandwidth (minPoint);
+          // no flow contributes to this breakpoint any more
+          m_aggregateDeltas.erase (vertex.first);
         }
 
-      aggregateBF->AddVertex (minPoint, sum);
+      prevSlope = slope;
+    }
+
+  m_transformDirty = true;
+}
 
-      //// get next interesting points of the bandwidth functions that have the minPoint
-      //// and use them to replace minPoints in the heap
-      while (interestingPointsList.empty () != true && interestingPointsList.top ().first == minPoint)
+bool
+Tenant::UpdateTransformMap ()
+{
+  // compute the aggregated bandwidth function by integrating the breakpoints
+  Ptr<BandwidthFunction> aggregateBF (new BandwidthFunction);
+  double lastPoint = 0.0;
+  double bandwidth = 0.0;
+  double slope = 0.0;
+  for (auto it : m_aggregateDeltas)
+    {
+      bandwidth += slope * (it.first - lastPoint) + it.second.jump;
+      slope += it.second.slope;
+      lastPoint = it.first;
+      if (it.first > 0)
         {
-          int targetBF = interestingPointsList.top ().second;
-          interestingPointsList.pop ();
-          if (BFArray[targetBF]->GetNextInterestingPointByFS (minPoint) > 0)
-            {
-              interestingPointsList.push (std::make_pair (BFArray[targetBF]->GetNextInterestingPointByFS (minPoint), targetBF));
-            }
+          aggregateBF->AddVertex (it.first, bandwidth);
         }
     }
 
@@ -367,43 +491,181 @@ Tenant::TransformComponentialBF ()
         }
     }
 
-  // transform each unit flow's bandwidth function
-  for (auto flow : m_flowTable)
+  if (transformMap == m_transformMap)
+    {
+      return false;
+    }
+  m_transformMap.swap (transformMap);
+  return true;
+}
+
+void
+Tenant::TransformUnitFlow (Ptr<UnitFlow> flow)
+{
+  Ptr<BandwidthFunction> transformedBF (new BandwidthFunction);
+  Ptr<BandwidthFunction> configuredBF = flow->GetConfiguredBF ();
+  for (auto vertex : m_transformMap)
+    {
+      transformedBF->AddVertex (vertex.second, configuredBF->GetBandwidth (vertex.first));
+    }
+
+  // only hand over the function if its breakpoints actually changed
+  Ptr<BandwidthFunction> oldBF = flow->GetTransformedBF ();
+  if (oldBF == NULL || !(*oldBF == *transformedBF))
     {
-      Ptr<BandwidthFunction> transformedBF (new BandwidthFunction);
-      Ptr<BandwidthFunction> configuredBF = flow.second->GetConfiguredBF ();
-      for (auto vertex : transformMap)
+      m_stagedBFs.push_back (std::make_pair (flow, transformedBF));
+    }
+}
+
+void
+Tenant::TransformComponentialBF ()
+{
+  BwmProfiler::Scope scope (BwmProfiler::COORDINATOR);
+  PrepareTransform ();
+  CommitTransform ();
+}
+
+void
+Tenant::PrepareTransform ()
+{
+  bool mapChanged = false;
+  if (m_transformDirty)
+    {
+      mapChanged = UpdateTransformMap ();
+      m_transformDirty = false;
+    }
+
+  if (mapChanged)
+    {
+      // the transformation map changed, every flow may be affected
+      for (auto flow : m_flowTable)
         {
-          transformedBF->AddVertex (vertex.second, configuredBF->GetBandwidth (vertex.first));
+          TransformUnitFlow (flow.second);
         }
-      flow.second->SetTransformedBF (transformedBF);
     }
+  else
+    {
+      // only the flows that joined since the last transformation need a new function
+      for (auto flow : m_pendingFlows)
+        {
+          TransformUnitFlow (flow);
+        }
+    }
+  for (auto flow : m_pendingFlows)
+    {
+      flow->SetTransformPending (false);
+    }
+  m_pendingFlows.clear ();
+}
+
+void
+Tenant::CommitTransform ()
+{
+  for (auto &staged : m_stagedBFs)
+    {
+      staged.first->SetTransformedBF (staged.second);
+    }
+  m_stagedBFs.clear ();
+}
+
+void
+Tenant::ScheduleTransform ()
+{
+  if (m_transformEvent.IsRunning ())
+    {
+      return;
+    }
+  m_transformEvent = Simulator::ScheduleNow (&Tenant::TransformComponentialBF, this);
 }
 
 void
 Tenant::AddUnitFlow (Ptr<UnitFlow> flow)
 {
-  NS_LOG_UNCOND ("Add flow " << flow->GetFlowId () << " trace id " << flow->GetTraceId ());
+  NS_LOG_LOGIC ("Add flow " << flow->GetFlowId () << " trace id " << flow->GetTraceId ());
+  NS_ASSERT (flow->GetConfiguredBF ());
   m_flowTable.insert (std::make_pair (flow->GetFlowId (), flow));
+  ApplyAggregateDelta (flow->GetConfiguredBF (), 1);
+  flow->SetTransformPending (true);
+  m_pendingFlows.push_back (flow);
 }
 
 void
-Tenant::UpdateUnitFlow (Ptr<UnitFlow> targetFlow)
+Tenant::RemoveUnitFlow (Ptr<UnitFlow> flow)
 {
-  uint32_t flowId = targetFlow->GetFlowId ();
+  auto it = m_flowTable.find (flow->GetFlowId ());
+  if (it == m_flowTable.end ())
+    {
+      NS_LOG_WARN ("Try to remove unregistered unit-flow");
+      return;
+    }
+
+  ApplyAggregateDelta (it->second->GetConfiguredBF (), -1);
+  m_usageSum = std::max (m_usageSum - it->second->GetAccountedUsage (), 0.0);
+  it->second->SetAccountedUsage (0);
+  if (it->second->IsTransformPending ())
+    {
+      it->second->SetTransformPending (false);
+      m_pendingFlows.remove (it->second);
+    }
+  m_flowTable.erase (it);
+}
 
-  // check whether this unit flow has been registered
-  if (m_flowTable.find (flowId) == m_flowTable.end ())
+void
+Tenant::ReconfigureUnitFlow (Ptr<UnitFlow> flow, Ptr<BandwidthFunction> bf)
+{
+  NS_ASSERT (m_flowTable.find (flow->GetFlowId ()) != m_flowTable.end ());
+  ApplyAggregateDelta (flow->GetConfiguredBF (), -1);
+  flow->SetConfiguredBF (bf);
+  ApplyAggregateDelta (bf, 1);
+  if (!flow->IsTransformPending ())
     {
-      // unregistered, warning
+      flow->SetTransformPending (true);
+      m_pendingFlows.push_back (flow);
+    }
+}
+
+const std::map<uint32_t, Ptr<UnitFlow> >&
+Tenant::GetUnitFlows () const
+{
+  return m_flowTable;
+}
+
+void
+Tenant::UpdateUnitFlowUsage (uint32_t flowId, double usage)
+{
+  auto it = m_flowTable.find (flowId);
+  if (it == m_flowTable.end ())
+    {
+      // the flow may have been evicted while the report was in flight
       NS_LOG_WARN ("Try to update unregistered unit-flow");
+      return;
     }
-  else
+
+  AccountUsage (it->second, usage);
+}
+
+void
+Tenant::AccountUsage (Ptr<UnitFlow> flow, double usage)
+{
+  // apply the change of usage to the running sum
+  m_usageSum = std::max (m_usageSum + usage - flow->GetAccountedUsage (), 0.0);
+  flow->SetAccountedUsage (usage);
+}
+
+void
+Tenant::UpdateUnitFlow (Ptr<UnitFlow> targetFlow)
+{
+  // check whether this unit flow has been registered, a flow evicted by
+  // DeregisterFlow must not add to the usage sum any more
+  auto it = m_flowTable.find (targetFlow->GetFlowId ());
+  if (it == m_flowTable.end () || it->second != targetFlow)
     {
-      // registered, update this unit flow
-      m_flowTable[flowId] = targetFlow;
+      NS_LOG_WARN ("Try to update unregistered unit-flow");
+      return;
     }
 
+  AccountUsage (targetFlow, targetFlow->GetBandwidthUsage ());
+
   // TODO: add time stamp
 }
 
@@ -426,6 +688,50 @@ BwmCoordinator::GetTypeId ()
                    DoubleValue (3),
                    MakeDoubleAccessor (&BwmCoordinator::m_minFS),
                    MakeDoubleChecker<double> ())
+    .AddAttribute ("CoalesceTransforms",
+                   "Transform each tenant once for all unit flows registered at the same time; "
+                   "the allocated rate of a new flow stays zero until the deferred transform ran",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BwmCoordinator::m_coalesceTransforms),
+                   MakeBooleanChecker ())
+    .AddAttribute ("UpdateMode",
+                   "Whether the target status is estimated on every usage report or once per epoch",
+                   EnumValue (BwmCoordinator::PER_REPORT),
+                   MakeEnumAccessor (&BwmCoordinator::m_updateMode),
+                   MakeEnumChecker (BwmCoordinator::PER_REPORT, "PerReport",
+                                    BwmCoordinator::EPOCH, "Epoch"))
+    .AddAttribute ("WorkerThreads",
+                   "Worker threads transforming coalesced tenants and computing their fair shares in parallel, zero runs sequentially",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&BwmCoordinator::m_workerThreads),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Allocator",
+                   "Whether fair shares come from Target Status Estimation or exact water-filling over the links",
+                   EnumValue (BwmCoordinator::ESTIMATION),
+                   MakeEnumAccessor (&BwmCoordinator::m_allocator),
+                   MakeEnumChecker (BwmCoordinator::ESTIMATION, "Estimation",
+                                    BwmCoordinator::WATER_FILLING, "WaterFilling"))
+    .AddAttribute ("EpochLength",
+                   "The interval between two estimations in epoch mode",
+                   TimeValue (MilliSeconds (5)),
+                   MakeTimeAccessor (&BwmCoordinator::m_epochLength),
+                   MakeTimeChecker ())
+    .AddAttribute ("ControlTransport",
+                   "Whether reports and target status are method calls or UDP packets over the network",
+                   EnumValue (BwmCoordinator::DIRECT),
+                   MakeEnumAccessor (&BwmCoordinator::m_controlTransport),
+                   MakeEnumChecker (BwmCoordinator::DIRECT, "Direct",
+                                    BwmCoordinator::UDP, "Udp"))
+    .AddAttribute ("ReportPort",
+                   "The UDP port the coordinator receives usage reports on",
+                   UintegerValue (12451),
+                   MakeUintegerAccessor (&BwmCoordinator::m_reportPort),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("StatusPort",
+                   "The UDP port local agents receive target status on",
+                   UintegerValue (12452),
+                   MakeUintegerAccessor (&BwmCoordinator::m_statusPort),
+                   MakeUintegerChecker<uint16_t> ())
     .AddTraceSource ("TenantCreate",
                      "Create a tenant",
                      MakeTraceSourceAccessor (&BwmCoordinator::m_tenantCreateTrace),
@@ -434,13 +740,19 @@ BwmCoordinator::GetTypeId ()
                      "Create a unit-flow",
                      MakeTraceSourceAccessor (&BwmCoordinator::m_unitFlowCreateTrace),
                      "ns3::BwmQueueDisc::UnitFlowTracedCallback")                                 
+    .AddTraceSource ("UnitFlowRemove",
+                     "Deregister a unit-flow that has ended",
+                     MakeTraceSourceAccessor (&BwmCoordinator::m_unitFlowRemoveTrace),
+                     "ns3::BwmQueueDisc::UnitFlowTracedCallback")
   ;
   return tid;
 }
 
 BwmCoordinator::BwmCoordinator ()
+  : m_epochTimer (Timer::CANCEL_ON_DESTROY)
 {
   m_hostCounter = 0;
+  m_unbuiltTenantNum = 0;
   m_flowFactory.SetTypeId (UnitFlow::GetTypeId ());
   m_tenantFactory.SetTypeId (Tenant::GetTypeId ());
 }
@@ -450,21 +762,66 @@ BwmCoordinator::~BwmCoordinator ()
 
 }
 
+void
+BwmCoordinator::DoDispose (void)
+{
+  // break the reference cycles between the root, its shards and the hosts
+  m_root = 0;
+  m_shardTable.clear ();
+  m_tenantTable.clear ();
+  m_tenantConfig = 0;
+  m_transformQueue.clear ();
+  m_workers.Stop ();
+  m_hostList.clear ();
+  m_reportProgress.clear ();
+  Application::DoDispose ();
+}
+
 void
 BwmCoordinator::StartApplication ()
 {
   // pre-process
+  if (m_controlTransport == BwmCoordinator::UDP)
+    {
+      m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+      if (m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_reportPort)) == -1)
+        {
+          // e.g. a shard on the node and port of another coordinator
+          NS_FATAL_ERROR ("Failed to bind the report socket to port " << m_reportPort);
+        }
+      m_socket->SetRecvCallback (MakeCallback (&BwmCoordinator::HandleReport, this));
+    }
+
+  if (m_updateMode == BwmCoordinator::EPOCH && !m_root)
+    {
+      // only the root closes epochs
+      m_epochTimer.SetFunction (&BwmCoordinator::CloseEpoch, this);
+      m_epochTimer.Schedule (m_epochLength);
+    }
 }
 
 void
 BwmCoordinator::StopApplication ()
 {
   // post-process
+  m_epochTimer.Cancel ();
+  if (m_socket)
+    {
+      m_socket->Close ();
+      m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_socket = 0;
+    }
 }
 
 void
 BwmCoordinator::InputConfiguration (std::string filePath)
 {
+  if (BwmTenantConfig::IsBinary (filePath))
+    {
+      InputBinaryConfiguration (filePath);
+      return;
+    }
+
   std::ifstream fin (filePath);
   if (fin.fail ())
     {
@@ -480,7 +837,7 @@ BwmCoordinator::InputConfiguration (std::string filePath)
           // meet a solid string, add a tenant
           Ptr<Tenant> newTenant = m_tenantFactory.Create<Tenant> ();
           uint32_t tenantId = atoi (input.c_str ());
-          m_tenantTable.insert (std::make_pair (tenantId, newTenant));
+          GetShard (tenantId)->m_tenantTable.insert (std::make_pair (tenantId, newTenant));
           newTenant->SetTenantId (tenantId);
 
           // incorporate the bandwidth function to the new tenant
@@ -516,6 +873,66 @@ BwmCoordinator::InputConfiguration (std::string filePath)
     }
 }
 
+void
+BwmCoordinator::InputBinaryConfiguration (std::string filePath)
+{
+  Ptr<BwmTenantConfig> config = Create<BwmTenantConfig> ();
+  std::string error;
+  if (!config->Open (filePath, error))
+    {
+      NS_FATAL_ERROR ("Invalid tenant configuration: " << error);
+    }
+
+  // every coordinator builds its own tenants from the shared mapping
+  m_tenantConfig = config;
+  for (auto shard : m_shardTable)
+    {
+      shard.second->m_tenantConfig = config;
+    }
+  for (uint32_t i = 0; i < config->GetNTenants (); i++)
+    {
+      GetShard (config->GetEntry (i)->tenantId)->m_unbuiltTenantNum++;
+    }
+}
+
+Ptr<Tenant>
+BwmCoordinator::GetTenant (uint32_t tenantId)
+{
+  auto it = m_tenantTable.find (tenantId);
+  if (it != m_tenantTable.end ())
+    {
+      return it->second;
+    }
+
+  const BwmTenantConfig::Entry *entry = m_tenantConfig ? m_tenantConfig->Find (tenantId) : NULL;
+  if (entry == NULL)
+    {
+      return NULL;
+    }
+
+  // build the tenant from its record in place, the record has been validated
+  Ptr<Tenant> newTenant = m_tenantFactory.Create<Tenant> ();
+  newTenant->SetTenantId (tenantId);
+  Ptr<BandwidthFunction> bf (new BandwidthFunction);
+  const BwmTenantConfig::Vertex *vertices = m_tenantConfig->GetVertices (entry);
+  for (uint32_t i = 0; i < entry->vertexNum; i++)
+    {
+      bf->AddVertex (vertices[i].fairShare, vertices[i].bandwidth);
+    }
+  newTenant->SetBF (bf);
+  const BwmTenantConfig::HostWeight *weights = m_tenantConfig->GetHostWeights (entry);
+  for (uint32_t i = 0; i < entry->weightNum; i++)
+    {
+      newTenant->SetHostWeight (weights[i].hostId, weights[i].weight);
+    }
+  NS_LOG_INFO ("Build tenant " << tenantId << " on its first unit flow");
+
+  m_tenantTable.insert (std::make_pair (tenantId, newTenant));
+  m_unbuiltTenantNum--;
+  m_tenantCreateTrace (newTenant);
+  return newTenant;
+}
+
 bool
 BwmCoordinator::RegisterHost (Ptr<BwmLocalAgent> host)
 {
@@ -528,16 +945,47 @@ BwmCoordinator::RegisterHost (Ptr<BwmLocalAgent> host)
   
   // insert the new host into the host list
   m_hostList.push_back (host);
+  for (auto shard : m_shardTable)
+    {
+      shard.second->m_hostList.push_back (host);
+    }
   // assign host id
   host->SetHostId (m_hostCounter);
   m_hostCounter++;
   return true;
 }
 
+void
+BwmCoordinator::AddShard (Ptr<BwmCoordinator> shard, uint32_t lastTenantId)
+{
+  NS_ASSERT_MSG (!m_root, "A shard cannot have shards of its own");
+  NS_ASSERT_MSG (shard->m_shardTable.empty (), "A root cannot be a shard");
+  NS_ASSERT_MSG (m_shardTable.find (lastTenantId) == m_shardTable.end (),
+                 "Tenant range already owned by another shard: " << lastTenantId);
+
+  shard->m_root = this;
+  shard->m_hostList = m_hostList;
+  m_shardTable.insert (std::make_pair (lastTenantId, shard));
+}
+
+Ptr<BwmCoordinator>
+BwmCoordinator::GetShard (uint32_t tenantId)
+{
+  // the owner is the shard with the smallest bound not below the tenant id
+  auto it = m_shardTable.lower_bound (tenantId);
+  if (it == m_shardTable.end ())
+    {
+      return this;
+    }
+  return it->second;
+}
+
 Ptr<UnitFlow>
 BwmCoordinator::RegisterFlow (uint32_t tenantId, uint32_t flowId, uint32_t traceId, std::string extraInfo)
 {
-  if (m_tenantTable.find (tenantId) == m_tenantTable.end ())
+  BwmProfiler::Scope scope (BwmProfiler::COORDINATOR);
+  Ptr<BwmCoordinator> shard = GetShard (tenantId);
+  if (shard->GetTenant (tenantId) == NULL)
     {
       NS_LOG_WARN ("Cannot find a tenant that matches such id: " << tenantId);
       return NULL;
@@ -547,13 +995,34 @@ BwmCoordinator::RegisterFlow (uint32_t tenantId, uint32_t flowId, uint32_t trace
   flow->SetTraceId (traceId);
   flow->SetFlowId (flowId);
   flow->SetTenantId (tenantId);
-  AutoConfigureBF (flow, extraInfo);
+  shard->AutoConfigureBF (flow, extraInfo);
+  RouteFlow (flow, extraInfo);
 
   m_unitFlowCreateTrace (flow);
 
   return flow;
 }
 
+void
+BwmCoordinator::DeregisterFlow (Ptr<UnitFlow> flow)
+{
+  BwmProfiler::Scope scope (BwmProfiler::COORDINATOR);
+  Ptr<BwmCoordinator> shard = GetShard (flow->GetTenantId ());
+  auto it = shard->m_tenantTable.find (flow->GetTenantId ());
+  if (it == shard->m_tenantTable.end ())
+    {
+      NS_LOG_WARN ("Cannot find a tenant that matches such id: " << flow->GetTenantId ());
+      return;
+    }
+
+  // unlink the flow and transform the remaining flows of the tenant
+  m_routedFlows.erase (flow->GetTraceId ());
+  it->second->RemoveUnitFlow (flow);
+  shard->RequestTransform (it->second);
+
+  m_unitFlowRemoveTrace (flow);
+}
+
 void
 BwmCoordinator::AutoConfigureBF (Ptr<UnitFlow> flow, std::string extraInfo)
 {
@@ -580,48 +1049,573 @@ BwmCoordinator::AutoConfigureBF (Ptr<UnitFlow> flow, std::string extraInfo)
     }
 
   // compute the bandwidth function
-  auto tenant = m_tenantTable[flow->GetTenantId ()];
-  auto srcWeight = tenant->GetHostWeight (src);
-  auto dstWeight = tenant->GetHostWeight (dst);
-  Ptr<BandwidthFunction> newBF (new BandwidthFunction);
-  newBF->AddVertex (deviceRateLimit / (srcWeight + dstWeight), deviceRateLimit);
+  auto tenant = GetTenant (flow->GetTenantId ());
+  flow->SetEndHosts (src, dst, deviceRateLimit);
+  Ptr<BandwidthFunction> newBF = ConfigureBF (tenant, flow);
   flow->SetConfiguredBF (newBF);
-  NS_LOG_UNCOND ("Config TBF: " << *newBF << " for flow " << flow->GetTraceId ());
+  NS_LOG_DEBUG ("Config TBF: " << *newBF << " for flow " << flow->GetTraceId ());
 
   // link the new flow to the tenant
   tenant->AddUnitFlow (flow);
 
   // actively transform all related bandwidth function
-  tenant->TransformComponentialBF ();
+  RequestTransform (tenant);
+}
+
+Ptr<BandwidthFunction>
+BwmCoordinator::ConfigureBF (Ptr<Tenant> tenant, Ptr<UnitFlow> flow)
+{
+  auto srcWeight = tenant->GetHostWeight (flow->GetSrcHostId ());
+  auto dstWeight = tenant->GetHostWeight (flow->GetDstHostId ());
+  Ptr<BandwidthFunction> newBF (new BandwidthFunction);
+  newBF->AddVertex (flow->GetDeviceRateLimit () / (srcWeight + dstWeight), flow->GetDeviceRateLimit ());
+  return newBF;
+}
+
+void
+BwmCoordinator::InputReconfiguration (std::string filePath)
+{
+  std::ifstream fin (filePath);
+  if (fin.fail ())
+    {
+      NS_FATAL_ERROR ("Cannot open tenant reconfiguration file: " << filePath);
+    }
+
+  std::string input;
+  uint32_t lineNum = 0;
+  while (std::getline (fin, input) && input.length () > 0)
+    {
+      lineNum++;
+      std::istringstream sin (input);
+      double seconds;
+      uint32_t tenantId;
+      if (!(sin >> seconds >> tenantId))
+        {
+          NS_FATAL_ERROR (filePath << ":" << lineNum << ": invalid reconfiguration line '" << input << "'");
+        }
+
+      // check the changes now rather than when they are applied
+      std::string bfStr;
+      std::string hostWeightStr;
+      std::string error;
+      std::getline (fin, bfStr);
+      lineNum++;
+      bfStr = bfStr == "-" ? "" : bfStr;
+      std::vector<BwmTenantConfig::Vertex> vertices;
+      if (!BwmTenantConfig::ParseVertices (bfStr, vertices, error))
+        {
+          NS_FATAL_ERROR (filePath << ":" << lineNum << ": " << error);
+        }
+      std::getline (fin, hostWeightStr);
+      lineNum++;
+      hostWeightStr = hostWeightStr == "-" ? "" : hostWeightStr;
+      std::vector<BwmTenantConfig::HostWeight> weights;
+      if (!BwmTenantConfig::ParseHostWeights (hostWeightStr, weights, error))
+        {
+          NS_FATAL_ERROR (filePath << ":" << lineNum << ": " << error);
+        }
+      ScheduleReconfiguration (Seconds (seconds), tenantId, bfStr, hostWeightStr);
+    }
+}
+
+void
+BwmCoordinator::ScheduleReconfiguration (Time at, uint32_t tenantId, std::string bfStr, std::string hostWeightStr)
+{
+  NS_ASSERT_MSG (at >= Simulator::Now (), "Cannot reconfigure tenant " << tenantId << " in the past");
+  Simulator::Schedule (at - Simulator::Now (), &BwmCoordinator::ReconfigureTenant, this,
+                       tenantId, bfStr, hostWeightStr);
+}
+
+void
+BwmCoordinator::ReconfigureTenant (uint32_t tenantId, std::string bfStr, std::string hostWeightStr)
+{
+  BwmProfiler::Scope scope (BwmProfiler::COORDINATOR);
+  Ptr<BwmCoordinator> shard = GetShard (tenantId);
+  Ptr<Tenant> tenant = shard->GetTenant (tenantId);
+  if (tenant == NULL)
+    {
+      NS_LOG_WARN ("Cannot find a tenant that matches such id: " << tenantId);
+      return;
+    }
+  NS_LOG_INFO ("Reconfigure tenant " << tenantId << " @ " << Simulator::Now ().GetSeconds ());
+
+  if (bfStr.length () > 0)
+    {
+      tenant->SetBF (bfStr);
+    }
+
+  // configure again only the unit flows with an end host whose weight changed
+  std::vector<uint32_t> changedHosts = tenant->UpdateHostWeightTable (hostWeightStr);
+  if (!changedHosts.empty ())
+    {
+      for (auto it : tenant->GetUnitFlows ())
+        {
+          Ptr<UnitFlow> flow = it.second;
+          if (std::find (changedHosts.begin (), changedHosts.end (), flow->GetSrcHostId ()) != changedHosts.end ()
+              || std::find (changedHosts.begin (), changedHosts.end (), flow->GetDstHostId ()) != changedHosts.end ())
+            {
+              tenant->ReconfigureUnitFlow (flow, ConfigureBF (tenant, flow));
+            }
+        }
+    }
+
+  if (bfStr.length () > 0 || !changedHosts.empty ())
+    {
+      shard->RequestTransform (tenant);
+    }
+}
+
+void
+BwmCoordinator::RequestTransform (Ptr<Tenant> tenant)
+{
+  if (!m_coalesceTransforms)
+    {
+      tenant->TransformComponentialBF ();
+      return;
+    }
+  if (GetWorkers ().GetNThreads () == 0)
+    {
+      tenant->ScheduleTransform ();
+      return;
+    }
+
+  if (m_queuedTenants.insert (tenant->GetTenantId ()).second)
+    {
+      m_transformQueue.push_back (tenant);
+    }
+  if (!m_transformEvent.IsRunning ())
+    {
+      m_transformEvent = Simulator::ScheduleNow (&BwmCoordinator::TransformQueued, this);
+    }
+}
+
+void
+BwmCoordinator::TransformQueued ()
+{
+  BwmProfiler::Scope scope (BwmProfiler::COORDINATOR);
+  std::vector<Ptr<Tenant> > tenants;
+  tenants.swap (m_transformQueue);
+  m_queuedTenants.clear ();
+
+  // the tenants are independent, prepare them in parallel and hand over in request order
+  NS_ASSERT_MSG (GetWorkers ().GetNThreads () == 0 || !ShareTransformState (tenants),
+                 "Tenants transformed in parallel share a unit flow or a bandwidth function");
+  GetWorkers ().Run (tenants.size (), [&tenants] (uint32_t i) { tenants[i]->PrepareTransform (); });
+  for (auto tenant : tenants)
+    {
+      tenant->CommitTransform ();
+    }
+}
+
+bool
+BwmCoordinator::ShareTransformState (const std::vector<Ptr<Tenant> > &tenants)
+{
+  std::map<const void *, uint32_t> owners;
+  auto claim = [&owners] (const void *object, uint32_t owner)
+  {
+    return object == 0 || owners.insert (std::make_pair (object, owner)).first->second == owner;
+  };
+  for (uint32_t i = 0; i < tenants.size (); i++)
+    {
+      if (!claim (PeekPointer (tenants[i]->GetBF ()), i))
+        {
+          return true;
+        }
+      for (auto &entry : tenants[i]->GetUnitFlows ())
+        {
+          Ptr<UnitFlow> flow = entry.second;
+          if (!claim (PeekPointer (flow), i)
+              || !claim (PeekPointer (flow->GetConfiguredBF ()), i)
+              || !claim (PeekPointer (flow->GetTransformedBF ()), i))
+            {
+              return true;
+            }
+        }
+    }
+  return false;
+}
+
+BwmWorkerPool&
+BwmCoordinator::GetWorkers ()
+{
+  if (m_root)
+    {
+      return m_root->GetWorkers ();
+    }
+  if (m_workers.GetNThreads () != m_workerThreads)
+    {
+      m_workers.Start (m_workerThreads);
+    }
+  return m_workers;
 }
 
 double
 BwmCoordinator::EstimateTargetStatus ()
 {
+  if (m_root)
+    {
+      // a shard only holds part of the tenants, the root estimates globally
+      return m_root->EstimateTargetStatus ();
+    }
+
+  if (m_allocator == BwmCoordinator::WATER_FILLING)
+    {
+      return AllocateWaterFilling ();
+    }
+
   // implement the simple Target Status Estimation Algorithm
+  // merge the fair share sums of the root and all its shards
   double sum = 0;
-  for (auto it : m_tenantTable)
+  uint32_t tenantNum = 0;
+  SumActualFS (sum, tenantNum);
+  for (auto shard : m_shardTable)
+    {
+      shard.second->SumActualFS (sum, tenantNum);
+    }
+
+  return std::max((sum / tenantNum) * (1 + m_alpha), m_minFS); /*New FS*/
+}
+
+double
+BwmCoordinator::AllocateWaterFilling ()
+{
+  std::vector<Allocation> allocations;
+  double level = ComputeWaterFilling (allocations);
+
+  // push the fair shares to the unit flows
+  for (auto &allocation : allocations)
+    {
+      NS_LOG_LOGIC ("Water-filling pins flow " << allocation.flow->GetTraceId () << " at " << allocation.fairShare);
+      allocation.flow->SetPinnedFS (allocation.fairShare);
+    }
+
+  return std::max (level, m_minFS);
+}
+
+double
+BwmCoordinator::ComputeWaterFilling (std::vector<Allocation> &allocations)
+{
+  // collect the unit flows and the links they load
+  std::vector<RoutedFlow*> flows;
+  std::vector<Ptr<BandwidthFunction> > functions;
+  for (auto &it : m_routedFlows)
+    {
+      flows.push_back (&it.second);
+      functions.push_back (it.second.flow->GetTransformedBF ());
+    }
+  std::vector<std::vector<uint32_t> > linkFlows (m_links.size ());
+  for (uint32_t i = 0; i < flows.size (); i++)
+    {
+      for (auto link : flows[i]->links)
+        {
+          linkFlows[link].push_back (i);
+        }
+    }
+
+  std::vector<bool> frozen (flows.size (), false);
+  std::vector<double> fairShares (flows.size (), 0);
+  std::vector<double> load (m_links.size (), 0);
+  uint32_t activeNum = flows.size ();
+  for (uint32_t i = 0; i < flows.size (); i++)
+    {
+      // a unit flow without function has no bandwidth to share
+      if (functions[i] == NULL)
+        {
+          frozen[i] = true;
+          activeNum--;
+        }
+    }
+
+  // raise the water level until every unit flow is frozen
+  double level = 0;
+  std::vector<double> saturation (m_links.size ());
+  std::vector<Ptr<BandwidthFunction> > active;
+  while (activeNum > 0)
+    {
+      // find the links that saturate first
+      double nextLevel = BandwidthFunction::INF;
+      for (uint32_t link = 0; link < m_links.size (); link++)
+        {
+          active.clear ();
+          for (auto i : linkFlows[link])
+            {
+              if (!frozen[i])
+                {
+                  active.push_back (functions[i]);
+                }
+            }
+          saturation[link] = active.empty () ? BandwidthFunction::INF
+            : FindSaturationLevel (active, m_links[link].capacity - load[link], level);
+          if (saturation[link] != BandwidthFunction::INF
+              && (nextLevel == BandwidthFunction::INF || saturation[link] < nextLevel))
+            {
+              nextLevel = saturation[link];
+            }
+        }
+
+      if (nextLevel == BandwidthFunction::INF)
+        {
+          // no link limits the remaining unit flows, they get the end of their functions
+          for (uint32_t i = 0; i < flows.size (); i++)
+            {
+              if (!frozen[i])
+                {
+                  double lastFS = functions[i]->GetVertex (functions[i]->GetNVertices () - 1).first;
+                  fairShares[i] = std::max (lastFS, level);
+                  frozen[i] = true;
+                }
+            }
+          break;
+        }
+
+      // freeze the unit flows crossing the saturated links
+      for (uint32_t link = 0; link < m_links.size (); link++)
+        {
+          if (saturation[link] != nextLevel)
+            {
+              continue;
+            }
+          for (auto i : linkFlows[link])
+            {
+              if (frozen[i])
+                {
+                  continue;
+                }
+              frozen[i] = true;
+              fairShares[i] = nextLevel;
+              activeNum--;
+              double bandwidth = functions[i]->GetBandwidth (nextLevel);
+              for (auto crossed : flows[i]->links)
+                {
+                  load[crossed] += bandwidth;
+                }
+            }
+        }
+      level = nextLevel;
+    }
+
+  allocations.resize (flows.size ());
+  for (uint32_t i = 0; i < flows.size (); i++)
+    {
+      allocations[i].flow = flows[i]->flow;
+      allocations[i].fairShare = fairShares[i];
+      allocations[i].rate = functions[i] == NULL ? 0 : functions[i]->GetBandwidth (fairShares[i]);
+    }
+  return level;
+}
+
+double
+BwmCoordinator::FindSaturationLevel (const std::vector<Ptr<BandwidthFunction> > &functions,
+                                     double capacity, double level)
+{
+  // the load is piecewise linear between the breakpoints above the level
+  std::vector<double> breakpoints;
+  for (auto function : functions)
     {
-      sum += it.second->GetActualFS ();
+      for (uint32_t v = 0; v < function->GetNVertices (); v++)
+        {
+          double fairShare = function->GetVertex (v).first;
+          if (fairShare > level)
+            {
+              breakpoints.push_back (fairShare);
+            }
+        }
     }
+  std::sort (breakpoints.begin (), breakpoints.end ());
+  breakpoints.erase (std::unique (breakpoints.begin (), breakpoints.end ()), breakpoints.end ());
 
-  return std::max((sum / m_tenantTable.size ()) * (1 + m_alpha), m_minFS); /*New FS*/
+  double start = level;
+  for (uint32_t b = 0; ; b++)
+    {
+      // the load and its slope on the segment behind start
+      double load = 0;
+      double slope = 0;
+      for (auto function : functions)
+        {
+          double segStart, segEnd, segBandwidth, segSlope;
+          function->GetSegment (start, segStart, segEnd, segBandwidth, segSlope);
+          load += segBandwidth + (start - segStart) * segSlope;
+          slope += segSlope;
+        }
+      if (load >= capacity)
+        {
+          return start;
+        }
+      if (b == breakpoints.size ())
+        {
+          // all functions are flat behind their last breakpoint
+          return BandwidthFunction::INF;
+        }
+      if (slope > 0 && load + (breakpoints[b] - start) * slope >= capacity)
+        {
+          return start + (capacity - load) / slope;
+        }
+      start = breakpoints[b];
+    }
+}
+
+void
+BwmCoordinator::RouteFlow (Ptr<UnitFlow> flow, std::string extraInfo)
+{
+  // extract src ip and dst ip from info string
+  std::stringstream ss (extraInfo);
+  uint32_t srcIP;
+  uint32_t dstIP;
+  ss >> srcIP >> dstIP;
+
+  // locate the end nodes, a flow whose path is unknown is not limited by any link
+  int32_t src = -1;
+  int32_t dst = -1;
+  for (uint32_t n = 0; n < NodeList::GetNNodes (); n++)
+    {
+      Ptr<Ipv4> ipv4 = NodeList::GetNode (n)->GetObject<Ipv4> ();
+      if (ipv4 == NULL)
+        {
+          continue;
+        }
+      if (ipv4->GetInterfaceForAddress (Ipv4Address (srcIP)) != -1)
+        {
+          src = NodeList::GetNode (n)->GetId ();
+        }
+      if (ipv4->GetInterfaceForAddress (Ipv4Address (dstIP)) != -1)
+        {
+          dst = NodeList::GetNode (n)->GetId ();
+        }
+    }
+
+  RoutedFlow routed;
+  routed.flow = flow;
+  if (src != -1 && dst != -1)
+    {
+      routed.links = FindPath (src, dst);
+    }
+  m_routedFlows[flow->GetTraceId ()] = routed;
+}
+
+const std::vector<uint32_t>&
+BwmCoordinator::FindPath (uint32_t src, uint32_t dst)
+{
+  auto key = std::make_pair (src, dst);
+  auto cached = m_pathCache.find (key);
+  if (cached != m_pathCache.end ())
+    {
+      return cached->second;
+    }
+
+  // breadth first search for the path with the fewest hops
+  std::map<uint32_t, uint32_t> via; // node -> link reaching it
+  std::list<uint32_t> queue;
+  queue.push_back (src);
+  via[src] = m_links.size ();
+  while (!queue.empty () && via.find (dst) == via.end ())
+    {
+      uint32_t node = queue.front ();
+      queue.pop_front ();
+      for (auto link : m_adjacency[node])
+        {
+          if (via.find (m_links[link].to) == via.end ())
+            {
+              via[m_links[link].to] = link;
+              queue.push_back (m_links[link].to);
+            }
+        }
+    }
+
+  std::vector<uint32_t> &path = m_pathCache[key];
+  if (via.find (dst) == via.end ())
+    {
+      NS_LOG_WARN ("No path from node " << src << " to node " << dst);
+      return path;
+    }
+  for (uint32_t node = dst; node != src; node = m_links[via[node]].from)
+    {
+      path.insert (path.begin (), via[node]);
+    }
+  return path;
+}
+
+void
+BwmCoordinator::AddLink (uint32_t nodeA, uint32_t nodeB, double capacity)
+{
+  Link link;
+  link.capacity = capacity;
+
+  link.from = nodeA;
+  link.to = nodeB;
+  m_adjacency[nodeA].push_back (m_links.size ());
+  m_links.push_back (link);
+
+  link.from = nodeB;
+  link.to = nodeA;
+  m_adjacency[nodeB].push_back (m_links.size ());
+  m_links.push_back (link);
+
+  m_pathCache.clear ();
+}
+
+void
+BwmCoordinator::SumActualFS (double &sum, uint32_t &tenantNum)
+{
+  // tenants not built yet have seen no traffic, their fair share is zero
+  tenantNum += m_tenantTable.size () + m_unbuiltTenantNum;
+  BwmWorkerPool &workers = GetWorkers ();
+  if (workers.GetNThreads () == 0)
+    {
+      for (auto it : m_tenantTable)
+        {
+          sum += it.second->GetActualFS ();
+        }
+      return;
+    }
+
+  // compute the fair shares in parallel, then record and sum them in tenant order
+  std::vector<Tenant*> tenants;
+  tenants.reserve (m_tenantTable.size ());
+  for (auto &it : m_tenantTable)
+    {
+      tenants.push_back (PeekPointer (it.second));
+    }
+  std::vector<double> fairShares (tenants.size ());
+  workers.Run (tenants.size (), [&tenants, &fairShares] (uint32_t i) { fairShares[i] = tenants[i]->ComputeActualFS (); });
+  for (uint32_t i = 0; i < tenants.size (); i++)
+    {
+      tenants[i]->SetActualFS (fairShares[i]);
+      sum += fairShares[i];
+    }
 }
 
 void
 BwmCoordinator::SendNewArguments (Ptr<BwmLocalAgent> targetHost, double fairShare)
 {
-  targetHost->SetNewTargetStatus (fairShare);
+  if (m_controlTransport == BwmCoordinator::DIRECT)
+    {
+      targetHost->SetNewTargetStatus (fairShare);
+      return;
+    }
+
+  NS_ASSERT (m_socket);
+  BwmTargetStatusHeader header;
+  header.SetTargetStatus (fairShare);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  m_socket->SendTo (packet, 0, InetSocketAddress (targetHost->GetIpv4Address (), m_statusPort));
 }
 
 void
 BwmCoordinator::UpdateUsage (Ptr<BwmLocalAgent> host, std::list<Ptr<UnitFlow> > flowList)
 {
+  BwmProfiler::Scope scope (BwmProfiler::COORDINATOR);
   // update usage of all related tenants
   for (auto flow : flowList)
     {
       uint32_t tenantId = flow->GetTenantId ();
-      m_tenantTable[tenantId]->UpdateUnitFlow (flow);
+      GetShard (tenantId)->m_tenantTable[tenantId]->UpdateUnitFlow (flow);
+    }
+
+  if (m_updateMode == BwmCoordinator::EPOCH)
+    {
+      // the new status will be sent to all hosts when the epoch closes
+      return;
     }
 
   // compute new target status
@@ -631,4 +1625,105 @@ BwmCoordinator::UpdateUsage (Ptr<BwmLocalAgent> host, std::list<Ptr<UnitFlow> >
   SendNewArguments(host, newStatus);
 }
 
+void
+BwmCoordinator::CloseEpoch ()
+{
+  BwmProfiler::Scope scope (BwmProfiler::COORDINATOR);
+  // compute new target status once for all reports received in this epoch
+  double newStatus = EstimateTargetStatus ();
+
+  // send the new status to all hosts
+  for (auto host : m_hostList)
+    {
+      SendNewArguments (host, newStatus);
+    }
+
+  m_epochTimer.Schedule (m_epochLength);
+}
+
+BwmCoordinator::ControlTransport
+BwmCoordinator::GetControlTransport (void) const
+{
+  return m_controlTransport;
+}
+
+Ipv4Address
+BwmCoordinator::GetControlAddress (void) const
+{
+  // use the first interface behind the loopback
+  Ptr<Ipv4> ipv4 = GetNode ()->GetObject<Ipv4> ();
+  NS_ASSERT (ipv4 && ipv4->GetNInterfaces () > 1);
+  return ipv4->GetAddress (1, 0).GetLocal ();
+}
+
+uint16_t
+BwmCoordinator::GetReportPort (void) const
+{
+  return m_reportPort;
+}
+
+uint16_t
+BwmCoordinator::GetStatusPort (void) const
+{
+  return m_statusPort;
+}
+
+void
+BwmCoordinator::HandleReport (Ptr<Socket> socket)
+{
+  BwmProfiler::Scope scope (BwmProfiler::COORDINATOR);
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      BwmUsageReportHeader header;
+      packet->RemoveHeader (header);
+
+      // update usage of all related tenants
+      for (uint32_t i = 0; i < header.GetNRecords (); i++)
+        {
+          auto it = m_tenantTable.find (header.GetTenantId (i));
+          if (it == m_tenantTable.end ())
+            {
+              NS_LOG_WARN ("Cannot find a tenant that matches such id: " << header.GetTenantId (i));
+              continue;
+            }
+          it->second->UpdateUnitFlowUsage (header.GetFlowId (i), header.GetUsage (i));
+        }
+
+      if (!header.IsReplyRequested () || m_updateMode != BwmCoordinator::PER_REPORT)
+        {
+          continue;
+        }
+
+      // segments may be reordered, reply once all of them have arrived
+      ReportProgress &progress = m_reportProgress[header.GetHostId ()];
+      int32_t age = static_cast<int32_t> (header.GetReportId () - progress.reportId);
+      if (age > 0)
+        {
+          // the first segment of a newer report, an incomplete older one is abandoned
+          progress.reportId = header.GetReportId ();
+          progress.received = 0;
+        }
+      else if (age < 0)
+        {
+          NS_LOG_LOGIC ("Late segment of report " << header.GetReportId () << " of host " << header.GetHostId ());
+          continue;
+        }
+      if (++progress.received == header.GetSegmentCount ())
+        {
+          // expect the next report, segments of this one arriving twice are late
+          progress.reportId++;
+          progress.received = 0;
+          // reply the new status to the reporting host
+          BwmTargetStatusHeader reply;
+          reply.SetTargetStatus (EstimateTargetStatus ());
+          Ptr<Packet> replyPacket = Create<Packet> ();
+          replyPacket->AddHeader (reply);
+          Ipv4Address hostAddr = InetSocketAddress::ConvertFrom (from).GetIpv4 ();
+          socket->SendTo (replyPacket, 0, InetSocketAddress (hostAddr, m_statusPort));
+        }
+    }
+}
+
 }
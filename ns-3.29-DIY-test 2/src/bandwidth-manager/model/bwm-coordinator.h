@@ -5,9 +5,18 @@
 #include "ns3/object-factory.h"
 #include "ns3/traced-value.h"
 #include "ns3/application.h"
+#include "ns3/event-id.h"
+#include "ns3/timer.h"
+#include "ns3/nstime.h"
+#include "ns3/socket.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/bwm-worker-pool.h"
+#include "ns3/bwm-tenant-config.h"
 
 #include <list>
 #include <map>
+#include <unordered_set>
+#include <vector>
 
 namespace ns3 {
 
@@ -97,6 +106,24 @@ public:
    * \brief Set the congestion factor of this unit flow.
    */
   void SetCongestionFactor (double factor);
+  /**
+   * \brief Pin the fair share of this unit flow to a value assigned by the coordinator.
+   *
+   * A negative fair share releases the flow to the local agent's tuning again.
+   */
+  void SetPinnedFS (double fairShare);
+  /**
+   * \brief Set the usage that has been accounted into the usage sum of the tenant.
+   */
+  void SetAccountedUsage (double usage);
+  /**
+   * \brief Set the end hosts and the device rate limit the configured function was derived from.
+   */
+  void SetEndHosts (uint32_t srcHostId, uint32_t dstHostId, double deviceRateLimit);
+  /**
+   * \brief Mark whether the unit flow waits in the pending list of its tenant.
+   */
+  void SetTransformPending (bool pending);
 
   /**
     * \Return the bandwidth usage of this unit flow.
@@ -116,6 +143,36 @@ public:
    * \return the congestion factor
    */
   double GetCongestionFactor (void) const;
+  /**
+   * \brief Get the fair share pinned by the coordinator.
+   * \return the pinned fair share, negative if the flow is tuned by the local agent
+   */
+  double GetPinnedFS (void) const;
+  /**
+   * \brief Get the usage that has been accounted into the usage sum of the tenant.
+   * \return the accounted usage
+   */
+  double GetAccountedUsage (void) const;
+  /**
+   * \brief Get the id of the sending host.
+   * \return the host id, -1 if unknown
+   */
+  uint32_t GetSrcHostId (void) const;
+  /**
+   * \brief Get the id of the receiving host.
+   * \return the host id, -1 if unknown
+   */
+  uint32_t GetDstHostId (void) const;
+  /**
+   * \brief Get the rate limit of the sending device.
+   * \return the rate limit in bps
+   */
+  double GetDeviceRateLimit (void) const;
+  /**
+   * \brief Check whether the unit flow waits in the pending list of its tenant.
+   * \return true if the flow hasn't been transformed with the current map
+   */
+  bool IsTransformPending (void) const;
 
 private:
   uint32_t m_traceId; //!< The flow id used in tracing
@@ -123,6 +180,12 @@ private:
   uint32_t m_tenantId; //!< Id of the according tenant
   Ptr<BandwidthFunction> m_configuredBF; //!< Configured bandwidth function
   Ptr<BandwidthFunction> m_transformedBF; //!< The effective bandwidth function
+  double m_accountedUsage; //!< The usage included in the usage sum of the tenant
+  double m_pinnedFS; //!< The fair share assigned by an exact allocator, negative if none
+  uint32_t m_srcHostId; //!< Id of the sending host
+  uint32_t m_dstHostId; //!< Id of the receiving host
+  double m_deviceRateLimit; //!< Rate limit of the sending device
+  bool m_transformPending; //!< Whether the flow is in the pending list of its tenant
 
   TracedValue<double> m_usage; //!< Latest bandwidth usage of this unit flow
   TracedValue<double> m_allocatedFS; //!< The allocated fair share of this unit flow
@@ -165,19 +228,56 @@ public:
    * 
    * This method analyzes the string and configure a bandwidth function to the tenant.
    * It doesn't check whether there exists an old bandwidth function.
+   * A malformed or decreasing function is a fatal error.
    */
   void SetBF (std::string bfStr);
+  /**
+   * \brief Set a bandwidth function that has already been built.
+   */
+  void SetBF (Ptr<BandwidthFunction> bf);
+  /**
+   * \brief Get the configured bandwidth function of the tenant.
+   * \return m_BF.
+   */
+  Ptr<BandwidthFunction> GetBF () const;
   /**
    * \brief Set the host weight table of the tenant.
    * 
    * This method analyzes the string and configure a host weight table to the tenant.
+   * A malformed pair or a non-positive weight is a fatal error.
    */
   void SetHostWeightTable (std::string entryListStr);
+  /**
+   * \brief Add an entry to the host weight table of the tenant.
+   */
+  void SetHostWeight (uint32_t hostId, double weight);
+  /**
+   * \brief Overwrite entries of the host weight table of the tenant.
+   *
+   * The string has the format of SetHostWeightTable, hosts it doesn't mention keep their weights.
+   * \return the ids of the hosts whose weight changed
+   */
+  std::vector<uint32_t> UpdateHostWeightTable (std::string entryListStr);
   /**
    * \brief Get the actual fair share of the tenant.
    * \return the actual fair share.
+   *
+   * The fair share is derived from the running usage sum, which is kept up to date
+   * by UpdateUnitFlow, so the cost doesn't depend on the number of unit flows.
    */
   double GetActualFS ();
+  /**
+   * \brief Compute the actual fair share of the tenant without recording it.
+   * \return the actual fair share.
+   *
+   * Only reads the state of this tenant, so different tenants may be computed
+   * in parallel; SetActualFS records the result afterwards.
+   */
+  double ComputeActualFS () const;
+  /**
+   * \brief Record the actual fair share computed by ComputeActualFS.
+   */
+  void SetActualFS (double fairShare);
   /**
    * \brief Get the weight of host denoted by hostId from the tenant's perspective.
    * \return the weight of specific host.
@@ -188,23 +288,111 @@ public:
    * 
    * This method implements the bandwidth function transformation algorithm
    * proposed in BwE (Alok Kumar et al., SIGCOMM'15).
+   *
+   * The aggregated bandwidth function is maintained incrementally as flows
+   * join and leave, and only the transformed functions that actually change
+   * are handed to the unit flows.
    */
   void TransformComponentialBF ();
+  /**
+   * \brief Compute the transformed functions of TransformComponentialBF without handing them over.
+   *
+   * Only touches the tenant and its own unit flows and functions, so different
+   * tenants may be prepared in parallel. This holds as long as no unit flow or
+   * bandwidth function is shared between tenants, since the reference counts
+   * of Ptr are not atomic. It doesn't log either, NS_LOG isn't thread-safe.
+   */
+  void PrepareTransform ();
+  /**
+   * \brief Hand the functions computed by PrepareTransform to the unit flows.
+   */
+  void CommitTransform ();
+  /**
+   * \brief Run TransformComponentialBF once all flows arriving at the current time have been added.
+   */
+  void ScheduleTransform ();
   /**
    * \brief Add a new unit flow into the flow table.
    */
   void AddUnitFlow (Ptr<UnitFlow>);
+  /**
+   * \brief Remove a unit flow from the flow table.
+   */
+  void RemoveUnitFlow (Ptr<UnitFlow>);
+  /**
+   * \brief Replace the configured bandwidth function of an attached unit flow.
+   *
+   * The aggregate is updated incrementally and the flow is transformed by the next transformation.
+   */
+  void ReconfigureUnitFlow (Ptr<UnitFlow> flow, Ptr<BandwidthFunction> bf);
+  /**
+   * \brief Get the attached unit flows.
+   * \return the flow mapping table, flowId -> flow
+   */
+  const std::map<uint32_t, Ptr<UnitFlow> >& GetUnitFlows () const;
   /**
    * \brief Update the status of a unit flow, including usage, etc.
+   *
+   * The change of the flow's usage since its last update is applied to the usage sum.
+   * Updates of flows that aren't registered, e.g. already evicted, are dropped.
    */
   void UpdateUnitFlow (Ptr<UnitFlow>);
+  /**
+   * \brief Account a usage value received in a report packet for a unit flow.
+   *
+   * Reports of unknown flow ids are dropped.
+   */
+  void UpdateUnitFlowUsage (uint32_t flowId, double usage);
 
 private:
+  /**
+   * \brief The accumulated change of the aggregated bandwidth function at one breakpoint.
+   */
+  struct AggregateDelta
+  {
+    double slope; //!< Change of the slope behind the breakpoint
+    double jump; //!< Change of the bandwidth exactly at the breakpoint
+    int32_t refCount; //!< Number of vertices contributing to the breakpoint
+  };
+
+  /**
+   * \brief Apply the change of a unit flow's usage to the usage sum.
+   */
+  void AccountUsage (Ptr<UnitFlow> flow, double usage);
+  /**
+   * \brief Add (sign = 1) or subtract (sign = -1) the breakpoints of a bandwidth function to the aggregate.
+   */
+  void ApplyAggregateDelta (Ptr<BandwidthFunction> bf, int32_t sign);
+  /**
+   * \brief Rebuild the aggregated bandwidth function and the transformation map from the breakpoints.
+   * \return true if the transformation map has changed, false otherwise
+   */
+  bool UpdateTransformMap ();
+  /**
+   * \brief Transform the bandwidth function of a unit flow with the current transformation map.
+   *
+   * A function that differs from the current one is staged for CommitTransform.
+   */
+  void TransformUnitFlow (Ptr<UnitFlow> flow);
+  /**
+   * \brief Parse host weights given as "host,weight host,weight ...", a malformed string is fatal.
+   * \return the host weights in the order of the string
+   */
+  std::vector<BwmTenantConfig::HostWeight> ParseHostWeights (std::string entryListStr) const;
+
   uint32_t m_tenantId; //!< Tenant Id
   std::map<uint32_t, Ptr<UnitFlow> > m_flowTable; //!< The flow mapping table consisting of all attached unit flows, flowId -> flow
   std::map<uint32_t, double> m_hostWeightTable; //!< The weight table that assign a weight to each host
   Ptr<BandwidthFunction> m_BF; //!< Configured bandwidth function
 
+  std::map<double, AggregateDelta> m_aggregateDeltas; //!< Breakpoints of the aggregated bandwidth function, fair share -> delta
+  std::vector<std::pair<double, double> > m_transformMap; //!< The transformation from aggregated fair share to configured fair share
+  std::list<Ptr<UnitFlow> > m_pendingFlows; //!< Unit flows that haven't been transformed with the current map
+  std::vector<std::pair<Ptr<UnitFlow>, Ptr<BandwidthFunction> > > m_stagedBFs; //!< Transformed functions waiting for CommitTransform
+  bool m_transformDirty; //!< Whether the breakpoints have changed since the last transformation
+  EventId m_transformEvent; //!< The pending transformation of this tenant
+  double m_usageSum; //!< Running sum of the reported usage of all attached unit flows
+
   TracedValue<double> m_actualFairShare; //!< The actual fair share derived from usage reports
 };
 
@@ -226,6 +414,33 @@ public:
    */
   static TypeId GetTypeId (void);
 
+  /**
+   * \brief The way new target status is computed from usage reports.
+   */
+  enum UpdateMode
+  {
+    PER_REPORT, //!< Estimate and reply to the reporting host on every report
+    EPOCH       //!< Accumulate reports and estimate once per epoch for all hosts
+  };
+
+  /**
+   * \brief The engine computing the fair shares of the unit flows.
+   */
+  enum Allocator
+  {
+    ESTIMATION,   //!< Target Status Estimation, hosts converge to a common target status
+    WATER_FILLING //!< Exact max-min water-filling over the links, fair shares are pinned per unit flow
+  };
+
+  /**
+   * \brief The way usage reports and target status travel between hosts and the coordinator.
+   */
+  enum ControlTransport
+  {
+    DIRECT, //!< Method calls without any network cost
+    UDP     //!< UDP packets over the simulated network
+  };
+
   /**
    * \brief BwmCoordinator constructor.
    */
@@ -238,8 +453,86 @@ public:
    * 
    * The input format should be p1,q1 p2,q2 ...
    * (p, q)s are just points of the tenant's bandwidth function 
+   * In hierarchical mode every tenant is stored in the shard owning its id,
+   * so all shards should be added before the configuration is input.
+   *
+   * A binary configuration written by BwmTenantConfig::Convert is detected by
+   * its magic number. It is memory-mapped and validated, and a tenant is only
+   * built when its first unit flow registers.
    */
   void InputConfiguration (std::string filePath);
+  /**
+   * \brief Input tenant changes to be applied during the simulation from a file.
+   *
+   * Every change takes three lines: "time tenantId" with the time in seconds,
+   * the new bandwidth function in the format of InputConfiguration and the
+   * host weights to overwrite as host,weight pairs. A "-" keeps the bandwidth
+   * function or the host weights as they are. An empty line ends the input.
+   * Every line is validated when the file is read, a malformed line is a fatal
+   * error naming its line number.
+   */
+  void InputReconfiguration (std::string filePath);
+  /**
+   * \brief Schedule a change of a tenant, see ReconfigureTenant.
+   * \param at the simulation time of the change
+   */
+  void ScheduleReconfiguration (Time at, uint32_t tenantId, std::string bfStr, std::string hostWeightStr);
+  /**
+   * \brief Change the bandwidth function and host weights of a tenant now.
+   *
+   * Only the unit flows whose end hosts got new weights are configured again,
+   * and only this tenant is aggregated and transformed again.
+   * \param tenantId the id of the tenant
+   * \param bfStr the new bandwidth function, empty to keep the current one
+   * \param hostWeightStr the host weights to overwrite, empty to keep all
+   */
+  void ReconfigureTenant (uint32_t tenantId, std::string bfStr, std::string hostWeightStr);
+  /**
+   * \brief Add a shard coordinator and make this coordinator the root of a hierarchy.
+   *
+   * The new shard owns the tenants whose ids are larger than the bound of the
+   * previous shard and not larger than lastTenantId. Tenants beyond the last
+   * bound stay in the root. Shards account usage and sum the fair shares of
+   * their own tenants, the root merges the sums into the global target status.
+   * \param shard the shard coordinator
+   * \param lastTenantId the largest tenant id owned by the shard
+   */
+  void AddShard (Ptr<BwmCoordinator> shard, uint32_t lastTenantId);
+  /**
+   * \brief Get the coordinator owning a tenant.
+   * \param tenantId the id of the tenant
+   * \return the shard owning the tenant, or this coordinator itself
+   */
+  Ptr<BwmCoordinator> GetShard (uint32_t tenantId);
+  /**
+   * \brief Add a full-duplex link of the topology used by the water-filling allocator.
+   * \param nodeA the id of one end node
+   * \param nodeB the id of the other end node
+   * \param capacity the capacity of each direction in bps
+   */
+  void AddLink (uint32_t nodeA, uint32_t nodeB, double capacity);
+  /**
+   * \brief The allocation of a unit flow computed by water-filling.
+   */
+  struct Allocation
+  {
+    Ptr<UnitFlow> flow; //!< The unit flow
+    double fairShare; //!< The max-min fair share
+    double rate; //!< The bandwidth of the fair share in bps
+  };
+
+  /**
+   * \brief Compute the exact max-min allocation of the routed unit flows without applying it.
+   *
+   * The common fair share is raised over the transformed bandwidth functions of
+   * all unit flows until a link saturates, the unit flows crossing it are frozen
+   * at that level and the remaining ones keep rising, as in BwE (Alok Kumar et al.,
+   * SIGCOMM'15). Every level is found exactly by walking the breakpoints of the
+   * piecewise linear link loads.
+   * \param allocations the allocation of each unit flow, in trace id order
+   * \return the highest level at which a link saturated
+   */
+  double ComputeWaterFilling (std::vector<Allocation> &allocations);
   /**
    * \brief Register a new host by submitting its local agent.
    * \return true if the operation succeed, false otherwise.
@@ -250,10 +543,37 @@ public:
    * \return the pointer to flow if the registration succeeds, NULL otherwise.
    */
   Ptr<UnitFlow> RegisterFlow (uint32_t tenantId, uint32_t flowId, uint32_t traceId, std::string extraInfo);
+  /**
+   * \brief Deregister a unit flow that has ended and re-transform its tenant.
+   */
+  void DeregisterFlow (Ptr<UnitFlow> flow);
   /**
    * \brief Update the usage information of tenants according to reports from a host.
    */
   void UpdateUsage (Ptr<BwmLocalAgent> host, std::list<Ptr<UnitFlow> > flowList);
+  /**
+   * \brief Get the transport used by the control plane.
+   * \return the control transport
+   */
+  ControlTransport GetControlTransport (void) const;
+  /**
+   * \brief Get the address hosts should send their usage reports to.
+   * \return the address of the coordinator's node
+   */
+  Ipv4Address GetControlAddress (void) const;
+  /**
+   * \brief Get the UDP port the coordinator receives usage reports on.
+   * \return the report port
+   */
+  uint16_t GetReportPort (void) const;
+  /**
+   * \brief Get the UDP port the hosts receive target status on.
+   * \return the status port
+   */
+  uint16_t GetStatusPort (void) const;
+
+protected:
+  virtual void DoDispose (void);
 
 private:
   /**
@@ -271,20 +591,153 @@ private:
    * The default configuration is BF = min (srcWeight + dstWeight, deviceRateLimit)
    */
   void AutoConfigureBF (Ptr<UnitFlow> flow, std::string extraInfo);
+  /**
+   * \brief Compute the configured bandwidth function of a unit flow from the weights of its end hosts.
+   */
+  static Ptr<BandwidthFunction> ConfigureBF (Ptr<Tenant> tenant, Ptr<UnitFlow> flow);
+  /**
+   * \brief Map a binary tenant configuration, the tenants are built on demand by GetTenant.
+   */
+  void InputBinaryConfiguration (std::string filePath);
+  /**
+   * \brief Get a tenant of this coordinator, building it from the binary configuration if needed.
+   * \param tenantId the id of the tenant, owned by this coordinator
+   * \return the tenant, or NULL if no configuration knows the tenant
+   */
+  Ptr<Tenant> GetTenant (uint32_t tenantId);
   /**
    * \brief Estimate the new target status based on fresh usage reports.
    * \return The new estimated target status, ie a new fair share shared by all tenants
    */
   double EstimateTargetStatus ();
+  /**
+   * \brief Compute the exact max-min fair share of every routed unit flow and pin it.
+   *
+   * The fair shares are pinned on the unit flows directly, without any control plane cost.
+   * \return the highest level at which a link saturated, at least MinFS
+   */
+  double AllocateWaterFilling ();
+  /**
+   * \brief Find the lowest fair share at which a set of bandwidth functions reaches a capacity.
+   * \param functions the bandwidth functions of the active unit flows on a link
+   * \param capacity the capacity left by the frozen unit flows
+   * \param level the current water level
+   * \return the saturation level, or BandwidthFunction::INF if the functions never reach the capacity
+   */
+  static double FindSaturationLevel (const std::vector<Ptr<BandwidthFunction> > &functions,
+                                     double capacity, double level);
+  /**
+   * \brief Record the links a new unit flow crosses between its end hosts.
+   */
+  void RouteFlow (Ptr<UnitFlow> flow, std::string extraInfo);
+  /**
+   * \brief Get the links of the shortest path between two nodes.
+   * \return the link indexes, empty if the nodes are not connected
+   */
+  const std::vector<uint32_t>& FindPath (uint32_t src, uint32_t dst);
+  /**
+   * \brief Transform a tenant after one of its unit flows joined or left.
+   *
+   * With worker threads, all tenants requested at the same time are transformed
+   * by one event that prepares them in parallel and commits them in request order.
+   */
+  void RequestTransform (Ptr<Tenant> tenant);
+  /**
+   * \brief Transform the tenants queued by RequestTransform.
+   *
+   * The tenants are prepared on the worker threads, so they must not share
+   * unit flows or bandwidth functions, see Tenant::PrepareTransform.
+   */
+  void TransformQueued ();
+  /**
+   * \brief Check whether two tenants share a unit flow or a bandwidth function.
+   * \param tenants the tenants to check
+   * \return true if an object is reachable from more than one tenant
+   */
+  static bool ShareTransformState (const std::vector<Ptr<Tenant> > &tenants);
+  /**
+   * \brief Get the worker pool of the root, started with the configured number of threads.
+   * \return the worker pool
+   */
+  BwmWorkerPool& GetWorkers ();
+  /**
+   * \brief Sum the actual fair shares of the tenants held by this coordinator.
+   * \param sum the sum to accumulate into
+   * \param tenantNum the number of tenants to accumulate into
+   */
+  void SumActualFS (double &sum, uint32_t &tenantNum);
   /**
    * \brief Disseminate new arguments that should be used on hosts.
    */
   void SendNewArguments (Ptr<BwmLocalAgent> targetHost, double fairshare);
+  /**
+   * \brief Close an epoch: estimate the target status once and send it to all hosts.
+   */
+  void CloseEpoch ();
+  /**
+   * \brief Handle usage report packets received on the report socket.
+   */
+  void HandleReport (Ptr<Socket> socket);
 
   double m_alpha; //!< The progress factor of Target Status Estimation Algorithm, within [0, 1)
   double m_minFS; //!< Lower bound of the fair share of the entire system
+  bool m_coalesceTransforms; //!< Whether to transform a tenant once per burst of new unit flows
+  UpdateMode m_updateMode; //!< How usage reports trigger target status estimation
+  Time m_epochLength; //!< The length of an epoch in EPOCH mode
+  Timer m_epochTimer; //!< The timer used to close epochs
+
+  ControlTransport m_controlTransport; //!< Transport of reports and target status
+  uint16_t m_reportPort; //!< UDP port of the coordinator for usage reports
+  uint16_t m_statusPort; //!< UDP port of the hosts for target status
+  Ptr<Socket> m_socket; //!< The socket used in UDP transport
+
+  /**
+   * \brief The segments of a usage report received so far
+   */
+  struct ReportProgress
+  {
+    uint32_t reportId;  //!< The id of the report
+    uint16_t received;  //!< The number of its segments received
+  };
+  std::map<uint32_t, ReportProgress> m_reportProgress; //!< Per host id, the report whose segments are expected
+
+  /**
+   * \brief One direction of a link of the topology
+   */
+  struct Link
+  {
+    uint32_t from; //!< The id of the sending node
+    uint32_t to; //!< The id of the receiving node
+    double capacity; //!< The capacity in bps
+  };
+
+  /**
+   * \brief A unit flow together with the links it crosses
+   */
+  struct RoutedFlow
+  {
+    Ptr<UnitFlow> flow; //!< The unit flow
+    std::vector<uint32_t> links; //!< Indexes of the links on its path
+  };
+
+  uint32_t m_workerThreads; //!< Worker threads of the root besides the simulator thread, zero runs sequentially
+  BwmWorkerPool m_workers; //!< The worker pool of the root
+  std::vector<Ptr<Tenant> > m_transformQueue; //!< Tenants waiting for a parallel transform, in request order
+  std::unordered_set<uint32_t> m_queuedTenants; //!< Ids of the tenants in the transform queue
+  EventId m_transformEvent; //!< The pending parallel transform
+
+  Allocator m_allocator; //!< The engine computing the fair shares
+  std::vector<Link> m_links; //!< Directed links of the topology
+  std::map<uint32_t, std::vector<uint32_t> > m_adjacency; //!< Outgoing links of each node
+  std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t> > m_pathCache; //!< Links between two nodes
+  std::map<uint32_t, RoutedFlow> m_routedFlows; //!< Unit flows known to the water-filling allocator, traceId -> flow
+
+  Ptr<BwmCoordinator> m_root; //!< The root coordinator of a shard, NULL for the root
+  std::map<uint32_t, Ptr<BwmCoordinator> > m_shardTable; //!< Shards of the root, last tenant id -> shard
 
-  std::map<uint32_t, Ptr<Tenant> > m_tenantTable; //!< Global tenant mapping table, tenantId -> tenant
+  std::map<uint32_t, Ptr<Tenant> > m_tenantTable; //!< Tenant mapping table of this coordinator, tenantId -> tenant
+  Ptr<BwmTenantConfig> m_tenantConfig; //!< The mapped binary configuration tenants are built from, NULL if none
+  uint32_t m_unbuiltTenantNum; //!< Tenants of the binary configuration owned by this coordinator and not built yet
   std::list<Ptr<BwmLocalAgent> > m_hostList; //!< List of local agents in all hosts.
   uint32_t m_hostCounter; //!< The monotonously increasing counter of hosts used to assign id for new hosts
 
@@ -293,6 +746,7 @@ private:
 
   TracedCallback<Ptr<Tenant> > m_tenantCreateTrace; //!< Trace of creating a tenant
   TracedCallback<Ptr<UnitFlow> > m_unitFlowCreateTrace; //!< Trace of creating a unit flow
+  TracedCallback<Ptr<UnitFlow> > m_unitFlowRemoveTrace; //!< Trace of deregistering a unit flow
 };
 
 }
@@ -1,12 +1,21 @@
 #include "ns3/log.h"
 #include "ns3/string.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
 #include "ns3/tcp-header.h"
 #include "ns3/ipv4-header.h"
+#include "ns3/tcp-l4-protocol.h"
 #include "ns3/socket.h"
 #include "ns3/packet.h"
 #include "ns3/callback.h"
 #include "ns3/flow-id-tag.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/bwm-control-header.h"
+#include "ns3/bwm-profiler.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <sstream>
 #include <utility>
 
@@ -43,6 +52,16 @@ BwmLocalAgent::GetTypeId ()
                    TimeValue (Time ("1ms")),
                    MakeTimeAccessor (&BwmLocalAgent::m_tuneCycle),
                    MakeTimeChecker ())
+    .AddAttribute ("RateTolerance",
+                   "The relative rate change a unit flow must exceed before its class is reconfigured",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&BwmLocalAgent::m_rateTolerance),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("IdleTimeout",
+                   "The idle time after which an empty unit flow is deregistered, zero disables the eviction",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&BwmLocalAgent::m_idleTimeout),
+                   MakeTimeChecker ())
     .AddAttribute ("FeedbackCycle",
                    "The cycle of periodical feedback",
                    TimeValue (Time ("1ms")),
@@ -58,18 +77,24 @@ BwmLocalAgent::GetTypeId ()
                    UintegerValue (50),
                    MakeUintegerAccessor (&BwmLocalAgent::m_feedbackThreshold),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CoalesceFeedback",
+                   "Whether congestion factors are batched per sender host and sent once per feedback cycle",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BwmLocalAgent::m_coalesceFeedback),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
 
 BwmLocalAgent::BwmLocalAgent ()
-  : m_timer (Timer::CANCEL_ON_DESTROY),
+  : m_reportId (0),
+    m_timer (Timer::CANCEL_ON_DESTROY),
     m_subTimer (Timer::CANCEL_ON_DESTROY),
     m_targetStatus (0),
-    m_deviceRateLimit (0),
-    m_deviceRateLimitFlag (false),
+    m_rateTolerance (0),
     m_CAWCEnable (false),
-    m_feedbackTimer (Timer::CANCEL_ON_DESTROY)
+    m_feedbackTimer (Timer::CANCEL_ON_DESTROY),
+    m_coalesceFeedback (false)
 {
 }
 
@@ -95,7 +120,38 @@ BwmLocalAgent::GetHostId (void)
 void
 BwmLocalAgent::SetQueueDisc (Ptr<BwmQueueDisc> qdisc)
 {
-  m_qdisc = qdisc;
+  m_devices.clear ();
+  AddQueueDisc (qdisc);
+}
+
+void
+BwmLocalAgent::AddQueueDisc (Ptr<BwmQueueDisc> qdisc)
+{
+  // the address and the rate limit are read when the agent starts
+  Device device;
+  device.qdisc = qdisc;
+  device.rateLimit = 0;
+  device.rateLimitFlag = false;
+  m_devices.push_back (device);
+}
+
+uint32_t
+BwmLocalAgent::GetNDevices (void) const
+{
+  return m_devices.size ();
+}
+
+uint32_t
+BwmLocalAgent::FindDevice (Ptr<BwmQueueDisc> qdisc) const
+{
+  for (uint32_t i = 0; i < m_devices.size (); i++)
+    {
+      if (m_devices[i].qdisc == qdisc)
+        {
+          return i;
+        }
+    }
+  return -1;
 }
 
 void
@@ -107,14 +163,27 @@ BwmLocalAgent::SetCoordinator (Ptr<BwmCoordinator> coordinator)
 bool
 BwmLocalAgent::CheckIP (Ipv4Address addr)
 {
-  if (m_ipv4Addr == addr)
+  for (auto &device : m_devices)
     {
-      return true;
+      if (device.address == addr)
+        {
+          return true;
+        }
     }
 
   return false;
 }
 
+Ipv4Address
+BwmLocalAgent::GetIpv4Address (void) const
+{
+  if (m_devices.empty ())
+    {
+      return Ipv4Address ();
+    }
+  return m_devices[0].address;
+}
+
 void
 BwmLocalAgent::SetNewTargetStatus (double newTargetStatus)
 {
@@ -122,11 +191,21 @@ BwmLocalAgent::SetNewTargetStatus (double newTargetStatus)
 }
 
 Ptr<UnitFlow>
-BwmLocalAgent::AddNewUnitFlow (uint32_t tenantId, uint32_t flowId, uint32_t traceId, Ptr<BwmQueueDiscClass> qDiscClass, Ipv4Address src, Ipv4Address dst)
+BwmLocalAgent::AddNewUnitFlow (uint32_t tenantId, uint32_t flowId, uint32_t traceId, Ptr<BwmQueueDiscClass> qDiscClass,
+                               Ipv4Address src, Ipv4Address dst, Ptr<BwmQueueDisc> qdisc)
 {
+  BwmProfiler::Scope scope (BwmProfiler::AGENT);
+  uint32_t device = FindDevice (qdisc);
+  if (device == (uint32_t)-1)
+    {
+      NS_LOG_WARN ("The queue disc hasn't been linked to the agent!");
+      return NULL;
+    }
+  double deviceRateLimit = m_devices[device].rateLimit;
+
   // try to register the new flow in the coordinator and get the assigned bandwidth function
   std::stringstream ss;
-  ss << src.Get () << " " << dst.Get () << " " << m_deviceRateLimit; /* The info str contains src and dst addr, device rate limit*/
+  ss << src.Get () << " " << dst.Get () << " " << deviceRateLimit; /* The info str contains src and dst addr, device rate limit*/
   Ptr<UnitFlow> flow = m_coordinator->RegisterFlow (tenantId, flowId, traceId, ss.str ());
 
   // initialize the data structure of the new unit flow & queue disc class
@@ -135,34 +214,39 @@ BwmLocalAgent::AddNewUnitFlow (uint32_t tenantId, uint32_t flowId, uint32_t trac
       NS_LOG_WARN ("Invalid flow, cannot register!");
       return NULL;
     }
-  m_flowTable.push_back (std::make_pair (flow, qDiscClass));
   /// set the initial rate for the new flow and
-  /// expropriate the rate from other local unit flows belonging to the same tenant
+  /// expropriate the rate from other local unit flows belonging to the same tenant on the same device
   double rateSum = 0;
-  std::list<Ptr<BwmQueueDiscClass>> siblingList;
-  for (auto it : m_flowTable)
+  std::vector<Ptr<BwmQueueDiscClass>> siblingList;
+  BwmLocalFlowStore::TenantGroup *group = m_flowTable.GetTenantGroup (tenantId);
+  if (group != NULL)
     {
-      if (it.first->GetTenantId () == tenantId && it.first->GetFlowId () != flowId)
+      siblingList.reserve (group->entries.size ());
+      for (auto &it : group->entries)
         {
-          siblingList.push_back (it.second);
+          if (it.flow->GetFlowId () != flowId && it.device == device)
+            {
+              siblingList.push_back (it.qDiscClass);
+            }
         }
     }
+  m_flowTable.Insert (flow, qDiscClass, device);
 
   if (siblingList.empty())
     {
       //// No sibling, use standard initial rate
-      qDiscClass->SetRate (m_deviceRateLimit / 10);
+      qDiscClass->SetRate (deviceRateLimit / 10);
     }
   else
     {
-      for (auto it : siblingList)
+      for (auto &it : siblingList)
         {
           rateSum += it->GetRate ().GetBitRate ();
         }
       //// use the average rate as the initial rate
       double initRate = rateSum / (siblingList.size () + 1);
       qDiscClass->SetRate (initRate);
-      for (auto it : siblingList)
+      for (auto &it : siblingList)
         {
           //// expropriate rates proportionally
           it->SetRate (it->GetRate ().GetBitRate () - initRate * (it->GetRate ().GetBitRate () / rateSum));
@@ -175,17 +259,31 @@ BwmLocalAgent::AddNewUnitFlow (uint32_t tenantId, uint32_t flowId, uint32_t trac
 uint32_t
 BwmLocalAgent::AssignFlowId (uint32_t tenantId, Ipv4Address src, Ipv4Address dst)
 {
-  // use 32 bit hash function to generate an approximately unique flow id
-  std::stringstream ss;
-  ss << tenantId << src.Get () << dst.Get ();
-  return Hash32 (ss.str ());
+  // mix the fixed-width fields into an approximately unique flow id,
+  // unlike concatenated decimals distinct tuples cannot alias before hashing
+  uint64_t key = (static_cast<uint64_t> (src.Get ()) << 32) | dst.Get ();
+  key ^= tenantId * 0x9e3779b97f4a7c15ULL;
+  // the 64 bit finalizer of MurmurHash3
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  uint32_t flowId = static_cast<uint32_t> (key ^ (key >> 32));
+
+  // -1 is reserved for unclassified items
+  return flowId == (uint32_t)-1 ? 0 : flowId;
 }
 
 void
 BwmLocalAgent::Update ()
 {
+  BwmProfiler::Scope scope (BwmProfiler::AGENT);
   NS_LOG_INFO ("Host " << m_hostId << " updating @ " << Simulator::Now ().GetSeconds ());
 
+  // tear down unit flows that have finished
+  EvictIdleFlows ();
+
   // report the usage information in last cycle to the coordinator
   ReportUsage ();
 
@@ -199,7 +297,8 @@ BwmLocalAgent::Update ()
 void
 BwmLocalAgent::SetupCAWC (Ptr<Ipv4> ipv4)
 {
-  ipv4->TraceConnectWithoutContext ("Rx", MakeBoundCallback (RxHandler, this));
+  ipv4->TraceConnectWithoutContext ("RxHeader", MakeBoundCallback (RxHandler, this));
+  m_ipv4 = ipv4;
 
   // set up timer for CAWC & schedule the first update
   m_feedbackTimer.SetFunction (&BwmLocalAgent::CAWCCheck, this);
@@ -210,181 +309,244 @@ BwmLocalAgent::SetupCAWC (Ptr<Ipv4> ipv4)
 void
 BwmLocalAgent::CAWCCheck ()
 {
-  for (auto entry : m_scoreboard)
+  BwmProfiler::Scope scope (BwmProfiler::AGENT);
+  int64_t now = Simulator::Now ().GetNanoSeconds ();
+  uint32_t cycle = m_scoreboard.GetCycle ();
+
+  // entries untouched since the last check leave the wheel, idle ones leave the scoreboard
+  for (uint32_t index : m_scoreboard.GetExpiring ())
     {
-      if (Simulator::Now ().GetNanoSeconds () - (int64_t)entry.second[BwmLocalAgent::LMT] > m_feedbackCycle.GetNanoSeconds ())
+      BwmScoreboard::Line &line = m_scoreboard.GetLine (index);
+      if (line.cycle == cycle)
         {
-          //clear outdated data
-          entry.second[BwmLocalAgent::SPC] = 0;
-          entry.second[BwmLocalAgent::CEB] = 0;
-          entry.second[BwmLocalAgent::NMB] = 0;
+          // modified again, it is checked below
+          continue;
         }
+      if (now - line.lastModified > m_feedbackCycle.GetNanoSeconds ())
+        {
+          //free outdated lines, a flow sending again gets a cleared one;
+          //pending factors were flushed by the check that set them
+          NS_ASSERT (!line.feedbackPending);
+          m_scoreboard.Remove (index);
+        }
+      else
+        {
+          // modified exactly one cycle ago, keep it for one more check
+          m_scoreboard.Touch (&line);
+        }
+    }
 
-      if (entry.second[BwmLocalAgent::SPC] > m_feedbackThreshold * 0.2)
+  for (uint32_t index : m_scoreboard.GetModified ())
+    {
+      BwmScoreboard::Line &line = m_scoreboard.GetLine (index);
+      if (line.samples > m_feedbackThreshold * 0.2)
         {
-          float congestion_factor = entry.second[BwmLocalAgent::CEB] / static_cast<float>(entry.second[BwmLocalAgent::CEB] + entry.second[BwmLocalAgent::NMB]);
-          uint8_t* buffer = (uint8_t*)&congestion_factor;
-          Ptr<Packet> feedback = Create<Packet, uint8_t const *, uint32_t> (buffer, 4);
-          SocketIpTosTag tosTag;
-          tosTag.SetTos (0x80);
-          feedback->AddPacketTag (tosTag);
-          FlowIdTag idTag;
-          idTag.SetFlowId (entry.first);
-          feedback->AddPacketTag (idTag);
-          auto ipv4 = m_node->GetObject<Ipv4> ();
-          NS_ASSERT (ipv4 != NULL);
-          ipv4->Send (feedback, m_ipv4Addr, Ipv4Address (entry.second[BwmLocalAgent::SRC]), 0xFD, NULL);
-          entry.second[BwmLocalAgent::SPC] = 0;
+          float congestion_factor = line.ceBytes / static_cast<float>(line.ceBytes + line.normalBytes);
+          SendFeedback (line, congestion_factor, GetIpv4Address (), m_ipv4);
+          line.samples = 0;
         }
     }
+  m_scoreboard.NextCycle ();
+
+  if (m_coalesceFeedback)
+    {
+      FlushFeedback ();
+    }
 
   m_feedbackTimer.Schedule (m_feedbackCycle);
 }
 
 void
-BwmLocalAgent::RxHandler (Ptr<BwmLocalAgent> agent, Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+BwmLocalAgent::RxHandler (Ptr<BwmLocalAgent> agent, const Ipv4Header &ipHeader, Ptr<const Packet> packet, uint32_t interface)
 {
+  BwmProfiler::Scope scope (BwmProfiler::AGENT);
   NS_ASSERT (agent);
-  //peek headers
-  TcpHeader tcpHeader;
-  Ipv4Header ipHeader;
+  //the IP header has been parsed and removed by the Ipv4 Layer
   FlowIdTag idTag;
-  Ptr<Packet> p = packet->Copy ();
-  bool idValid = false;
-
-  if (packet->PeekHeader (ipHeader) == 0)
-    {
-      //there should not be a non IP packet in Ipv4L3Protocol
-      NS_LOG_WARN ("A packet without IP header");
-      NS_ASSERT (0);
-    }
-  if (!(idValid = packet->PeekPacketTag (idTag)))
-    {
-      //there could be some packet without flow id tag
-      NS_LOG_WARN ("A packet without id tag");
-    }
+  bool idValid = packet->PeekPacketTag (idTag);
 
   //check Protocol Number and ToS first
   if (ipHeader.GetProtocol () == 0xFD && ipHeader.GetTos () == 0x80)
     {
       ////if Tos field is set to 1 and Protocol Number is set to 0xFD
       ////then get a congestion feedback from the receiver
-      NS_ASSERT (idValid);
-      uint32_t flowId = idTag.GetFlowId ();
-      p->RemoveHeader (ipHeader);
-      float factor = 0.0;
-      if (p->CopyData ((uint8_t*)&factor, 4) == 4)
+      if (idValid)
         {
-          agent->UpdateCongestionFactor (flowId, factor);
+          ////a single factor of the tagged unit flow
+          float factor = 0.0;
+          if (packet->CopyData ((uint8_t*)&factor, 4) == 4)
+            {
+              agent->UpdateCongestionFactor (idTag.GetFlowId (), factor);
+            }
+        }
+      else
+        {
+          ////a coalesced batch of factors of several unit flows
+          BwmCongestionFeedbackHeader header;
+          packet->PeekHeader (header);
+          for (uint32_t i = 0; i < header.GetNRecords (); i++)
+            {
+              agent->UpdateCongestionFactor (header.GetTraceId (i), header.GetFactor (i));
+            }
         }
 
       return;
     }
 
-  p->RemoveHeader (ipHeader);
-  if (p->RemoveHeader(tcpHeader) == 0)
+  if (!idValid)
     {
-      if (idValid)
-        {
-          //since non-TCP flows have no universal signaling packet,
-          //just check every packet that has flow id
-          agent->AddSBEntry (idTag.GetFlowId (), ipHeader.GetSource ().Get ());
-        }
+      //there could be some packet without flow id tag, CAWC only tracks tagged ones
+      NS_LOG_LOGIC ("A packet without id tag");
+      return;
+    }
 
-      if (ipHeader.GetEcn () == Ipv4Header::ECN_CE)
-        {
-          ////if ECN = 11(CE), then get a ECN from the network, set CE flag
-          if (idValid)
-            agent->UpdateScoreboard(idTag.GetFlowId (), BwmLocalAgent::CEB, ipHeader.GetPayloadSize (), ipHeader, ipv4);
-        }
-      else
-        {
-          ////update normal bytes
-          if (idValid)
-            agent->UpdateScoreboard (idTag.GetFlowId (), BwmLocalAgent::NMB, ipHeader.GetPayloadSize (), ipHeader, ipv4);
-        }
+  //only TCP packets carry a TCP header, others (e.g. UDP control packets) are too short for it
+  if (ipHeader.GetProtocol () != TcpL4Protocol::PROT_NUMBER || packet->GetSize () < 20)
+    {
+      //since non-TCP flows have no universal signaling packet,
+      //just check every packet that has flow id
+      agent->AddSBEntry (idTag.GetFlowId (), ipHeader.GetSource ().Get ());
     }
   else
     {
-      //check flags
-      uint8_t flags = tcpHeader.GetFlags ();
-      if (flags & TcpHeader::SYN)
+      //peek the flags in place, they are the 14th byte of the TCP header
+      uint8_t tcpPrefix[14];
+      packet->CopyData (tcpPrefix, 14);
+      if (tcpPrefix[13] & TcpHeader::SYN)
         {
           ///get a SYN, check scoreboard: if no entry for the new flow, try creating one
-          if (idValid)
-            {
-              //only record the flows with flow id
-              agent->AddSBEntry (idTag.GetFlowId (), ipHeader.GetSource ().Get ());
-            }
-        }
-      else
-        {
-          ///got a normal TCP data packet
-          if (ipHeader.GetEcn () == Ipv4Header::ECN_CE)
-            {
-              ////if ECN = 11(CE), then get a ECN from the network, update CE bytes
-              if (idValid)
-                agent->UpdateScoreboard (idTag.GetFlowId (), BwmLocalAgent::CEB, ipHeader.GetPayloadSize (), ipHeader, ipv4);
-            }
-          else
-            {
-              ////update normal bytes
-              if (idValid)
-                agent->UpdateScoreboard (idTag.GetFlowId (), BwmLocalAgent::NMB, ipHeader.GetPayloadSize (), ipHeader, ipv4);
-            }
+          agent->AddSBEntry (idTag.GetFlowId (), ipHeader.GetSource ().Get ());
+          return;
         }
     }
+
+  ///got a data packet
+
+  if (ipHeader.GetEcn () == Ipv4Header::ECN_CE)
+    {
+      ////if ECN = 11(CE), then get a ECN from the network, update CE bytes
+      agent->UpdateScoreboard (idTag.GetFlowId (), BwmLocalAgent::CEB, ipHeader.GetPayloadSize (), ipHeader, agent->m_ipv4);
+    }
+  else
+    {
+      ////update normal bytes
+      agent->UpdateScoreboard (idTag.GetFlowId (), BwmLocalAgent::NMB, ipHeader.GetPayloadSize (), ipHeader, agent->m_ipv4);
+    }
 }
 
 void
-BwmLocalAgent::UpdateScoreboard (uint32_t flowId, int flag, uint32_t size, Ipv4Header ipHeader, Ptr<Ipv4> ipv4)
+BwmLocalAgent::UpdateScoreboard (uint32_t flowId, int flag, uint32_t size, const Ipv4Header &ipHeader, Ptr<Ipv4> ipv4)
 {
-  auto it = m_scoreboard.find (flowId);
-  NS_ASSERT (it != m_scoreboard.end ());
-  NS_ASSERT ((uint32_t)flag < it->second.size () && flag != 0);
-  it->second[flag] += size;
-  it->second[BwmLocalAgent::SPC]++;
+  BwmScoreboard::Line *line = m_scoreboard.Find (flowId);
+  if (line == NULL)
+    {
+      // the line of a flow idle for a check cycle expired
+      m_scoreboard.Insert (flowId, ipHeader.GetSource ().Get ());
+      line = m_scoreboard.Find (flowId);
+    }
+  NS_ASSERT (flag == BwmLocalAgent::NMB || flag == BwmLocalAgent::CEB);
+  if (flag == BwmLocalAgent::CEB)
+    {
+      line->ceBytes += size;
+    }
+  else
+    {
+      line->normalBytes += size;
+    }
+  line->samples++;
 
-  if (it->second[BwmLocalAgent::SPC] >= m_feedbackThreshold)
+  if (line->samples >= m_feedbackThreshold)
     {
-      float congestion_factor = it->second[BwmLocalAgent::CEB] / static_cast<float>(it->second[BwmLocalAgent::CEB] + it->second[BwmLocalAgent::NMB]);
-      uint8_t* buffer = (uint8_t*)&congestion_factor;
-      Ptr<Packet> feedback = Create<Packet, uint8_t const *, uint32_t> (buffer, 4);
-      SocketIpTosTag tosTag;
-      tosTag.SetTos (0x80);
-      feedback->AddPacketTag (tosTag);
-      FlowIdTag idTag;
-      idTag.SetFlowId (flowId);
-      feedback->AddPacketTag (idTag);
-      ipv4->Send (feedback, ipHeader.GetDestination (), ipHeader.GetSource (), 0xFD, NULL);
-      it->second[BwmLocalAgent::SPC] = 0;
-      it->second[BwmLocalAgent::CEB] = 0;
-      it->second[BwmLocalAgent::NMB] = 0;
+      float congestion_factor = line->ceBytes / static_cast<float>(line->ceBytes + line->normalBytes);
+      SendFeedback (*line, congestion_factor, ipHeader.GetDestination (), ipv4);
+      line->samples = 0;
+      line->ceBytes = 0;
+      line->normalBytes = 0;
     }
 
-  it->second[BwmLocalAgent::LMT] = Simulator::Now ().GetNanoSeconds ();
+  line->lastModified = Simulator::Now ().GetNanoSeconds ();
+  m_scoreboard.Touch (line);
 }
 
 void
-BwmLocalAgent::AddSBEntry (uint32_t flowId, uint32_t srcIp)
+BwmLocalAgent::SendFeedback (BwmScoreboard::Line &line, float factor, Ipv4Address localAddr, Ptr<Ipv4> ipv4)
 {
-  if (m_scoreboard.find (flowId) == m_scoreboard.end ())
+  if (m_coalesceFeedback)
     {
-      std::vector<uint64_t> temp(BwmLocalAgent::SBL_SIZE, 0);
-      temp[BwmLocalAgent::SRC] = srcIp;
-      m_scoreboard.insert(std::make_pair (flowId, temp));
+      // keep the latest factor until the next flush
+      line.pendingFactor = factor;
+      if (!line.feedbackPending)
+        {
+          line.feedbackPending = true;
+          m_pendingFeedback[line.srcIp].push_back (m_scoreboard.GetIndex (&line));
+        }
+      return;
     }
+
+  uint8_t* buffer = (uint8_t*)&factor;
+  Ptr<Packet> feedback = Create<Packet, uint8_t const *, uint32_t> (buffer, 4);
+  SocketIpTosTag tosTag;
+  tosTag.SetTos (0x80);
+  feedback->AddPacketTag (tosTag);
+  FlowIdTag idTag;
+  idTag.SetFlowId (line.flowId);
+  feedback->AddPacketTag (idTag);
+  ipv4->Send (feedback, localAddr, Ipv4Address (line.srcIp), 0xFD, NULL);
 }
 
 void
-BwmLocalAgent::UpdateCongestionFactor (uint32_t flowId, float factor)
+BwmLocalAgent::FlushFeedback ()
 {
-  for (auto flow : m_flowTable)
+  for (auto &host : m_pendingFeedback)
     {
-      if (flow.first->GetTraceId () == flowId)
+      std::vector<uint32_t> &lines = host.second;
+      auto it = lines.begin ();
+      while (it != lines.end ())
         {
-          flow.first->SetCongestionFactor (factor);
+          // pack the factors into as few packets as possible
+          BwmCongestionFeedbackHeader header;
+          for (; it != lines.end (); it++)
+            {
+              BwmScoreboard::Line &line = m_scoreboard.GetLine (*it);
+              if (!header.AddRecord (line.flowId, line.pendingFactor))
+                {
+                  break;
+                }
+              line.feedbackPending = false;
+            }
+
+          // the batch carries no flow id tag, which tells it from a single feedback
+          Ptr<Packet> feedback = Create<Packet> ();
+          feedback->AddHeader (header);
+          SocketIpTosTag tosTag;
+          tosTag.SetTos (0x80);
+          feedback->AddPacketTag (tosTag);
+          m_ipv4->Send (feedback, GetIpv4Address (), Ipv4Address (host.first), 0xFD, NULL);
         }
+      lines.clear ();
+    }
+}
+
+void
+BwmLocalAgent::AddSBEntry (uint32_t flowId, uint32_t srcIp)
+{
+  if (m_scoreboard.Insert (flowId, srcIp))
+    {
+      // put the new line on the wheel, so that it expires if no data follows
+      BwmScoreboard::Line *line = m_scoreboard.Find (flowId);
+      line->lastModified = Simulator::Now ().GetNanoSeconds ();
+      m_scoreboard.Touch (line);
+    }
+}
+
+void
+BwmLocalAgent::UpdateCongestionFactor (uint32_t flowId, float factor)
+{
+  BwmLocalFlowStore::Entry *entry = m_flowTable.FindByTraceId (flowId);
+  if (entry != NULL)
+    {
+      NS_LOG_LOGIC ("Congestion factor of flow " << flowId << " on host " << m_hostId << " is " << factor);
+      entry->flow->SetCongestionFactor (factor);
     }
 }
 
@@ -401,116 +563,337 @@ BwmLocalAgent::StartApplication ()
   m_subTimer.SetFunction (&BwmLocalAgent::TuneRates, this);
   m_subTimer.Schedule (m_tuneCycle);
 
-  // set the device rate limit, only one device by default
-  NS_ASSERT (m_qdisc);
-  auto device = m_qdisc->GetNetDevice ();
-  StringValue rateStr;
-  device->GetAttribute ("DataRate", rateStr);
-  DataRate deviceRate(rateStr.Get ());
-  m_deviceRateLimit = deviceRate.GetBitRate ();
-
-  // get the ipv4 address of the corresponding interface
+  // set the rate limit and the ipv4 address of every device
+  NS_ASSERT (!m_devices.empty ());
   auto ipv4 = m_node->GetObject<Ipv4> ();
-  auto interface = ipv4->GetInterfaceForDevice (device);
-  if (interface == -1)
+  for (auto &it : m_devices)
     {
-      NS_LOG_WARN ("The agent hasn't been linked to interface!");
-      NS_ASSERT (0);
+      auto device = it.qdisc->GetNetDevice ();
+      StringValue rateStr;
+      device->GetAttribute ("DataRate", rateStr);
+      DataRate deviceRate(rateStr.Get ());
+      it.rateLimit = deviceRate.GetBitRate ();
+      it.rateLimitFlag = false;
+
+      auto interface = ipv4->GetInterfaceForDevice (device);
+      if (interface == -1)
+        {
+          NS_LOG_WARN ("The agent hasn't been linked to interface!");
+          NS_ASSERT (0);
+        }
+      it.address = ipv4->GetAddress (interface, 0).GetLocal ();
     }
-  m_ipv4Addr = ipv4->GetAddress (interface, 0).GetLocal ();
+
+  // open the control socket if reports travel over the network
+  if (m_coordinator->GetControlTransport () == BwmCoordinator::UDP)
+    {
+      m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+      if (m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_coordinator->GetStatusPort ())) == -1)
+        {
+          NS_FATAL_ERROR ("Failed to bind the status socket of host " << m_hostId);
+        }
+      m_socket->SetRecvCallback (MakeCallback (&BwmLocalAgent::HandleStatus, this));
+    }
+}
+
+void
+BwmLocalAgent::DoDispose (void)
+{
+  // the RxHeader trace of the Ipv4 layer holds the agent, release the layer in turn
+  m_ipv4 = 0;
+  Application::DoDispose ();
 }
 
 void
 BwmLocalAgent::StopApplication ()
 {
   // post-process
+  if (m_socket)
+    {
+      m_socket->Close ();
+      m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_socket = 0;
+    }
 }
 
 void
 BwmLocalAgent::ReportUsage ()
 {
   std::list<Ptr<UnitFlow>> flowList;
-  for (auto it : m_flowTable)
+  for (uint32_t g = 0; g < m_flowTable.GetNGroups (); g++)
+    {
+      for (auto &it : m_flowTable.GetGroup (g).entries)
+        {
+          // calculate the usage in bandwidth for each unit flow over the epoch it was really counted in
+          Time elapsed = Simulator::Now () - it.qDiscClass->GetSnapshotTime ();
+          it.flow->SetBandwidthUsage (elapsed.IsStrictlyPositive () ? it.qDiscClass->GetUsage () / elapsed.GetSeconds () : 0);
+          flowList.push_back (it.flow);
+        }
+    }
+
+  if (m_socket)
     {
-      // calculate the usage in bandwidth for each unit flow
-      it.first->SetBandwidthUsage (it.second->GetUsage () * 1e3 / static_cast<double> (m_reportCycle.GetMilliSeconds ()));
-      flowList.push_back (it.first);
+      SendReport (flowList);
+      return;
     }
-  
   m_coordinator->UpdateUsage (this, flowList);
 }
 
+void
+BwmLocalAgent::SendReport (const std::list<Ptr<UnitFlow> > &flowList)
+{
+  // group the records by the coordinator owning their tenants
+  std::map<Ptr<BwmCoordinator>, std::list<Ptr<UnitFlow> > > shardReports;
+  for (auto flow : flowList)
+    {
+      shardReports[m_coordinator->GetShard (flow->GetTenantId ())].push_back (flow);
+    }
+  if (shardReports.empty ())
+    {
+      // an empty report still asks the coordinator for a new status
+      shardReports[m_coordinator];
+    }
+
+  uint32_t reportId = m_reportId++;
+  auto replyGroup = std::prev (shardReports.end ());
+  for (auto group = shardReports.begin (); group != shardReports.end (); group++)
+    {
+      InetSocketAddress coordinatorAddr (group->first->GetControlAddress (), group->first->GetReportPort ());
+      uint32_t segmentNum = std::max<uint32_t> ((group->second.size () + BwmUsageReportHeader::MAX_RECORDS - 1)
+                                                / BwmUsageReportHeader::MAX_RECORDS, 1);
+
+      // pack the records into as few segments as possible
+      auto it = group->second.begin ();
+      for (uint32_t segment = 0; segment < segmentNum; segment++)
+        {
+          BwmUsageReportHeader header;
+          header.SetHostId (m_hostId);
+          header.SetReportId (reportId);
+          header.SetSegment (segment, segmentNum);
+          // one coordinator replies, once it has received all of its segments
+          header.SetReplyRequested (group == replyGroup);
+          while (it != group->second.end () && header.AddRecord ((*it)->GetTenantId (), (*it)->GetFlowId (), (*it)->GetBandwidthUsage ()))
+            {
+              it++;
+            }
+
+          Ptr<Packet> packet = Create<Packet> ();
+          packet->AddHeader (header);
+          m_socket->SendTo (packet, 0, coordinatorAddr);
+        }
+      NS_ASSERT (it == group->second.end ());
+    }
+}
+
+void
+BwmLocalAgent::HandleStatus (Ptr<Socket> socket)
+{
+  BwmProfiler::Scope scope (BwmProfiler::AGENT);
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      BwmTargetStatusHeader header;
+      packet->RemoveHeader (header);
+      SetNewTargetStatus (header.GetTargetStatus ());
+    }
+}
+
 void
 BwmLocalAgent::ClearUsage ()
 {
-  for (auto it : m_flowTable)
+  for (uint32_t g = 0; g < m_flowTable.GetNGroups (); g++)
     {
-      // reset the usage for each unit flow
-      it.second->ResetUsage ();
+      for (auto &it : m_flowTable.GetGroup (g).entries)
+        {
+          // start a new usage epoch for each unit flow
+          it.qDiscClass->SnapshotUsage ();
+        }
     }
 }
 
 void
 BwmLocalAgent::TuneRates ()
 {
-  double rateSum = 0;
-  // compute the new fair share for each unit flow
-  for (auto it : m_flowTable)
+  BwmProfiler::Scope scope (BwmProfiler::AGENT);
+  // copy the state of the unit flows into the tune arrays
+  uint32_t n = m_flowTable.GetSize ();
+  m_tune.entries.resize (n);
+  m_tune.devices.resize (n);
+  m_tune.fairShares.resize (n);
+  m_tune.usages.resize (n);
+  m_tune.congestions.resize (n);
+  m_tune.pinned.resize (n);
+  m_tune.tuned.resize (n);
+  m_tune.rates.resize (n);
+  m_tune.functions.resize (n);
+  m_tune.segStarts.resize (n);
+  m_tune.segEnds.resize (n);
+  m_tune.segBandwidths.resize (n);
+  m_tune.segSlopes.resize (n);
+  uint32_t slot = 0;
+  for (uint32_t g = 0; g < m_flowTable.GetNGroups (); g++)
     {
-      if (!m_CAWCEnable || it.first->GetCongestionFactor () >= m_congestionThreshold || m_deviceRateLimitFlag)
+      for (auto &it : m_flowTable.GetGroup (g).entries)
         {
-          // without CAWC
-          // or in congestion state, follow coordinator
-          double oldFS = std::max(it.first->GetAllocatedFS (), 10.0);
-          double newFS = oldFS + (m_targetStatus - oldFS) * m_k;
-          it.first->SetAllocatedFS (newFS);
-          rateSum += it.first->GetAllocatedRate ();
+          m_tune.entries[slot] = &it;
+          m_tune.devices[slot] = it.device;
+          m_tune.fairShares[slot] = it.flow->GetAllocatedFS ();
+          m_tune.usages[slot] = it.flow->GetBandwidthUsage ();
+          m_tune.congestions[slot] = it.flow->GetCongestionFactor ();
+          m_tune.pinned[slot] = it.flow->GetPinnedFS ();
+          slot++;
         }
-      else if (it.first->GetBandwidthUsage () != 0)
+    }
+
+  // compute the new fair share for each unit flow:
+  // a fair share pinned by the coordinator is taken as it is,
+  // without CAWC, on a saturated device or in congestion state, follow coordinator,
+  // not in congestion state and in working state, enforce work-conserving
+  double growth = 1 + 1.0 / (m_reportCycle / m_tuneCycle);
+  double *fairShares = m_tune.fairShares.data ();
+  const double *usages = m_tune.usages.data ();
+  const double *congestions = m_tune.congestions.data ();
+  const double *pinned = m_tune.pinned.data ();
+  double *tuned = m_tune.tuned.data ();
+  const uint32_t *devices = m_tune.devices.data ();
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double oldFS = std::max (fairShares[i], 10.0);
+      bool follow = !m_CAWCEnable || m_devices[devices[i]].rateLimitFlag || congestions[i] >= m_congestionThreshold;
+      bool working = usages[i] != 0;
+      double followFS = oldFS + (m_targetStatus - oldFS) * m_k;
+      double workFS = oldFS * growth;
+      bool isPinned = pinned[i] >= 0;
+      fairShares[i] = isPinned ? pinned[i] : (follow ? followFS : (working ? workFS : fairShares[i]));
+      tuned[i] = (isPinned || follow || working) ? 1.0 : 0.0;
+    }
+
+  // map the fair shares to rates through the cached segments
+  RefreshSegments ();
+  const double *segStarts = m_tune.segStarts.data ();
+  const double *segBandwidths = m_tune.segBandwidths.data ();
+  const double *segSlopes = m_tune.segSlopes.data ();
+  double *rates = m_tune.rates.data ();
+  m_tune.rateSums.assign (m_devices.size (), 0);
+  double *rateSums = m_tune.rateSums.data ();
+  for (uint32_t i = 0; i < n; i++)
+    {
+      rates[i] = segBandwidths[i] + (fairShares[i] - segStarts[i]) * segSlopes[i];
+      rateSums[devices[i]] += rates[i] * tuned[i];
+    }
+
+  for (uint32_t i = 0; i < n; i++)
+    {
+      if (tuned[i] != 0)
         {
-          // not in congestion state and in working state, enforce work-conserving
-          double oldFS = std::max(it.first->GetAllocatedFS (), 10.0);
-          double newFS = oldFS * (1 + 1.0 / (m_reportCycle / m_tuneCycle));
-          it.first->SetAllocatedFS (newFS);
-          rateSum += it.first->GetAllocatedRate ();
+          m_tune.entries[i]->flow->SetAllocatedFS (fairShares[i]);
         }
     }
 
-  if (rateSum == 0)
+  // check the rate limit of each local device
+  m_tune.scalingFactors.assign (m_devices.size (), 1.0);
+  double *scalingFactors = m_tune.scalingFactors.data ();
+  for (uint32_t d = 0; d < m_devices.size (); d++)
     {
-      rateSum = m_deviceRateLimit * 0.1;
+      Device &device = m_devices[d];
+      double rateSum = rateSums[d] == 0 ? device.rateLimit * 0.1 : rateSums[d];
+      if (rateSum >= device.rateLimit)
+        {
+          // enforce the device rate limit
+          scalingFactors[d] = device.rateLimit / rateSum;
+          device.rateLimitFlag = true;
+        }
+      else
+        {
+          device.rateLimitFlag = false;
+        }
+      if (rateSum * scalingFactors[d] <= 0)
+        {
+          NS_LOG_INFO ("All rates of device " << d << " equal to zero");
+          scalingFactors[d] = 0;
+        }
     }
 
-  double scalingFactor = 1.0;
-  // check the rate limit of local device
-  if (rateSum >= m_deviceRateLimit)
+  // set the rate of each bwm qdisc class whose rate has changed enough
+  for (uint32_t i = 0; i < n; i++)
     {
-      // enforce the device rate limit
-      scalingFactor *= (m_deviceRateLimit / rateSum);
-      m_deviceRateLimitFlag = true;
+      if (scalingFactors[devices[i]] == 0)
+        {
+          continue;
+        }
+      DataRate newRate (rates[i] * scalingFactors[devices[i]]);
+      Ptr<BwmQueueDiscClass> qDiscClass = m_tune.entries[i]->qDiscClass;
+      uint64_t oldBitRate = qDiscClass->GetRate ().GetBitRate ();
+      uint64_t newBitRate = newRate.GetBitRate ();
+      uint64_t delta = newBitRate > oldBitRate ? newBitRate - oldBitRate : oldBitRate - newBitRate;
+      if (delta > 0 && delta >= m_rateTolerance * oldBitRate)
+        {
+          qDiscClass->SetRate (newRate);
+        }
     }
-  else
+
+  m_subTimer.Schedule (m_tuneCycle);
+}
+
+void
+BwmLocalAgent::RefreshSegments ()
+{
+  for (uint32_t i = 0; i < m_tune.entries.size (); i++)
     {
-      m_deviceRateLimitFlag = false;
+      Ptr<BandwidthFunction> function = m_tune.entries[i]->flow->GetTransformedBF ();
+      double fairShare = m_tune.fairShares[i];
+      if (function == m_tune.functions[i]
+          && fairShare >= m_tune.segStarts[i] && fairShare < m_tune.segEnds[i])
+        {
+          continue;
+        }
+
+      m_tune.functions[i] = function;
+      if (function == NULL)
+        {
+          // a unit flow without function gets no rate
+          m_tune.segStarts[i] = 0;
+          m_tune.segEnds[i] = std::numeric_limits<double>::infinity ();
+          m_tune.segBandwidths[i] = 0;
+          m_tune.segSlopes[i] = 0;
+          continue;
+        }
+      function->GetSegment (fairShare, m_tune.segStarts[i], m_tune.segEnds[i],
+                            m_tune.segBandwidths[i], m_tune.segSlopes[i]);
     }
+}
 
-  // set the rate of TBF rate limiter
-  double rate = rateSum * scalingFactor;
-  if (rate <= 0)
+void
+BwmLocalAgent::EvictIdleFlows ()
+{
+  if (m_idleTimeout.IsZero ())
     {
-      NS_LOG_INFO ("All rates equal to zero");
       return;
     }
 
-  // set the rate of each bwm qdisc class
-  for (auto it : m_flowTable)
+  Time now = Simulator::Now ();
+  for (uint32_t g = 0; g < m_flowTable.GetNGroups (); g++)
     {
-      // set the actual rate for each unit flow
-      DataRate newRate (it.first->GetAllocatedRate () * scalingFactor);
-      it.second->SetRate (newRate);
+      std::vector<BwmLocalFlowStore::Entry> &entries = m_flowTable.GetGroup (g).entries;
+      uint32_t i = 0;
+      while (i < entries.size ())
+        {
+          Ptr<BwmQueueDiscClass> qDiscClass = entries[i].qDiscClass;
+          if (qDiscClass->GetNPackets () == 0
+              && now - qDiscClass->GetLastActiveTime () >= m_idleTimeout)
+            {
+              NS_LOG_INFO ("Evict idle unit flow " << entries[i].flow->GetTraceId () << " on host " << m_hostId);
+              m_coordinator->DeregisterFlow (entries[i].flow);
+              m_devices[entries[i].device].qdisc->ReleaseQueueDiscClass (qDiscClass);
+              // the last unit flow of the tenant moves here and is checked next
+              m_flowTable.EraseAt (g, i);
+            }
+          else
+            {
+              i++;
+            }
+        }
     }
-
-  m_subTimer.Schedule (m_tuneCycle);
 }
 
 }
@@ -7,6 +7,9 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv4.h"
 #include "ns3/tbf-queue-disc.h"
+#include "ns3/socket.h"
+#include "ns3/bwm-local-flow-store.h"
+#include "ns3/bwm-scoreboard.h"
 #include <list>
 #include <map>
 #include <vector>
@@ -14,6 +17,7 @@
 namespace ns3 {
 
 class UnitFlow;
+class BandwidthFunction;
 class BwmCoordinator;
 class BwmQueueDisc;
 class BwmQueueDiscClass;
@@ -27,6 +31,10 @@ class BwmQueueDiscClass;
  * collecting info of local unit flows,
  * reporting usage,
  * etc.
+ *
+ * A host may have several devices, each with its own BwmQueueDisc, rate
+ * limit and address. The unit flows of all devices share one flow table and
+ * one usage report, while the rates are scaled per device.
  */
 class BwmLocalAgent : public Application {
 public:
@@ -44,19 +52,11 @@ public:
   ~BwmLocalAgent ();
 
   /**
-   * \brief The iterator of the scoreboard.
-   */
-  typedef std::map<uint32_t, std::vector<uint32_t>>::iterator SBIterator;
-  /**
-   * \brief The flags of each unit in a scoreboard line
-   * SPC: sample counter
+   * \brief The byte counters of a scoreboard line a sample is added to
    * NMB: normal bytes
    * CEB: congestion encountered bytes
-   * LMT: last modified time in ns
-   * SRC: source IP address
-   * SBL_SIZE: size of each scoreboard line
    */
-  enum ScoreboardUnit { SPC, NMB, CEB, LMT, SRC, SBL_SIZE};
+  enum ScoreboardUnit { NMB, CEB };
 
   /**
    * \brief Set a id to the host.
@@ -68,30 +68,45 @@ public:
    */
   uint32_t GetHostId (void);
   /**
-   * \brief Link a bwm queue disc to this host.
+   * \brief Link a bwm queue disc to this host, replacing the linked ones.
    */
   void SetQueueDisc (Ptr<BwmQueueDisc> qdisc);
+  /**
+   * \brief Link the bwm queue disc of another device to this host.
+   */
+  void AddQueueDisc (Ptr<BwmQueueDisc> qdisc);
+  /**
+   * \brief Get the number of devices linked to this host.
+   * \return the number of linked queue discs
+   */
+  uint32_t GetNDevices (void) const;
   /**
    * \brief Link a bwm coordinator to this host.
    */
   void SetCoordinator (Ptr<BwmCoordinator> coordinator);
   /**
-   * \brief Check whether the ip address belongs to this host.
+   * \brief Check whether the ip address belongs to a device of this host.
    * \return true if the addr belongs to the host, false otherwise
    */
   bool CheckIP (Ipv4Address addr);
+  /**
+   * \brief Get the ipv4 address of this host, the one of its first device.
+   * \return the local ipv4 address the control plane uses
+   */
+  Ipv4Address GetIpv4Address (void) const;
   /**
    * \brief Set the new target status which will be used to tune rate limits for all local unit flows.
    */
   void SetNewTargetStatus (double);
   /**
-   * \brief Register a new unit flow into the local agent.
+   * \brief Register a new unit flow leaving by the device of a queue disc into the local agent.
    * \return the flow pointer if the operation succeed, NULL otherwise.
    */
-  Ptr<UnitFlow> AddNewUnitFlow (uint32_t tenantId, uint32_t flowId, uint32_t traceId, Ptr<BwmQueueDiscClass> qDiscClass, Ipv4Address src, Ipv4Address dst);
+  Ptr<UnitFlow> AddNewUnitFlow (uint32_t tenantId, uint32_t flowId, uint32_t traceId, Ptr<BwmQueueDiscClass> qDiscClass,
+                                Ipv4Address src, Ipv4Address dst, Ptr<BwmQueueDisc> qdisc);
   /**
    * \brief Assign a new id to a new unit flow belonging to the local agent.
-   * \return the flow id generated by hash function on tenantId, src addr and dst addr.
+   * \return the flow id generated by an integer mix of tenantId, src addr and dst addr.
    */
   uint32_t AssignFlowId (uint32_t tenantId, Ipv4Address src, Ipv4Address dst);
   /**
@@ -105,25 +120,27 @@ public:
   /**
    * \brief Setup Congestion-Aware Work-Conserving mechanism.
    * 
-   * This method connect the RxTrace of Ipv4 Layer to the RxHandle
+   * This method connect the RxHeader trace of Ipv4 Layer to the RxHandler
    * and set up the timer for periodical work-conserving rate updateing.
    */
   void SetupCAWC(Ptr<Ipv4> ipv4);
   /**
-   * \brief Check each entry of the scoreboard and selectively send feedback.
+   * \brief Age the scoreboard and selectively send feedback.
    * 
-   * This method will check the sample count in each entry of the scoreboard.
-   * If the SPC is higher than one fifth of the feedback threshold, actively 
-   * send feedback to the sender.
+   * Entries that have not been modified for a feedback cycle are cleared.
+   * This method then checks the sample count of each entry modified in the
+   * last cycle. If the SPC is higher than one fifth of the feedback
+   * threshold, actively send feedback to the sender.
    */
   void CAWCCheck ();
   /**
    * \brief Handle each received packet.
    * 
-   * This method will be connected to the RxTrace of Ipv4 Layer.
-   * 
+   * This method will be connected to the RxHeader trace of Ipv4 Layer.
+   * It reads the parsed IP header and peeks the TCP flags in place,
+   * the packet is never copied.
    */
-  static void RxHandler (Ptr<BwmLocalAgent> agent, Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface);
+  static void RxHandler (Ptr<BwmLocalAgent> agent, const Ipv4Header &ipHeader, Ptr<const Packet> packet, uint32_t interface);
   /**
    * \brief Update the scoreboard of a unit flow.
    * 
@@ -132,7 +149,7 @@ public:
    * 
    * The flag conforms the scoreboard unit flags
    */
-  void UpdateScoreboard (uint32_t flowId, int flag, uint32_t size, Ipv4Header ipHeader, Ptr<Ipv4> ipv4);
+  void UpdateScoreboard (uint32_t flowId, int flag, uint32_t size, const Ipv4Header &ipHeader, Ptr<Ipv4> ipv4);
   /**
    * \brief Add an entry to the scoreboard for an incoming unit flow.
    * 
@@ -147,6 +164,10 @@ public:
    * The flowId argument is actually the traceId carried in FlowIdTag
    */
   void UpdateCongestionFactor (uint32_t flowId, float factor);
+
+protected:
+  virtual void DoDispose (void);
+
 private:
   /**
    * \brief Start up the application.
@@ -161,35 +182,116 @@ private:
    */
   void ReportUsage ();
   /**
-   * \brief Reset usage statistics of all unit flows.
+   * \brief Send the usage of the unit flows to the coordinator as UDP packets.
+   */
+  void SendReport (const std::list<Ptr<UnitFlow> > &flowList);
+  /**
+   * \brief Handle target status packets received from the coordinator.
+   */
+  void HandleStatus (Ptr<Socket> socket);
+  /**
+   * \brief Start a new usage epoch of all unit flows.
    */
   void ClearUsage ();
   /**
    * \brief Use Distributed Edge Optimization Algorithm to tune rates of all unit flows.
+   *
+   * The unit flows are copied into the tune arrays, all fair shares and rates
+   * are computed in flat loops over the arrays, and a rate is only pushed to
+   * the queue disc class when it moved by more than the rate tolerance.
    */
   void TuneRates ();
+  /**
+   * \brief Refresh the cached bandwidth function segments that no longer cover the fair shares.
+   */
+  void RefreshSegments ();
+  /**
+   * \brief Deregister unit flows that have been idle for longer than the idle timeout.
+   *
+   * An evicted unit flow is removed from the coordinator and its queue disc class
+   * is released to the queue disc for reuse.
+   */
+  void EvictIdleFlows ();
+  /**
+   * \brief Send the congestion factor of a unit flow to its sender.
+   *
+   * With feedback coalescing the factor waits in the scoreboard line for FlushFeedback.
+   */
+  void SendFeedback (BwmScoreboard::Line &line, float factor, Ipv4Address localAddr, Ptr<Ipv4> ipv4);
+  /**
+   * \brief Send the pending congestion factors, batched into one packet per sender host.
+   */
+  void FlushFeedback ();
+  /**
+   * \brief Find the device of a linked queue disc.
+   * \return the index of the device, or -1 if the queue disc isn't linked
+   */
+  uint32_t FindDevice (Ptr<BwmQueueDisc> qdisc) const;
+
+  /**
+   * \brief A device of the host and its BwM queue disc
+   */
+  struct Device
+  {
+    Ptr<BwmQueueDisc> qdisc;    //!< The queue disc of the device
+    Ipv4Address address;        //!< The ipv4 address of the device
+    double rateLimit;           //!< The limit caused by the fixed device rate
+    bool rateLimitFlag;         //!< Whether the sum of rates achieved the device rate limit
+  };
 
-  std::list<std::pair<Ptr<UnitFlow>, Ptr<BwmQueueDiscClass>>> m_flowTable; //!< Flow table of the local host
+  BwmLocalFlowStore m_flowTable; //!< Flow table of the local host, grouped by tenant
   Ptr<BwmCoordinator> m_coordinator; //!< Corresponding central coordinator
-  Ptr<BwmQueueDisc> m_qdisc; //!< Corresponding local BwM queue disc
+  std::vector<Device> m_devices; //!< The devices of the host, the first one carries the control plane
   uint32_t m_hostId; //!< The unique id used to identify this host
-  Ipv4Address m_ipv4Addr; //!< The local ipv4 address
+  Ptr<Socket> m_socket; //!< The socket used when the control plane runs over UDP
+  uint32_t m_reportId; //!< The id of the next usage report sent over UDP
+
+  /**
+   * \brief The state of the unit flows during one tuning pass, one array per field
+   *
+   * Slot i of every array belongs to the i-th unit flow in tenant group order.
+   * The segment arrays cache the bandwidth function segment of the slot and are
+   * kept across passes, they are refreshed when the fair share leaves the segment
+   * or the slot is held by a flow with another function.
+   */
+  struct TuneArrays
+  {
+    std::vector<BwmLocalFlowStore::Entry*> entries; //!< The unit flow of each slot
+    std::vector<uint32_t> devices;      //!< Device of the unit flow
+    std::vector<double> fairShares;     //!< Allocated fair share
+    std::vector<double> usages;         //!< Bandwidth usage
+    std::vector<double> congestions;    //!< Congestion factor
+    std::vector<double> pinned;         //!< Fair share pinned by the coordinator, negative if none
+    std::vector<double> tuned;          //!< 1 if the fair share was tuned in this pass, 0 otherwise
+    std::vector<double> rates;          //!< Unscaled rate of the new fair share
+    std::vector<Ptr<BandwidthFunction> > functions; //!< The function the segment was taken from
+    std::vector<double> segStarts;      //!< Fair share where the segment starts
+    std::vector<double> segEnds;        //!< Fair share where the segment ends
+    std::vector<double> segBandwidths;  //!< Bandwidth at the start of the segment
+    std::vector<double> segSlopes;      //!< Slope of the segment
+    std::vector<double> rateSums;       //!< Sum of the tuned rates of each device
+    std::vector<double> scalingFactors; //!< Rate scaling factor of each device
+  };
 
   Timer m_timer; //!< The timer used to report usage & update status
   Timer m_subTimer; //!< The timer used to tune rates
   double m_k; //!< Learning rate used in distributed edge optimization
   Time m_reportCycle; //!< The collecting & update cycle
   Time m_tuneCycle; //!< The rate tunning cycle
+  Time m_idleTimeout; //!< The idle time after which a unit flow is evicted, zero means never
   double m_targetStatus; //!< Target status used in distributed edge optimization
-  double m_deviceRateLimit; //!< The limit caused by the fixed device rate
-  bool m_deviceRateLimitFlag; //!< The flag used to indicate whether the sum of rate achieve the device rate limit
+  double m_rateTolerance; //!< Relative rate change below which a class keeps its rate
+  TuneArrays m_tune; //!< The arrays of the tuning pass
 
   bool m_CAWCEnable; //!< The enable flag of CAWC mechanism
+  Ptr<Ipv4> m_ipv4; //!< The Ipv4 Layer sending the CAWC feedback
   Timer m_feedbackTimer; //!< The timer used to update work-conserving rate
   Time m_feedbackCycle; //!< The update cycle
   uint32_t m_feedbackThreshold; //!< The feedback threshold of update
   double m_congestionThreshold; //!< The congestion threshold of each unit flow
-  std::map<uint32_t, std::vector<uint64_t>> m_scoreboard; //!< The scoreboard used to estimate congestion condition
+  BwmScoreboard m_scoreboard; //!< The scoreboard used to estimate congestion condition
+  bool m_coalesceFeedback; //!< Whether congestion factors are batched per sender host
+  std::map<uint32_t, std::vector<uint32_t> > m_pendingFeedback; //!< Scoreboard lines with pending factors by sender address
 };
 
 }
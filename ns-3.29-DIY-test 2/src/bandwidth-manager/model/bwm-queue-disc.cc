@@ -1,7 +1,9 @@
 #include "ns3/log.h"
 #include "ns3/string.h"
+#include "ns3/enum.h"
 #include "ns3/tenant-id-tag.h"
 #include "ns3/flow-id-tag.h"
+#include "ns3/bwm-profiler.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/tcp-header.h"
 #include "ns3/internet-module.h"
@@ -30,7 +32,7 @@ BwmQueueDiscClass::GetTypeId (void)
                      MakeTraceSourceAccessor (&BwmQueueDiscClass::m_rate),
                      "ns3::TracedValueCallback::DataRate")
     .AddTraceSource ("Usage",
-                     "Statistical usage data in bytes",
+                     "Bytes dequeued in the last usage epoch, updated on every snapshot",
                      MakeTraceSourceAccessor (&BwmQueueDiscClass::m_usage),
                      "ns3::TracedValueCallback::Double")
   ;
@@ -41,7 +43,15 @@ BwmQueueDiscClass::BwmQueueDiscClass ()
 {
   m_rate = DataRate ("0KB/s");
   m_usage = 0;
+  m_txBytes = 0;
+  m_txPackets = 0;
+  m_snapshotBytes = 0;
+  m_snapshotTime = Simulator::Now ();
   m_traceId = -1;
+  m_lastActiveTime = Seconds (0);
+  m_state = IDLE;
+  m_nextDeparture = Seconds (0);
+  m_wheelPackets = 0;
 }
 
 BwmQueueDiscClass::~BwmQueueDiscClass ()
@@ -52,22 +62,31 @@ BwmQueueDiscClass::~BwmQueueDiscClass ()
 void
 BwmQueueDiscClass::AddUsage (uint32_t pktSize)
 {
-  m_usage += pktSize;
+  m_txBytes += pktSize;
+  m_txPackets++;
 }
 
 Ptr<QueueDiscItem>
 BwmQueueDiscClass::Dequeue ()
 {
   NS_LOG_INFO (this);
+  NS_ASSERT_MSG (GetQueueDisc (), "Packets of a class paced by the timing wheel are held by the BwmQueueDisc");
 
-  return GetQueueDisc ()->Dequeue ();
+  Ptr<QueueDiscItem> item = GetQueueDisc ()->Dequeue ();
+  if (item)
+    {
+      AddUsage (item->GetSize ());
+    }
+  return item;
 }
 
 bool
 BwmQueueDiscClass::Enqueue (Ptr<QueueDiscItem> item)
 {
   NS_LOG_INFO (this << item);
+  NS_ASSERT_MSG (GetQueueDisc (), "Packets of a class paced by the timing wheel are held by the BwmQueueDisc");
 
+  m_lastActiveTime = Simulator::Now ();
   return GetQueueDisc ()->Enqueue (item);
 }
 
@@ -75,6 +94,7 @@ Ptr<QueueDiscItem>
 BwmQueueDiscClass::Drop (void)
 {
   NS_LOG_INFO (this);
+  NS_ASSERT_MSG (GetQueueDisc (), "Packets of a class paced by the timing wheel are held by the BwmQueueDisc");
 
   return GetQueueDisc ()->Dequeue ();
 }
@@ -92,8 +112,14 @@ BwmQueueDiscClass::SetRate (DataRate rate)
   // record the new rate parameter
   m_rate = rate;
 
-  // set the rate of internal TBF qdisc
+  // flows paced by the timing wheel read the rate on enqueue
   Ptr<TbfQueueDisc> rateLimiter = DynamicCast<TbfQueueDisc, QueueDisc> (GetQueueDisc ());
+  if (rateLimiter == NULL)
+    {
+      return true;
+    }
+
+  // set the rate of internal TBF qdisc
   DataRate newRate (rate);
   rateLimiter->SetRate (newRate);
 
@@ -139,13 +165,55 @@ BwmQueueDiscClass::SetTraceId (uint32_t traceId)
 double
 BwmQueueDiscClass::GetUsage () const
 {
-  return m_usage * 8;
+  return (m_txBytes - m_snapshotBytes) * 8.0;
+}
+
+double
+BwmQueueDiscClass::GetEpochUsage () const
+{
+  return m_usage;
+}
+
+Time
+BwmQueueDiscClass::GetSnapshotTime () const
+{
+  return m_snapshotTime;
 }
 
 void
-BwmQueueDiscClass::ResetUsage ()
+BwmQueueDiscClass::SnapshotUsage ()
 {
-  m_usage = 0;
+  m_usage = m_txBytes - m_snapshotBytes;
+  m_snapshotBytes = m_txBytes;
+  m_snapshotTime = Simulator::Now ();
+}
+
+uint64_t
+BwmQueueDiscClass::GetTxBytes () const
+{
+  return m_txBytes;
+}
+
+uint64_t
+BwmQueueDiscClass::GetTxPackets () const
+{
+  return m_txPackets;
+}
+
+Time
+BwmQueueDiscClass::GetLastActiveTime () const
+{
+  return m_lastActiveTime;
+}
+
+uint32_t
+BwmQueueDiscClass::GetNPackets () const
+{
+  if (GetQueueDisc ())
+    {
+      return GetQueueDisc ()->GetNPackets ();
+    }
+  return m_wheelPackets;
 }
 
 NS_OBJECT_ENSURE_REGISTERED (BwmQueueDisc);
@@ -164,10 +232,27 @@ BwmQueueDisc::GetTypeId (void)
                                           &QueueDisc::GetMaxSize),
                    MakeQueueSizeChecker ())
     .AddAttribute ("Flows",
-                   "The number of queues into which the incoming packets are classified",
+                   "The number of flows the flow table holds before it grows",
                    UintegerValue (1031),
                    MakeUintegerAccessor (&BwmQueueDisc::SetFlowNum),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RateLimiter",
+                   "The rate limiter of the unit flows",
+                   EnumValue (TBF),
+                   MakeEnumAccessor (&BwmQueueDisc::m_rateLimiter),
+                   MakeEnumChecker (TBF, "Tbf",
+                                    CAROUSEL, "Carousel"))
+    .AddAttribute ("WheelGranularity",
+                   "The time covered by a slot of the timing wheel in Carousel mode",
+                   TimeValue (MicroSeconds (10)),
+                   MakeTimeAccessor (&BwmQueueDisc::m_wheelGranularity),
+                   MakeTimeChecker (TimeStep (1)))
+    .AddAttribute ("WheelHorizon",
+                   "The farthest departure time accepted by the timing wheel in Carousel mode, "
+                   "packets of a flow queued beyond it are dropped",
+                   TimeValue (MilliSeconds (200)),
+                   MakeTimeAccessor (&BwmQueueDisc::m_wheelHorizon),
+                   MakeTimeChecker (TimeStep (1)))
     .AddTraceSource ("FlowCreate",
                      "Create an internal queue disc class for a unit-flow",
                      MakeTraceSourceAccessor (&BwmQueueDisc::m_flowCreateTrace),
@@ -178,7 +263,10 @@ BwmQueueDisc::GetTypeId (void)
 
 BwmQueueDisc::BwmQueueDisc ()
 {
-  m_nextFlow = 0;
+  m_lastTenantId = -1;
+  m_wheelFreeEntry = -1;
+  m_wheelCursor = 0;
+  m_wheelPackets = 0;
 }
 
 BwmQueueDisc::~BwmQueueDisc ()
@@ -186,10 +274,28 @@ BwmQueueDisc::~BwmQueueDisc ()
   
 }
 
+void
+BwmQueueDisc::DoDispose (void)
+{
+  Simulator::Cancel (m_wakeEvent);
+  Simulator::Cancel (m_wheelEvent);
+  m_activeClasses.clear ();
+  m_throttledClasses.clear ();
+  m_freeClasses.clear ();
+  m_wheel.clear ();
+  m_wheelBusy.clear ();
+  m_wheelEntries.clear ();
+  m_wheelClasses.clear ();
+  m_defaultFlow = 0;
+  m_lastFlow = 0;
+  m_agent = 0;
+  QueueDisc::DoDispose ();
+}
+
 void
 BwmQueueDisc::SetFlowNum (uint32_t flowNum)
 {
-  m_flowNum = flowNum;
+  m_flowTable.Reserve (flowNum);
 }
 
 void
@@ -198,9 +304,33 @@ BwmQueueDisc::SetupLocalAgent (Ptr<BwmLocalAgent> agent)
   m_agent = agent;
 }
 
+void
+BwmQueueDisc::ReleaseQueueDiscClass (Ptr<BwmQueueDiscClass> qDiscClass)
+{
+  NS_LOG_FUNCTION (this << qDiscClass);
+
+  if (m_lastFlow == qDiscClass)
+    {
+      // the cached flow is gone
+      m_lastFlow = 0;
+    }
+
+  if (!m_flowTable.Erase (qDiscClass->GetFlowId (), PeekPointer (qDiscClass)))
+    {
+      NS_LOG_WARN ("Try to release an unknown queue disc class");
+      return;
+    }
+
+  // keep the class for the next new unit flow
+  qDiscClass->SetFlowId (-1);
+  qDiscClass->SetTraceId (-1);
+  m_freeClasses.push_back (qDiscClass);
+}
+
 bool
 BwmQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
 {
+  BwmProfiler::Scope scope (BwmProfiler::QDISC);
   NS_LOG_FUNCTION (this << item);
 
   if (m_agent == NULL)
@@ -216,13 +346,12 @@ BwmQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
       return false;
     }
 
-  uint32_t index = 0;
-
   // extract tenant id from the packet
   TenantIdTag tidTag;
   uint32_t tenantId;
   uint32_t flowId;
   Ipv4Header ipv4H;
+  Ptr<BwmQueueDiscClass> flow = NULL;
   if (!item->GetPacket ()->PeekPacketTag (tidTag))
     {
       NS_LOG_LOGIC ("The item has no tenant id tag!");
@@ -240,104 +369,359 @@ BwmQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
 //      item->GetPacket ()->PeekHeader (ipv4H);
       Ipv4QueueDiscItem* iqdt = dynamic_cast<Ipv4QueueDiscItem*> (GetPointer(item));
       NS_ASSERT (iqdt);
-      ipv4H = iqdt->GetHeader();
+      const Ipv4Header &cachedH = iqdt->GetHeader ();
+      if (m_lastFlow && m_lastTenantId == tenantId && m_lastSrc == cachedH.GetSource () && m_lastDst == cachedH.GetDestination ())
+        {
+          // consecutive items of a flow skip hashing and probing
+          return EnqueueClass (m_lastFlow, item);
+        }
+      ipv4H = cachedH;
       flowId = m_agent->AssignFlowId (tenantId, ipv4H.GetSource (), ipv4H.GetDestination ());
     }
 
-  // assign a queue disc class to the flow
-  index = flowId % m_flowNum;
-
-  // extract trace id
-  FlowIdTag fidTag;
-  item->GetPacket ()->PeekPacketTag (fidTag);
-  uint32_t traceId = fidTag.GetFlowId ();
-
-  Ptr<BwmQueueDiscClass> flow = NULL;
   if (tenantId == (unsigned)-1 && flowId == (unsigned)-1)
     {
       // unclassified item, guide it into the default queue disc class
       NS_LOG_INFO ("Meet an unclassified item " << item);
-      flow = StaticCast<BwmQueueDiscClass> (GetQueueDiscClass (0));
-    }
-
-  while (flow == NULL)
-    {
-      if (m_flowNumIndices.find (index) == m_flowNumIndices.end ())
-      {
-        // create a new queue disc class for the new flow
-        NS_LOG_DEBUG ("Creating a new flow queue with index " << index);
-        flow = m_queueDiscClassFactory.Create<BwmQueueDiscClass> ();
-        Ptr<TbfQueueDisc> qd = m_queueDiscFactory.Create<TbfQueueDisc> ();
-        qd->SetNetDevice(GetNetDevice());
-        qd->Initialize ();
-        qd->SetBwmQdiscClass (flow);
-        flow->SetQueueDisc (qd);
-        AddQueueDiscClass (flow);
-        m_flowNumIndices[index] = GetNQueueDiscClasses () - 1;
-        flow->SetTraceId (traceId);
-        flow->SetFlowId (flowId);
-
-        m_flowCreateTrace (flow);
-
-        // record this new flow in Bwm Data structure
-        auto flowRecord = m_agent->AddNewUnitFlow (tenantId, flowId, traceId, flow, ipv4H.GetSource (), ipv4H.GetDestination ());
-        if (!flowRecord)
-          {
-            NS_LOG_WARN ("Cannot create new unit flow for the item: " << item);
-            NS_ASSERT (0);
-          }
-      }
-    else
-      {
-        // find the corresponding queue disc class
-        flow = StaticCast<BwmQueueDiscClass> (GetQueueDiscClass (m_flowNumIndices[index]));
-        if (flow->GetFlowId () != flowId)// || flow->GetTraceId() != traceId)
-          {
-            // meet collision, use linear probe to handle
-            NS_LOG_INFO ("A hash collision emerges");
-            index = (index + 1) % m_flowNum;
-            flow = NULL;
-          }
-      }
+      flow = m_defaultFlow;
+    }
+  else
+    {
+      // find the corresponding queue disc class
+      flow = m_flowTable.Find (flowId, tenantId);
     }
 
-  bool retval = flow->Enqueue (item);
+  if (flow == NULL)
+    {
+      // extract trace id
+      FlowIdTag fidTag;
+      item->GetPacket ()->PeekPacketTag (fidTag);
+      uint32_t traceId = fidTag.GetFlowId ();
+
+      if (m_freeClasses.empty ())
+        {
+          // create a new queue disc class for the new flow
+          NS_LOG_DEBUG ("Creating a new flow queue for flow " << flowId);
+          flow = CreateQueueDiscClass ();
+          flow->SetTraceId (traceId);
+          flow->SetFlowId (flowId);
+
+          m_flowCreateTrace (flow);
+        }
+      else
+        {
+          // reuse a released queue disc class for the new flow
+          NS_LOG_DEBUG ("Recycling flow queue " << m_freeClasses.front () << " for flow " << flowId);
+          flow = m_freeClasses.front ();
+          m_freeClasses.pop_front ();
+          flow->SetTraceId (traceId);
+          flow->SetFlowId (flowId);
+          // the new unit flow starts a fresh usage epoch
+          flow->SnapshotUsage ();
+        }
+      m_flowTable.Insert (flowId, tenantId, PeekPointer (flow));
+
+      // record this new flow in Bwm Data structure
+      auto flowRecord = m_agent->AddNewUnitFlow (tenantId, flowId, traceId, flow, ipv4H.GetSource (), ipv4H.GetDestination (), this);
+      if (!flowRecord)
+        {
+          NS_LOG_WARN ("Cannot create new unit flow for the item: " << item);
+          NS_ASSERT (0);
+        }
+    }
+
+  if (tenantId != (unsigned)-1)
+    {
+      // remember the flow for its next items
+      m_lastTenantId = tenantId;
+      m_lastSrc = ipv4H.GetSource ();
+      m_lastDst = ipv4H.GetDestination ();
+      m_lastFlow = flow;
+    }
+
+  bool retval = EnqueueClass (flow, item);
   return retval;
 }
 
 Ptr<QueueDiscItem>
 BwmQueueDisc::DoDequeue (void)
 {
+  BwmProfiler::Scope scope (BwmProfiler::QDISC);
   NS_LOG_FUNCTION (this);
 
-  if (m_flowNumIndices.size () == 0)
+  if (m_rateLimiter == CAROUSEL)
     {
-      NS_LOG_LOGIC ("Queue empty");
-      return NULL;
+      return WheelDequeue ();
     }
 
-  auto end = m_nextFlow;
-  uint32_t upperBound = GetNQueueDiscClasses ();
-  Ptr<BwmQueueDiscClass> flow;
-  Ptr<QueueDiscItem> item = NULL;
-  do
+  // serve the active classes round-robin, idle and throttled classes cost nothing
+  while (!m_activeClasses.empty ())
     {
-      flow = StaticCast<BwmQueueDiscClass> (GetQueueDiscClass (m_nextFlow));
-      item = flow->Dequeue ();
-      if (item) 
+      Ptr<BwmQueueDiscClass> flow = m_activeClasses.front ();
+      m_activeClasses.pop_front ();
+      flow->m_state = BwmQueueDiscClass::IDLE;
+
+      Ptr<QueueDiscItem> item = flow->Dequeue ();
+      if (item)
         {
           NS_LOG_LOGIC ("Dequeue a valid item normally");
-          m_nextFlow = (m_nextFlow + 1) % upperBound;
-          break;
+          if (flow->m_state == BwmQueueDiscClass::IDLE && flow->GetNPackets () > 0)
+            {
+              flow->m_state = BwmQueueDiscClass::ACTIVE;
+              m_activeClasses.push_back (flow);
+            }
+          return item;
         }
-      else
+
+      // the class is empty, or it has been parked until it is eligible again
+      NS_LOG_LOGIC ("No item for dequeuing");
+    }
+
+  NS_LOG_LOGIC ("No eligible class");
+  return NULL;
+}
+
+bool
+BwmQueueDisc::EnqueueClass (Ptr<BwmQueueDiscClass> flow, Ptr<QueueDiscItem> item)
+{
+  if (m_rateLimiter == CAROUSEL)
+    {
+      return WheelEnqueue (flow, item);
+    }
+
+  bool retval = flow->Enqueue (item);
+  if (retval && flow->m_state == BwmQueueDiscClass::IDLE)
+    {
+      flow->m_state = BwmQueueDiscClass::ACTIVE;
+      m_activeClasses.push_back (flow);
+    }
+  return retval;
+}
+
+void
+BwmQueueDisc::ThrottleClass (Ptr<BwmQueueDiscClass> flow, Time eligibleTime)
+{
+  NS_LOG_FUNCTION (this << flow << eligibleTime);
+
+  if (flow->m_state == BwmQueueDiscClass::ACTIVE)
+    {
+      // the class will be tried soon and parked again if still blocked
+      return;
+    }
+  if (flow->m_state == BwmQueueDiscClass::THROTTLED)
+    {
+      // the rate changed, re-key the class
+      m_throttledClasses.erase (flow->m_throttledIt);
+    }
+  flow->m_state = BwmQueueDiscClass::THROTTLED;
+  flow->m_throttledIt = m_throttledClasses.insert (std::make_pair (eligibleTime, flow));
+
+  // make the wake event fire for the earliest class
+  if (m_throttledClasses.begin () == flow->m_throttledIt
+      && (!m_wakeEvent.IsRunning () || Simulator::GetDelayLeft (m_wakeEvent) > eligibleTime - Simulator::Now ()))
+    {
+      Simulator::Cancel (m_wakeEvent);
+      m_wakeEvent = Simulator::Schedule (eligibleTime - Simulator::Now (), &BwmQueueDisc::WakeClasses, this);
+    }
+}
+
+void
+BwmQueueDisc::WakeClasses (void)
+{
+  BwmProfiler::Scope scope (BwmProfiler::QDISC);
+  NS_LOG_FUNCTION (this);
+
+  Time now = Simulator::Now ();
+  while (!m_throttledClasses.empty () && m_throttledClasses.begin ()->first <= now)
+    {
+      Ptr<BwmQueueDiscClass> flow = m_throttledClasses.begin ()->second;
+      m_throttledClasses.erase (m_throttledClasses.begin ());
+      flow->m_state = BwmQueueDiscClass::ACTIVE;
+      m_activeClasses.push_back (flow);
+    }
+  if (!m_throttledClasses.empty ())
+    {
+      m_wakeEvent = Simulator::Schedule (m_throttledClasses.begin ()->first - now, &BwmQueueDisc::WakeClasses, this);
+    }
+
+  Run ();
+}
+
+Ptr<BwmQueueDiscClass>
+BwmQueueDisc::CreateQueueDiscClass (void)
+{
+  Ptr<BwmQueueDiscClass> flow = m_queueDiscClassFactory.Create<BwmQueueDiscClass> ();
+  if (m_rateLimiter == CAROUSEL)
+    {
+      // the timing wheel holds the packets, the class only keeps the pacing state
+      m_wheelClasses.push_back (flow);
+      return flow;
+    }
+
+  Ptr<TbfQueueDisc> qd = m_queueDiscFactory.Create<TbfQueueDisc> ();
+  qd->SetNetDevice (GetNetDevice ());
+  qd->Initialize ();
+  qd->SetThrottleCallback (MakeCallback (&BwmQueueDisc::ThrottleClass, this).Bind (flow));
+  flow->SetQueueDisc (qd);
+  AddQueueDiscClass (flow);
+  return flow;
+}
+
+bool
+BwmQueueDisc::WheelEnqueue (Ptr<BwmQueueDiscClass> flow, Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << flow << item);
+
+  Time now = Simulator::Now ();
+  uint64_t nowTick = now.GetTimeStep () / m_wheelGranularity.GetTimeStep ();
+  AdvanceWheel (nowTick);
+
+  // the packet leaves once the previous packets of the flow have been sent at its rate
+  Time departure = std::max (now, flow->m_nextDeparture);
+  uint64_t tick = std::max<uint64_t> (departure.GetTimeStep () / m_wheelGranularity.GetTimeStep (), m_wheelCursor);
+  if (tick - m_wheelCursor >= m_wheel.size ())
+    {
+      DropBeforeEnqueue (item, "Horizon drop");
+      return false;
+    }
+  DataRate rate = flow->GetRate ();
+  if (rate.GetBitRate () > 0)
+    {
+      flow->m_nextDeparture = departure + rate.CalculateBytesTxTime (item->GetSize ());
+    }
+  flow->m_lastActiveTime = now;
+
+  // append the packet to its slot
+  uint32_t entry = m_wheelFreeEntry;
+  if (entry == (uint32_t)-1)
+    {
+      entry = m_wheelEntries.size ();
+      m_wheelEntries.push_back (WheelEntry ());
+    }
+  else
+    {
+      m_wheelFreeEntry = m_wheelEntries[entry].next;
+    }
+  m_wheelEntries[entry].item = item;
+  m_wheelEntries[entry].flow = PeekPointer (flow);
+  m_wheelEntries[entry].next = -1;
+
+  uint32_t index = tick % m_wheel.size ();
+  WheelSlot &slot = m_wheel[index];
+  if (slot.head == (uint32_t)-1)
+    {
+      slot.head = entry;
+      m_wheelBusy[index / 64] |= 1ULL << (index % 64);
+    }
+  else
+    {
+      m_wheelEntries[slot.tail].next = entry;
+    }
+  slot.tail = entry;
+  flow->m_wheelPackets++;
+  m_wheelPackets++;
+  PacketEnqueued (item);
+
+  if (tick > nowTick)
+    {
+      ScheduleWheel (tick);
+    }
+  return true;
+}
+
+Ptr<QueueDiscItem>
+BwmQueueDisc::WheelDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_wheelPackets == 0)
+    {
+      NS_LOG_LOGIC ("The timing wheel is empty");
+      return NULL;
+    }
+
+  uint64_t nowTick = Simulator::Now ().GetTimeStep () / m_wheelGranularity.GetTimeStep ();
+  AdvanceWheel (nowTick);
+  uint32_t distance = FindBusySlot ();
+  if (m_wheelCursor + distance > nowTick)
+    {
+      // wake up when the earliest packet departs
+      NS_LOG_LOGIC ("No packet departs before slot " << m_wheelCursor + distance);
+      ScheduleWheel (m_wheelCursor + distance);
+      return NULL;
+    }
+
+  // pop the head of the earliest due slot
+  m_wheelCursor += distance;
+  uint32_t index = m_wheelCursor % m_wheel.size ();
+  WheelSlot &slot = m_wheel[index];
+  uint32_t entry = slot.head;
+  slot.head = m_wheelEntries[entry].next;
+  if (slot.head == (uint32_t)-1)
+    {
+      m_wheelBusy[index / 64] &= ~(1ULL << (index % 64));
+    }
+
+  Ptr<QueueDiscItem> item = m_wheelEntries[entry].item;
+  m_wheelEntries[entry].flow->m_wheelPackets--;
+  m_wheelEntries[entry].flow->AddUsage (item->GetSize ());
+  m_wheelEntries[entry].item = 0;
+  m_wheelEntries[entry].flow = 0;
+  m_wheelEntries[entry].next = m_wheelFreeEntry;
+  m_wheelFreeEntry = entry;
+  m_wheelPackets--;
+  PacketDequeued (item);
+  return item;
+}
+
+void
+BwmQueueDisc::AdvanceWheel (uint64_t nowTick)
+{
+  if (m_wheelPackets == 0)
+    {
+      m_wheelCursor = nowTick;
+      return;
+    }
+  if (m_wheelCursor < nowTick)
+    {
+      // overdue slots keep the cursor until they are drained
+      m_wheelCursor = std::min (m_wheelCursor + FindBusySlot (), nowTick);
+    }
+}
+
+uint32_t
+BwmQueueDisc::FindBusySlot (void) const
+{
+  uint32_t slots = m_wheel.size ();
+  uint32_t words = m_wheelBusy.size ();
+  uint32_t start = m_wheelCursor % slots;
+  uint32_t word = start / 64;
+  uint64_t bits = m_wheelBusy[word] & (~0ULL << (start % 64));
+
+  // the last round revisits the first word for the slots wrapped before the cursor
+  for (uint32_t i = 0; i <= words; i++)
+    {
+      if (bits != 0)
         {
-          NS_LOG_LOGIC ("No item for dequeuing");
-          m_nextFlow = (m_nextFlow + 1) % upperBound;
+          uint32_t index = word * 64 + __builtin_ctzll (bits);
+          return (index + slots - start) % slots;
         }
-    } while (end != m_nextFlow);
+      word = (word + 1) % words;
+      bits = m_wheelBusy[word];
+    }
+  return slots;
+}
 
-  return item;
+void
+BwmQueueDisc::ScheduleWheel (uint64_t tick)
+{
+  Time wakeTime = TimeStep (tick * m_wheelGranularity.GetTimeStep ());
+  if (m_wheelEvent.IsRunning () && Simulator::Now () + Simulator::GetDelayLeft (m_wheelEvent) <= wakeTime)
+    {
+      return;
+    }
+  Simulator::Cancel (m_wheelEvent);
+  m_wheelEvent = Simulator::Schedule (wakeTime - Simulator::Now (), &QueueDisc::Run, this);
 }
 
 void
@@ -350,14 +734,21 @@ BwmQueueDisc::InitializeParams ()
   m_queueDiscFactory.SetTypeId ("ns3::TbfQueueDisc");
   m_queueDiscFactory.Set ("MaxSize", QueueSizeValue (GetMaxSize ()));
 
+  if (m_rateLimiter == CAROUSEL)
+    {
+      // one slot per granularity up to the horizon, rounded to whole bitmap words
+      uint64_t slots = (m_wheelHorizon.GetTimeStep () + m_wheelGranularity.GetTimeStep () - 1) / m_wheelGranularity.GetTimeStep ();
+      slots = (slots + 63) / 64 * 64;
+      WheelSlot empty = {(uint32_t)-1, (uint32_t)-1};
+      m_wheel.assign (slots, empty);
+      m_wheelBusy.assign (slots / 64, 0);
+      m_wheelCursor = Simulator::Now ().GetTimeStep () / m_wheelGranularity.GetTimeStep ();
+    }
+
   // create the default unlimited queue disc class
-  auto flow = m_queueDiscClassFactory.Create<BwmQueueDiscClass> ();
+  auto flow = CreateQueueDiscClass ();
+  m_defaultFlow = flow;
   auto device = GetNetDevice ();
-  Ptr<TbfQueueDisc> qd = m_queueDiscFactory.Create<TbfQueueDisc> ();
-  qd->SetNetDevice(device);
-  qd->Initialize ();
-  flow->SetQueueDisc (qd);
-  AddQueueDiscClass (flow);
 
   // configure the default unlimited queue disc class
   StringValue rateStr;
@@ -365,8 +756,6 @@ BwmQueueDisc::InitializeParams ()
   DataRate deviceRate(rateStr.Get ());
   DataRate defaultQueueRate(deviceRate.GetBitRate () >> 1);
   flow->SetRate (defaultQueueRate);
-  // construct a mapping from -1 to the default queue disc class
-  m_flowNumIndices[-1] = 0;
 }
 
 bool
@@ -398,8 +787,8 @@ BwmQueueDisc::Drop (void)
     {
       Ptr<BwmQueueDiscClass> flow;
       // random select a subqueue
-      NS_ASSERT (m_flowNumIndices.size () != 0);
-      int randNum = rand () % m_flowNumIndices.size ();
+      NS_ASSERT (GetNQueueDiscClasses () != 0);
+      int randNum = rand () % GetNQueueDiscClasses ();
       flow = StaticCast<BwmQueueDiscClass> (GetQueueDiscClass (randNum));
       NS_ASSERT (flow);
 
@@ -5,6 +5,12 @@
 #include "ns3/queue-disc.h"
 #include "ns3/tbf-queue-disc.h"
 #include "ns3/wfq-queue-disc.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/bwm-flow-table.h"
+
+#include <list>
+#include <map>
+#include <vector>
 
 namespace ns3 {
 
@@ -15,7 +21,9 @@ class BwmLocalAgent;
  *
  * \brief A queue discipline class for a unit flow
  * 
- * This queue disc class uses TBF qdisc as the internal queue disc.
+ * This queue disc class uses TBF qdisc as the internal queue disc, or no
+ * queue disc at all when the packets are paced by the timing wheel of the
+ * BwmQueueDisc.
  */
 class BwmQueueDiscClass : public QueueDiscClass {
 public:
@@ -74,14 +82,37 @@ public:
    */
   uint32_t GetFlowId (void) const;
   /**
-   *  \brief Get the usage of this flow in the last sampling interval.
+   *  \brief Get the usage of this flow since the last snapshot.
    *  \return usage in bits.
    */
   double GetUsage (void) const;
   /**
-   *  \brief Reset the usage to 0.
+   *  \brief Get the usage of the last closed epoch, the value of the Usage trace.
+   *  \return usage in bytes.
+   */
+  double GetEpochUsage (void) const;
+  /**
+   *  \brief Get the time of the last snapshot, the start of the current usage epoch.
+   *  \return the time of the last snapshot or of the creation of the class.
+   */
+  Time GetSnapshotTime (void) const;
+  /**
+   *  \brief Close the current usage epoch.
+   *
+   *  The counters keep running, the snapshot only moves the baseline GetUsage
+   *  is measured from. The Usage trace fires with the bytes of the closed epoch.
+   */
+  void SnapshotUsage (void);
+  /**
+   *  \brief Get the bytes dequeued by this class since it was created.
+   *  \return the byte counter.
    */
-  void ResetUsage (void);
+  uint64_t GetTxBytes (void) const;
+  /**
+   *  \brief Get the packets dequeued by this class since it was created.
+   *  \return the packet counter.
+   */
+  uint64_t GetTxPackets (void) const;
   /**
    * \brief Get the unique trace id of corresponding unit flow.
    * \return m_traceId.
@@ -92,15 +123,46 @@ public:
    */
   void SetTraceId (uint32_t traceId);
   /**
-   * \brief Increase the usage by the size of new packet.
+   * \brief Count a packet leaving the flow.
    */
   void AddUsage (uint32_t pktSize);
+  /**
+   * \brief Get the time when the last packet was passed to the flow.
+   * \return the time of the last enqueue.
+   */
+  Time GetLastActiveTime (void) const;
+  /**
+   * \brief Get the number of packets held for the flow.
+   * \return the packets in the internal queue disc or in the timing wheel.
+   */
+  uint32_t GetNPackets (void) const;
 
 private:
+  friend class BwmQueueDisc;
+
+  /**
+   * \brief Scheduling states of the class in its queue disc
+   */
+  enum SchedulingState
+  {
+    IDLE,      //!< In no scheduling structure of the queue disc
+    ACTIVE,    //!< In the active list of the queue disc
+    THROTTLED  //!< Parked in the throttled classes until the next eligible time
+  };
+
   uint32_t m_flowId; //!< The local id of this flow
   uint32_t m_traceId; //! The id used in tracing, corresponding to the trace id of unit flow
+  Time m_lastActiveTime; //!< The time of the last enqueue
   TracedValue<DataRate> m_rate; //!< The configured rate
-  TracedValue<double> m_usage; //!< The usage in bytes
+  TracedValue<double> m_usage; //!< The usage in bytes of the last closed epoch
+  uint64_t m_txBytes; //!< Bytes dequeued since the class was created
+  uint64_t m_txPackets; //!< Packets dequeued since the class was created
+  uint64_t m_snapshotBytes; //!< m_txBytes at the last snapshot
+  Time m_snapshotTime; //!< The time of the last snapshot
+  SchedulingState m_state; //!< The scheduling state in the queue disc
+  std::multimap<Time, Ptr<BwmQueueDiscClass> >::iterator m_throttledIt; //!< The position in the throttled classes when THROTTLED
+  Time m_nextDeparture; //!< The departure time of the next packet paced by the timing wheel
+  uint32_t m_wheelPackets; //!< The packets of the flow in the timing wheel
 };
 
 /**
@@ -108,10 +170,22 @@ private:
  *
  * \brief A multi-class token bucket queue discipline for BwM project
  * 
- * This qdisc uses BwmQueueDiscClass as its QueueDiscClass
+ * This qdisc uses BwmQueueDiscClass as its QueueDiscClass. The unit flows are
+ * either limited by one TBF child queue disc each, or paced Carousel-style:
+ * every packet gets a departure time from the rate of its flow and waits in
+ * a single timing wheel served by one wake-up event.
  */
 class BwmQueueDisc : public QueueDisc {
 public:
+  /**
+   * \brief The rate limiter of the unit flows
+   */
+  enum RateLimiterType
+  {
+    TBF,      //!< A TBF child queue disc per unit flow
+    CAROUSEL  //!< Departure timestamps in a shared timing wheel
+  };
+
   /**
    * \brief Get the type ID.
    * \return the object TypeId
@@ -130,10 +204,20 @@ public:
   void SetupLocalAgent (Ptr<BwmLocalAgent> agent);
 
   /**
-   * \brief Set the number of flow queues
+   * \brief Set the number of flows the flow table holds before it grows
    */
   void SetFlowNum (uint32_t flowNum);
 
+  /**
+   * \brief Detach a queue disc class from its unit flow and keep it for reuse.
+   *
+   * The class should be empty. It will be assigned to the next new unit flow.
+   */
+  void ReleaseQueueDiscClass (Ptr<BwmQueueDiscClass> qDiscClass);
+
+protected:
+  virtual void DoDispose (void);
+
 private:
   virtual bool DoEnqueue (Ptr<QueueDiscItem> item);
   virtual Ptr<QueueDiscItem> DoDequeue (void);
@@ -144,12 +228,95 @@ private:
    * \brief Drop packets to ensure queue limit
    */
   void Drop (void);
+  /**
+   * \brief Pass an item to a class and activate the class if it was idle
+   * \return true if the class accepted the item
+   */
+  bool EnqueueClass (Ptr<BwmQueueDiscClass> flow, Ptr<QueueDiscItem> item);
+  /**
+   * \brief Park a class that is blocked by its token buckets
+   * \param flow the blocked class
+   * \param eligibleTime the time the head packet of the class can be dequeued
+   */
+  void ThrottleClass (Ptr<BwmQueueDiscClass> flow, Time eligibleTime);
+  /**
+   * \brief Move the classes that became eligible back to the active list and run the queue disc
+   */
+  void WakeClasses (void);
+  /**
+   * \brief Create the queue disc class of a unit flow
+   * \return the new class
+   */
+  Ptr<BwmQueueDiscClass> CreateQueueDiscClass (void);
+  /**
+   * \brief Timestamp an item with the departure time of its flow and put it into the timing wheel
+   * \return true if the item departs within the wheel horizon
+   */
+  bool WheelEnqueue (Ptr<BwmQueueDiscClass> flow, Ptr<QueueDiscItem> item);
+  /**
+   * \brief Take the next item whose departure time has come from the timing wheel
+   * \return the item, or NULL if no item is due
+   */
+  Ptr<QueueDiscItem> WheelDequeue (void);
+  /**
+   * \brief Move the wheel cursor to the earliest busy slot, or to the current slot if none is earlier
+   * \param nowTick the slot of the current time
+   */
+  void AdvanceWheel (uint64_t nowTick);
+  /**
+   * \brief Find the first busy slot from the wheel cursor
+   * \return the distance from the cursor, or the number of slots if the wheel is empty
+   */
+  uint32_t FindBusySlot (void) const;
+  /**
+   * \brief Make the wake-up event of the wheel fire no later than a slot
+   * \param tick the slot
+   */
+  void ScheduleWheel (uint64_t tick);
 
   Ptr<BwmLocalAgent> m_agent; //!< The pointer recording the local agent that controls this Bwm Queue Disc
 
-  std::map<uint32_t, uint32_t> m_flowNumIndices; //!< The mapping from
-  uint32_t m_flowNum; //!< The maximum number of QueueDiscClass
-  uint32_t m_nextFlow; //!< The index of the flow that is about dequeue an item
+  BwmFlowTable m_flowTable; //!< The mapping from unit flows to queue disc classes
+  std::list<Ptr<BwmQueueDiscClass> > m_freeClasses; //!< Released queue disc classes that can be reused
+  uint32_t m_lastTenantId; //!< Tenant id of the most recently classified item
+  Ipv4Address m_lastSrc; //!< Source address of the most recently classified item
+  Ipv4Address m_lastDst; //!< Destination address of the most recently classified item
+  Ptr<BwmQueueDiscClass> m_lastFlow; //!< Class of the most recently classified item, NULL if invalid
+  std::list<Ptr<BwmQueueDiscClass> > m_activeClasses; //!< Backlogged classes with enough tokens, in round-robin order
+  std::multimap<Time, Ptr<BwmQueueDiscClass> > m_throttledClasses; //!< Blocked classes keyed by their next eligible time
+  EventId m_wakeEvent; //!< The event waking the earliest throttled class
+  Ptr<BwmQueueDiscClass> m_defaultFlow; //!< The class of the unclassified items
+
+  /**
+   * \brief A packet waiting in the timing wheel
+   */
+  struct WheelEntry
+  {
+    Ptr<QueueDiscItem> item; //!< The packet
+    BwmQueueDiscClass *flow; //!< The class of the packet
+    uint32_t next; //!< The next entry in the same slot or the free list
+  };
+
+  /**
+   * \brief A slot of the timing wheel, a FIFO list of entries
+   */
+  struct WheelSlot
+  {
+    uint32_t head; //!< The first entry
+    uint32_t tail; //!< The last entry
+  };
+
+  RateLimiterType m_rateLimiter; //!< The rate limiter of the unit flows
+  Time m_wheelGranularity; //!< The time covered by a slot of the timing wheel
+  Time m_wheelHorizon; //!< The farthest departure time the timing wheel accepts
+  std::vector<Ptr<BwmQueueDiscClass> > m_wheelClasses; //!< The classes paced by the timing wheel
+  std::vector<WheelSlot> m_wheel; //!< The slots of the timing wheel
+  std::vector<uint64_t> m_wheelBusy; //!< Bitmap of the slots holding entries
+  std::vector<WheelEntry> m_wheelEntries; //!< The entry pool of the timing wheel
+  uint32_t m_wheelFreeEntry; //!< The first free entry in the pool
+  uint64_t m_wheelCursor; //!< The earliest slot that may hold entries, in absolute ticks
+  uint32_t m_wheelPackets; //!< The packets in the timing wheel
+  EventId m_wheelEvent; //!< The wake-up event of the timing wheel
 
   TracedCallback<Ptr<BwmQueueDiscClass> > m_flowCreateTrace; //!< Trace of creating internal queue disc class
 
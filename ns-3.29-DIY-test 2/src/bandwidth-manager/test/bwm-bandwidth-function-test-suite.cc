@@ -0,0 +1,76 @@
+#include "ns3/test.h"
+#include "ns3/bandwidth-function.h"
+
+#include <limits>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Looks up the linear segments of a bandwidth function
+ */
+class BwmBandwidthFunctionSegmentTestCase : public TestCase
+{
+public:
+  BwmBandwidthFunctionSegmentTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmBandwidthFunctionSegmentTestCase::BwmBandwidthFunctionSegmentTestCase ()
+  : TestCase ("Get the segment of finite and infinite fair shares")
+{
+}
+
+void
+BwmBandwidthFunctionSegmentTestCase::DoRun (void)
+{
+  // 5 Mbps per unit of fair share up to 10, then 3 Mbps per unit up to 20, flat behind
+  Ptr<BandwidthFunction> function = CreateObject<BandwidthFunction> ();
+  function->AddVertex (10, 50000000);
+  function->AddVertex (20, 80000000);
+
+  double start, end, bandwidth, slope;
+  function->GetSegment (0, start, end, bandwidth, slope);
+  NS_TEST_ASSERT_MSG_EQ (start, 0, "The first segment starts at the origin");
+  NS_TEST_ASSERT_MSG_EQ (end, 10, "The first segment ends at the first vertex");
+  NS_TEST_ASSERT_MSG_EQ (bandwidth, 0, "The first segment starts at no bandwidth");
+  NS_TEST_ASSERT_MSG_EQ (slope, 5000000, "The first segment rises by 5 Mbps per unit");
+
+  function->GetSegment (15, start, end, bandwidth, slope);
+  NS_TEST_ASSERT_MSG_EQ (start, 10, "A fair share inside the second segment");
+  NS_TEST_ASSERT_MSG_EQ (end, 20, "The second segment ends at the last vertex");
+  NS_TEST_ASSERT_MSG_EQ (bandwidth + (15 - start) * slope, function->GetBandwidth (15), "The segment agrees with GetBandwidth");
+
+  function->GetSegment (20, start, end, bandwidth, slope);
+  NS_TEST_ASSERT_MSG_EQ (start, 20, "A vertex starts its segment");
+  NS_TEST_ASSERT_MSG_EQ (end, std::numeric_limits<double>::infinity (), "The last segment is open");
+  NS_TEST_ASSERT_MSG_EQ (slope, 0, "The last segment is flat");
+
+  // the infinite fair share gets the upper bound, and its segment holds no finite fair share
+  function->GetSegment (BandwidthFunction::INF, start, end, bandwidth, slope);
+  NS_TEST_ASSERT_MSG_EQ (bandwidth + (BandwidthFunction::INF - start) * slope,
+                         function->GetBandwidth (BandwidthFunction::INF), "INF maps to the upper bound");
+  NS_TEST_ASSERT_MSG_EQ (bandwidth, 80000000, "The upper bound is the bandwidth of the last vertex");
+  NS_TEST_ASSERT_MSG_EQ ((BandwidthFunction::INF >= start && BandwidthFunction::INF < end), true, "INF lies in its segment");
+  NS_TEST_ASSERT_MSG_EQ ((0 >= start && 0 < end), false, "No finite fair share lies in the segment of INF");
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BandwidthFunction test suite
+ */
+static class BwmBandwidthFunctionTestSuite : public TestSuite
+{
+public:
+  BwmBandwidthFunctionTestSuite ()
+    : TestSuite ("bwm-bandwidth-function", UNIT)
+  {
+    AddTestCase (new BwmBandwidthFunctionSegmentTestCase (), TestCase::QUICK);
+  }
+} g_bwmBandwidthFunctionTestSuite; ///< the test suite
@@ -0,0 +1,211 @@
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "ns3/bwm-control-header.h"
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Usage reports survive the wire, quantized to USAGE_QUANTUM
+ */
+class BwmUsageReportHeaderTestCase : public TestCase
+{
+public:
+  BwmUsageReportHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmUsageReportHeaderTestCase::BwmUsageReportHeaderTestCase ()
+  : TestCase ("Serialize and deserialize usage report segments")
+{
+}
+
+void
+BwmUsageReportHeaderTestCase::DoRun (void)
+{
+  // usages are rounded to the nearest quantum, negative ones are clamped to zero
+  // and those beyond 32 bits of quanta saturate
+  double usages[] = {0, 1499, 1500, 123456789, -5000, 1e20};
+  double quantized[] = {0, 1000, 2000, 123457000, 0,
+                        (double)std::numeric_limits<uint32_t>::max () * BwmUsageReportHeader::USAGE_QUANTUM};
+  uint32_t recordNum = sizeof (usages) / sizeof (usages[0]);
+
+  BwmUsageReportHeader header;
+  header.SetHostId (7);
+  header.SetReportId (0xfffffffe);
+  header.SetSegment (2, 3);
+  header.SetReplyRequested (false);
+  for (uint32_t i = 0; i < recordNum; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (header.AddRecord (i + 1, 0xfffffff0 + i, usages[i]), true, "Record " << i << " is added");
+    }
+  NS_TEST_ASSERT_MSG_EQ (header.GetSerializedSize (),
+                         16 + BwmUsageReportHeader::RECORD_SIZE * recordNum, "A record takes 12 bytes");
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  BwmUsageReportHeader received;
+  uint32_t read = packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (read, header.GetSerializedSize (), "The whole header is read");
+  NS_TEST_ASSERT_MSG_EQ (received.GetHostId (), 7, "The host id is received");
+  NS_TEST_ASSERT_MSG_EQ (received.GetReportId (), 0xfffffffe, "The report id is received");
+  NS_TEST_ASSERT_MSG_EQ (received.GetSegmentIndex (), 2, "The segment index is received");
+  NS_TEST_ASSERT_MSG_EQ (received.GetSegmentCount (), 3, "The segment count is received");
+  NS_TEST_ASSERT_MSG_EQ (received.IsReplyRequested (), false, "The reply flag is received");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNRecords (), recordNum, "Every record is received");
+  for (uint32_t i = 0; i < recordNum; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (received.GetTenantId (i), i + 1, "Record " << i << " keeps its tenant id");
+      NS_TEST_ASSERT_MSG_EQ (received.GetFlowId (i), 0xfffffff0 + i, "Record " << i << " keeps its flow id");
+      double usage = received.GetUsage (i);
+      NS_TEST_ASSERT_MSG_EQ (usage, quantized[i], "Record " << i << " carries the quantized usage");
+    }
+
+  // a report of more records than fit into one packet is split into full segments,
+  // each fits into a 1500 bytes packet with its IP and UDP headers
+  uint32_t flowNum = 2 * BwmUsageReportHeader::MAX_RECORDS + 1;
+  uint32_t segmentNum = (flowNum + BwmUsageReportHeader::MAX_RECORDS - 1) / BwmUsageReportHeader::MAX_RECORDS;
+  std::vector<Ptr<Packet> > segments;
+  uint32_t flow = 0;
+  for (uint32_t segment = 0; segment < segmentNum; segment++)
+    {
+      BwmUsageReportHeader part;
+      part.SetReportId (1);
+      part.SetSegment (segment, segmentNum);
+      while (flow < flowNum && part.AddRecord (1, flow, flow * BwmUsageReportHeader::USAGE_QUANTUM))
+        {
+          flow++;
+        }
+      NS_TEST_ASSERT_MSG_LT_OR_EQ (part.GetSerializedSize () + 28, 1500, "Segment " << segment << " fits into the MTU");
+      segments.push_back (Create<Packet> ());
+      segments.back ()->AddHeader (part);
+    }
+  NS_TEST_ASSERT_MSG_EQ (flow, flowNum, "Every record has a segment");
+  NS_TEST_ASSERT_MSG_EQ (segments.size (), 3, "Two full segments and a partial one");
+
+  // the receiver puts the records back together in any order
+  flow = 0;
+  for (int32_t segment = segmentNum - 1; segment >= 0; segment--)
+    {
+      BwmUsageReportHeader part;
+      segments[segment]->RemoveHeader (part);
+      NS_TEST_ASSERT_MSG_EQ (part.GetSegmentIndex (), segment, "Segment " << segment << " keeps its index");
+      NS_TEST_ASSERT_MSG_EQ (part.GetSegmentCount (), segmentNum, "Segment " << segment << " keeps the count");
+      uint32_t expectedNum = segment == (int32_t)segmentNum - 1 ? 1 : BwmUsageReportHeader::MAX_RECORDS;
+      NS_TEST_ASSERT_MSG_EQ (part.GetNRecords (), expectedNum, "Records of segment " << segment);
+      for (uint32_t i = 0; i < part.GetNRecords (); i++)
+        {
+          uint32_t flowId = part.GetFlowId (i);
+          NS_TEST_ASSERT_MSG_EQ (flowId, segment * BwmUsageReportHeader::MAX_RECORDS + i, "Record " << i << " of segment " << segment);
+          double usage = part.GetUsage (i);
+          NS_TEST_ASSERT_MSG_EQ (usage, flowId * BwmUsageReportHeader::USAGE_QUANTUM, "Usage of flow " << flowId);
+          flow++;
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (flow, flowNum, "Every record is received");
+
+  BwmUsageReportHeader full;
+  for (uint32_t i = 0; i < BwmUsageReportHeader::MAX_RECORDS; i++)
+    {
+      full.AddRecord (1, i, 0);
+    }
+  NS_TEST_ASSERT_MSG_EQ (full.AddRecord (1, 0, 0), false, "A full header rejects records");
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Congestion factors survive the wire bit for bit
+ */
+class BwmCongestionFeedbackHeaderTestCase : public TestCase
+{
+public:
+  BwmCongestionFeedbackHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmCongestionFeedbackHeaderTestCase::BwmCongestionFeedbackHeaderTestCase ()
+  : TestCase ("Serialize and deserialize congestion feedback records")
+{
+}
+
+void
+BwmCongestionFeedbackHeaderTestCase::DoRun (void)
+{
+  float factors[] = {0.0f, 1.0f, 1.0f / 3, 1e-30f, 0.999999f, std::numeric_limits<float>::denorm_min ()};
+  uint32_t recordNum = sizeof (factors) / sizeof (factors[0]);
+
+  BwmCongestionFeedbackHeader header;
+  for (uint32_t i = 0; i < recordNum; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (header.AddRecord (0xfffffff0 + i, factors[i]), true, "Record " << i << " is added");
+    }
+  NS_TEST_ASSERT_MSG_EQ (header.GetSerializedSize (),
+                         2 + BwmCongestionFeedbackHeader::RECORD_SIZE * recordNum, "A record takes 8 bytes");
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), header.GetSerializedSize (), "The packet only carries the header");
+
+  BwmCongestionFeedbackHeader received;
+  uint32_t read = packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (read, header.GetSerializedSize (), "The whole header is read");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNRecords (), recordNum, "Every record is received");
+  for (uint32_t i = 0; i < recordNum; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (received.GetTraceId (i), 0xfffffff0 + i, "Record " << i << " keeps its trace id");
+      float factor = received.GetFactor (i);
+      NS_TEST_ASSERT_MSG_EQ (std::memcmp (&factor, &factors[i], sizeof (float)), 0, "Record " << i << " keeps the bits of its factor");
+    }
+
+  // a full header fits into a 1500 bytes packet with its IP header
+  BwmCongestionFeedbackHeader full;
+  for (uint32_t i = 0; i < BwmCongestionFeedbackHeader::MAX_RECORDS; i++)
+    {
+      full.AddRecord (i, 0.5f);
+    }
+  NS_TEST_ASSERT_MSG_EQ (full.AddRecord (0, 0.5f), false, "A full header rejects records");
+  NS_TEST_ASSERT_MSG_LT_OR_EQ (full.GetSerializedSize () + 20, 1500, "A full header fits into the MTU");
+  packet = Create<Packet> ();
+  packet->AddHeader (full);
+  BwmCongestionFeedbackHeader receivedFull;
+  packet->RemoveHeader (receivedFull);
+  NS_TEST_ASSERT_MSG_EQ (receivedFull.GetNRecords (), BwmCongestionFeedbackHeader::MAX_RECORDS, "A full header is received");
+  NS_TEST_ASSERT_MSG_EQ (receivedFull.GetTraceId (BwmCongestionFeedbackHeader::MAX_RECORDS - 1),
+                         BwmCongestionFeedbackHeader::MAX_RECORDS - 1, "The last record is received");
+
+  // an empty header is two bytes on the wire
+  packet = Create<Packet> ();
+  packet->AddHeader (BwmCongestionFeedbackHeader ());
+  BwmCongestionFeedbackHeader receivedEmpty;
+  NS_TEST_ASSERT_MSG_EQ (packet->RemoveHeader (receivedEmpty), 2, "An empty header is its record count");
+  NS_TEST_ASSERT_MSG_EQ (receivedEmpty.GetNRecords (), 0, "An empty header has no record");
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Bandwidth manager control header test suite
+ */
+static class BwmControlHeaderTestSuite : public TestSuite
+{
+public:
+  BwmControlHeaderTestSuite ()
+    : TestSuite ("bwm-control-header", UNIT)
+  {
+    AddTestCase (new BwmUsageReportHeaderTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmCongestionFeedbackHeaderTestCase (), TestCase::QUICK);
+  }
+} g_bwmControlHeaderTestSuite; ///< the test suite
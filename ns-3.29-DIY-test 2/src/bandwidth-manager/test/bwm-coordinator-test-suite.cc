@@ -0,0 +1,487 @@
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/node-container.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/enum.h"
+#include "ns3/string.h"
+#include "ns3/arp-l3-protocol.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/bwm-control-header.h"
+#include "ns3/bandwidth-function.h"
+#include "ns3/bwm-coordinator.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Water-fills three hosts behind a switch, checked against a hand computation
+ *
+ * Hosts 0, 1 and 2 hang off switch 3 by links of 10, 10 and 6 Mbps. The
+ * unit flows and their transformed functions, linear up to the vertex:
+ *
+ *   flow 1: host 0 -> host 2, 1 Mbps per unit of fair share up to (100, 100 Mbps)
+ *   flow 2: host 1 -> host 2, 2 Mbps per unit up to (100, 200 Mbps)
+ *   flow 3: host 0 -> host 1, 1 Mbps per unit up to (100, 100 Mbps)
+ *   flow 4: host 2 -> an address outside the topology, 0.1 Mbps per unit up to (50, 5 Mbps)
+ *
+ * The link from the switch to host 2 carries 3 Mbps per unit and saturates
+ * first, at level 2: flow 1 gets 2 Mbps and flow 2 gets 4 Mbps. Flow 3 then
+ * has 8 Mbps left on the link from host 0 and saturates it at level 8.
+ * No link limits flow 4, it gets the end of its function.
+ */
+class BwmCoordinatorWaterFillingTestCase : public TestCase
+{
+public:
+  BwmCoordinatorWaterFillingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmCoordinatorWaterFillingTestCase::BwmCoordinatorWaterFillingTestCase ()
+  : TestCase ("Water-fill unit flows over a star topology")
+{
+}
+
+void
+BwmCoordinatorWaterFillingTestCase::DoRun (void)
+{
+  NodeContainer hosts;
+  hosts.Create (3);
+  NodeContainer sw;
+  sw.Create (1);
+  InternetStackHelper internet;
+  internet.Install (hosts);
+  internet.Install (sw);
+  SimpleNetDeviceHelper simple;
+  Ipv4AddressHelper ipv4 ("10.1.0.0", "255.255.255.0");
+  Ipv4Address addresses[3];
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      addresses[i] = ipv4.Assign (simple.Install (NodeContainer (hosts.Get (i), sw.Get (0)))).GetAddress (0);
+      ipv4.NewNetwork ();
+    }
+
+  std::string tenantFile = CreateTempDirFilename ("bwm-coordinator-tenants.txt");
+  std::ofstream fout (tenantFile);
+  fout << "1\n10,50000000 20,80000000\n0,1\n";
+  fout.close ();
+  Ptr<BwmCoordinator> coordinator = CreateObject<BwmCoordinator> ();
+  coordinator->SetAttribute ("Allocator", EnumValue (BwmCoordinator::WATER_FILLING));
+  coordinator->SetAttribute ("UpdateMode", EnumValue (BwmCoordinator::EPOCH));
+  sw.Get (0)->AddApplication (coordinator);
+  coordinator->InputConfiguration (tenantFile);
+  double capacities[] = {10000000, 10000000, 6000000};
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      coordinator->AddLink (hosts.Get (i)->GetId (), sw.Get (0)->GetId (), capacities[i]);
+    }
+
+  uint32_t srcs[] = {0, 1, 0, 2};
+  Ipv4Address dsts[] = {addresses[2], addresses[2], addresses[1], Ipv4Address ("10.9.9.9")};
+  double vertices[][2] = {{100, 100000000}, {100, 200000000}, {100, 100000000}, {50, 5000000}};
+  Ptr<UnitFlow> flows[4];
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      std::ostringstream info;
+      info << addresses[srcs[i]].Get () << " " << dsts[i].Get () << " " << 10000000;
+      flows[i] = coordinator->RegisterFlow (1, 100 + i, 1 + i, info.str ());
+      NS_TEST_ASSERT_MSG_NE (flows[i], 0, "Flow " << i + 1 << " is registered");
+    }
+  // the functions are set once all flows joined the tenant, no later transform replaces them
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      Ptr<BandwidthFunction> function = CreateObject<BandwidthFunction> ();
+      function->AddVertex (vertices[i][0], vertices[i][1]);
+      flows[i]->SetTransformedBF (function);
+    }
+
+  std::vector<BwmCoordinator::Allocation> allocations;
+  double level = coordinator->ComputeWaterFilling (allocations);
+  double fairShares[] = {2, 2, 8, 50};
+  double rates[] = {2000000, 4000000, 8000000, 5000000};
+  NS_TEST_ASSERT_MSG_EQ_TOL (level, 8, 1e-9, "The last link saturates at level 8");
+  NS_TEST_ASSERT_MSG_EQ (allocations.size (), 4, "Every unit flow is allocated");
+  for (uint32_t i = 0; i < allocations.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (allocations[i].flow, flows[i], "The allocations are in trace id order");
+      NS_TEST_ASSERT_MSG_EQ_TOL (allocations[i].fairShare, fairShares[i], 1e-9, "Fair share of flow " << i + 1);
+      NS_TEST_ASSERT_MSG_EQ_TOL (allocations[i].rate, rates[i], 1e-3, "Rate of flow " << i + 1);
+      NS_TEST_ASSERT_MSG_LT (flows[i]->GetPinnedFS (), 0, "Computing the allocation pins nothing");
+    }
+
+  // the epoch estimation allocates the same fair shares and pins them
+  Simulator::Stop (MilliSeconds (6));
+  Simulator::Run ();
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ_TOL (flows[i]->GetPinnedFS (), fairShares[i], 1e-9, "Pinned fair share of flow " << i + 1);
+    }
+
+  coordinator->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief The transformed functions of a tenant's unit flows add up to the tenant function
+ *
+ * The tenant gets 5 Mbps per unit of fair share up to 10, then 3 Mbps per
+ * unit up to 20. The unit flows split it in proportion to their configured
+ * functions, which stay linear over the whole range.
+ */
+class BwmCoordinatorTransformTestCase : public TestCase
+{
+public:
+  BwmCoordinatorTransformTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Add a unit flow with a linear configured function to the tenant
+   * \param tenant the tenant
+   * \param flowId the flow id, also used as the trace id
+   * \param bandwidth the bandwidth of the function at fair share 100
+   * \returns the unit flow
+   */
+  Ptr<UnitFlow> AddFlow (Ptr<Tenant> tenant, uint32_t flowId, double bandwidth);
+  /**
+   * Check that the transformed functions sum up to the tenant function
+   * \param tenant the tenant
+   * \param flows the unit flows of the tenant
+   * \param bandwidths the bandwidths of their configured functions at fair share 100
+   */
+  void CheckSum (Ptr<Tenant> tenant, const std::vector<Ptr<UnitFlow> > &flows,
+                 const std::vector<double> &bandwidths);
+};
+
+BwmCoordinatorTransformTestCase::BwmCoordinatorTransformTestCase ()
+  : TestCase ("Transform the functions of unit flows as they join and leave")
+{
+}
+
+Ptr<UnitFlow>
+BwmCoordinatorTransformTestCase::AddFlow (Ptr<Tenant> tenant, uint32_t flowId, double bandwidth)
+{
+  Ptr<UnitFlow> flow = CreateObject<UnitFlow> ();
+  flow->SetTenantId (tenant->GetTenantId ());
+  flow->SetFlowId (flowId);
+  flow->SetTraceId (flowId);
+  Ptr<BandwidthFunction> function = CreateObject<BandwidthFunction> ();
+  function->AddVertex (100, bandwidth);
+  flow->SetConfiguredBF (function);
+  tenant->AddUnitFlow (flow);
+  return flow;
+}
+
+void
+BwmCoordinatorTransformTestCase::CheckSum (Ptr<Tenant> tenant, const std::vector<Ptr<UnitFlow> > &flows,
+                                           const std::vector<double> &bandwidths)
+{
+  double total = 0;
+  for (double bandwidth : bandwidths)
+    {
+      total += bandwidth;
+    }
+  double fairShares[] = {0, 5, 10, 15, 20, 30};
+  for (double fairShare : fairShares)
+    {
+      double expected = tenant->GetBF ()->GetBandwidth (fairShare);
+      double sum = 0;
+      for (uint32_t i = 0; i < flows.size (); i++)
+        {
+          Ptr<BandwidthFunction> transformed = flows[i]->GetTransformedBF ();
+          NS_TEST_ASSERT_MSG_NE (transformed, 0, "Flow " << flows[i]->GetFlowId () << " is transformed");
+          double bandwidth = transformed->GetBandwidth (fairShare);
+          NS_TEST_ASSERT_MSG_EQ_TOL (bandwidth, expected * bandwidths[i] / total, 1,
+                                     "Share of flow " << flows[i]->GetFlowId () << " at fair share " << fairShare);
+          sum += bandwidth;
+        }
+      NS_TEST_ASSERT_MSG_EQ_TOL (sum, expected, 1, "The flows add up to the tenant at fair share " << fairShare);
+    }
+}
+
+void
+BwmCoordinatorTransformTestCase::DoRun (void)
+{
+  Ptr<Tenant> tenant = CreateObject<Tenant> ();
+  tenant->SetTenantId (1);
+  tenant->SetBF ("10,50000000 20,80000000");
+
+  std::vector<Ptr<UnitFlow> > flows;
+  std::vector<double> bandwidths;
+  flows.push_back (AddFlow (tenant, 1, 100000000));
+  bandwidths.push_back (100000000);
+  flows.push_back (AddFlow (tenant, 2, 200000000));
+  bandwidths.push_back (200000000);
+  tenant->TransformComponentialBF ();
+  CheckSum (tenant, flows, bandwidths);
+
+  // a joining flow changes the aggregate, so every flow gets a new function
+  Ptr<BandwidthFunction> first = flows[0]->GetTransformedBF ();
+  flows.push_back (AddFlow (tenant, 3, 100000000));
+  bandwidths.push_back (100000000);
+  tenant->TransformComponentialBF ();
+  NS_TEST_ASSERT_MSG_NE (flows[0]->GetTransformedBF (), first, "The first flow is transformed again");
+  CheckSum (tenant, flows, bandwidths);
+
+  // a leaving flow hands its share back to the others
+  tenant->RemoveUnitFlow (flows[1]);
+  flows.erase (flows.begin () + 1);
+  bandwidths.erase (bandwidths.begin () + 1);
+  tenant->TransformComponentialBF ();
+  CheckSum (tenant, flows, bandwidths);
+
+  // transforming an unchanged tenant hands over nothing
+  first = flows[0]->GetTransformedBF ();
+  tenant->TransformComponentialBF ();
+  NS_TEST_ASSERT_MSG_EQ (flows[0]->GetTransformedBF (), first, "An unchanged flow keeps its function");
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Reconfiguring host weights only configures the unit flows of those hosts again
+ *
+ * The tenant weighs host 1 with 2, every other host with 1. A configured
+ * function reaches the device rate limit at the rate limit divided by the
+ * summed weights of the end hosts.
+ */
+class BwmCoordinatorReconfigureTestCase : public TestCase
+{
+public:
+  BwmCoordinatorReconfigureTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmCoordinatorReconfigureTestCase::BwmCoordinatorReconfigureTestCase ()
+  : TestCase ("Reconfigure the unit flows touching hosts with new weights")
+{
+}
+
+void
+BwmCoordinatorReconfigureTestCase::DoRun (void)
+{
+  std::string tenantFile = CreateTempDirFilename ("bwm-coordinator-tenants.txt");
+  std::ofstream fout (tenantFile);
+  fout << "1\n10,50000000 20,80000000\n0,1 1,2\n";
+  fout.close ();
+  Ptr<BwmCoordinator> coordinator = CreateObject<BwmCoordinator> ();
+  coordinator->InputConfiguration (tenantFile);
+
+  // the hosts are not registered, the end hosts are set on the unit flows directly
+  uint32_t ends[][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 0}, {0, 2}};
+  double rateLimit = 12000000;
+  Ptr<UnitFlow> flows[5];
+  Ptr<BandwidthFunction> configured[5];
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      std::ostringstream info;
+      info << 0 << " " << 0 << " " << rateLimit;
+      flows[i] = coordinator->RegisterFlow (1, 100 + i, 1 + i, info.str ());
+      NS_TEST_ASSERT_MSG_NE (flows[i], 0, "Flow " << i + 1 << " is registered");
+      flows[i]->SetEndHosts (ends[i][0], ends[i][1], rateLimit);
+      configured[i] = flows[i]->GetConfiguredBF ();
+      NS_TEST_ASSERT_MSG_EQ (flows[i]->IsTransformPending (), false, "Flow " << i + 1 << " is transformed");
+    }
+
+  // host 1 keeps its weight, only host 3 changes
+  coordinator->ReconfigureTenant (1, "", "1,2 3,4");
+  bool touched[] = {false, false, true, true, false};
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      if (touched[i])
+        {
+          NS_TEST_ASSERT_MSG_NE (flows[i]->GetConfiguredBF (), configured[i], "Flow " << i + 1 << " is configured again");
+          double weights = (ends[i][0] == 3 ? 4 : 1) + (ends[i][1] == 3 ? 4 : 1);
+          Ptr<BandwidthFunction> function = flows[i]->GetConfiguredBF ();
+          double vertex = function->GetVertex (function->GetNVertices () - 1).first;
+          NS_TEST_ASSERT_MSG_EQ_TOL (vertex, rateLimit / weights, 1e-6, "Flow " << i + 1 << " uses the new weight");
+        }
+      else
+        {
+          NS_TEST_ASSERT_MSG_EQ (flows[i]->GetConfiguredBF (), configured[i], "Flow " << i + 1 << " is left alone");
+        }
+      NS_TEST_ASSERT_MSG_EQ (flows[i]->IsTransformPending (), false, "Flow " << i + 1 << " is transformed again");
+      configured[i] = flows[i]->GetConfiguredBF ();
+    }
+
+  // a new tenant function or unchanged weights configure no unit flow again
+  coordinator->ReconfigureTenant (1, "10,60000000", "0,1 3,4");
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (flows[i]->GetConfiguredBF (), configured[i], "Flow " << i + 1 << " keeps its function");
+    }
+
+  coordinator->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief The coordinator replies once per usage report received over UDP
+ *
+ * A host sends report segments by hand, out of order, twice, or with a
+ * newer report overtaking an incomplete one. The coordinator replies once
+ * a report is complete and ignores the segments of reports it is done with.
+ */
+class BwmCoordinatorReportTestCase : public TestCase
+{
+public:
+  BwmCoordinatorReportTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Record the number of replies so far and send one report segment
+   * \param reportId the id of the report
+   * \param index the index of the segment
+   * \param count the number of segments of the report
+   * \param usage the usage of flow 100 carried by the segment, negative for none
+   */
+  void SendSegment (uint32_t reportId, uint16_t index, uint16_t count, double usage);
+  /**
+   * Count a target status reply
+   * \param socket the socket of the host
+   */
+  void HandleStatus (Ptr<Socket> socket);
+
+  Ptr<Socket> m_socket;               //!< The socket of the host
+  InetSocketAddress m_coordinatorAddr; //!< The report address of the coordinator
+  uint32_t m_replies;                 //!< The number of replies received
+  std::vector<uint32_t> m_repliesBefore; //!< The number of replies before each segment is sent
+};
+
+BwmCoordinatorReportTestCase::BwmCoordinatorReportTestCase ()
+  : TestCase ("Reply once per usage report over UDP"),
+    m_coordinatorAddr (Ipv4Address::GetAny (), 0),
+    m_replies (0)
+{
+}
+
+void
+BwmCoordinatorReportTestCase::SendSegment (uint32_t reportId, uint16_t index, uint16_t count, double usage)
+{
+  m_repliesBefore.push_back (m_replies);
+  BwmUsageReportHeader header;
+  header.SetHostId (0);
+  header.SetReportId (reportId);
+  header.SetSegment (index, count);
+  header.SetReplyRequested (true);
+  if (usage >= 0)
+    {
+      header.AddRecord (1, 100, usage);
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  m_socket->SendTo (packet, 0, m_coordinatorAddr);
+}
+
+void
+BwmCoordinatorReportTestCase::HandleStatus (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      BwmTargetStatusHeader header;
+      packet->RemoveHeader (header);
+      m_replies++;
+    }
+}
+
+void
+BwmCoordinatorReportTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  SimpleNetDeviceHelper simple;
+  Ipv4AddressHelper ipv4 ("10.1.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = ipv4.Assign (simple.Install (nodes));
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      // resolve addresses at once, so each segment arrives before the next one is sent
+      nodes.Get (i)->GetObject<ArpL3Protocol> ()->SetAttribute ("RequestJitter", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"));
+    }
+
+  std::string tenantFile = CreateTempDirFilename ("bwm-coordinator-tenants.txt");
+  std::ofstream fout (tenantFile);
+  fout << "1\n10,50000000 20,80000000\n0,1\n";
+  fout.close ();
+  Ptr<BwmCoordinator> coordinator = CreateObject<BwmCoordinator> ();
+  coordinator->SetAttribute ("ControlTransport", EnumValue (BwmCoordinator::UDP));
+  nodes.Get (1)->AddApplication (coordinator);
+  coordinator->InputConfiguration (tenantFile);
+  std::ostringstream info;
+  info << interfaces.GetAddress (0).Get () << " " << interfaces.GetAddress (1).Get () << " " << 10000000;
+  Ptr<UnitFlow> flow = coordinator->RegisterFlow (1, 100, 1, info.str ());
+  NS_TEST_ASSERT_MSG_NE (flow, 0, "The flow is registered");
+
+  m_socket = Socket::CreateSocket (nodes.Get (0), UdpSocketFactory::GetTypeId ());
+  m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), coordinator->GetStatusPort ()));
+  m_socket->SetRecvCallback (MakeCallback (&BwmCoordinatorReportTestCase::HandleStatus, this));
+  m_coordinatorAddr = InetSocketAddress (interfaces.GetAddress (1), coordinator->GetReportPort ());
+
+  // report 0 arrives in reverse order and its first segment again,
+  // report 2 is overtaken by report 3 and completed too late
+  Simulator::Schedule (MilliSeconds (1), &BwmCoordinatorReportTestCase::SendSegment, this, 0, 1, 2, 3000000);
+  Simulator::Schedule (MilliSeconds (2), &BwmCoordinatorReportTestCase::SendSegment, this, 0, 0, 2, -1);
+  Simulator::Schedule (MilliSeconds (3), &BwmCoordinatorReportTestCase::SendSegment, this, 0, 0, 2, -1);
+  Simulator::Schedule (MilliSeconds (4), &BwmCoordinatorReportTestCase::SendSegment, this, 1, 0, 1, -1);
+  Simulator::Schedule (MilliSeconds (5), &BwmCoordinatorReportTestCase::SendSegment, this, 2, 0, 2, -1);
+  Simulator::Schedule (MilliSeconds (6), &BwmCoordinatorReportTestCase::SendSegment, this, 3, 0, 1, -1);
+  Simulator::Schedule (MilliSeconds (7), &BwmCoordinatorReportTestCase::SendSegment, this, 2, 1, 2, -1);
+  Simulator::Stop (MilliSeconds (10));
+  Simulator::Run ();
+
+  uint32_t expected[] = {0, 0, 1, 1, 2, 2, 3};
+  NS_TEST_ASSERT_MSG_EQ (m_repliesBefore.size (), 7, "Every segment is sent");
+  for (uint32_t i = 0; i < m_repliesBefore.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_repliesBefore[i], expected[i], "Replies before segment " << i);
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_replies, 3, "One reply per complete report");
+  double usage = flow->GetAccountedUsage ();
+  NS_TEST_ASSERT_MSG_EQ (usage, 3000000, "The usage of the out of order segment is accounted");
+
+  m_socket->Close ();
+  m_socket = 0;
+  coordinator->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BwmCoordinator test suite
+ */
+static class BwmCoordinatorTestSuite : public TestSuite
+{
+public:
+  BwmCoordinatorTestSuite ()
+    : TestSuite ("bwm-coordinator", UNIT)
+  {
+    AddTestCase (new BwmCoordinatorWaterFillingTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmCoordinatorTransformTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmCoordinatorReconfigureTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmCoordinatorReportTestCase (), TestCase::QUICK);
+  }
+} g_bwmCoordinatorTestSuite; ///< the test suite
@@ -0,0 +1,103 @@
+#include "ns3/test.h"
+#include "ns3/bwm-flow-table.h"
+#include "ns3/bwm-queue-disc.h"
+
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Inserts, probes and erases unit flows whose home slots collide
+ */
+class BwmFlowTableTestCase : public TestCase
+{
+public:
+  BwmFlowTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmFlowTableTestCase::BwmFlowTableTestCase ()
+  : TestCase ("Insert, probe and erase colliding unit flows")
+{
+}
+
+void
+BwmFlowTableTestCase::DoRun (void)
+{
+  // the table only stores the classes, any distinct objects do
+  std::vector<Ptr<BwmQueueDiscClass> > classes;
+  for (uint32_t i = 0; i < 200; i++)
+    {
+      classes.push_back (CreateObject<BwmQueueDiscClass> ());
+    }
+
+  BwmFlowTable table;
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 16, "A new table has 16 slots");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 0, "A new table is empty");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (1, 1), 0, "An empty table finds nothing");
+
+  // flow ids that are multiples of 1 << 16 share their home slot while the table is small
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      table.Insert (i << 16, 1, PeekPointer (classes[i]));
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 100, "Every flow was inserted");
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 128, "The table grows in powers of two below a 7/8 load");
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Find (i << 16, 1), PeekPointer (classes[i]), "Colliding flow " << i << " is found");
+    }
+
+  // the tenant id is part of the key
+  table.Insert (0, 2, PeekPointer (classes[100]));
+  NS_TEST_ASSERT_MSG_EQ (table.Find (0, 1), PeekPointer (classes[0]), "Flow 0 of tenant 1 is kept");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (0, 2), PeekPointer (classes[100]), "Flow 0 of tenant 2 is distinct");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (0, 3), 0, "Flow 0 of tenant 3 is unknown");
+
+  // erasing from the middle of the cluster shifts the followers back, they stay reachable
+  for (uint32_t i = 0; i < 100; i += 3)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.Erase (i << 16, PeekPointer (classes[i])), true, "Flow " << i << " is erased");
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.Erase (3 << 16, PeekPointer (classes[3])), false, "A flow is erased once");
+  NS_TEST_ASSERT_MSG_EQ (table.Erase (7, PeekPointer (classes[150])), false, "An unknown class isn't erased");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 100 + 1 - 34, "The erased flows are gone");
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      BwmQueueDiscClass *expected = (i % 3 == 0) ? NULL : PeekPointer (classes[i]);
+      NS_TEST_ASSERT_MSG_EQ (table.Find (i << 16, 1), expected, "Flow " << i << " after erasing");
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.Find (0, 2), PeekPointer (classes[100]), "Flow 0 of tenant 2 survives");
+
+  // reserving room grows the table once, the flows survive the rehash
+  table.Reserve (1000);
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 2048, "1000 flows fit into 2048 slots below a 7/8 load");
+  table.Reserve (10);
+  NS_TEST_ASSERT_MSG_EQ (table.GetCapacity (), 2048, "Reserving never shrinks the table");
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      BwmQueueDiscClass *expected = (i % 3 == 0) ? NULL : PeekPointer (classes[i]);
+      NS_TEST_ASSERT_MSG_EQ (table.Find (i << 16, 1), expected, "Flow " << i << " after the rehash");
+    }
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Flow table test suite
+ */
+static class BwmFlowTableTestSuite : public TestSuite
+{
+public:
+  BwmFlowTableTestSuite ()
+    : TestSuite ("bwm-flow-table", UNIT)
+  {
+    AddTestCase (new BwmFlowTableTestCase (), TestCase::QUICK);
+  }
+} g_bwmFlowTableTestSuite; ///< the test suite
@@ -0,0 +1,187 @@
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/node-container.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/traffic-control-helper.h"
+#include "ns3/ipv4-queue-disc-item.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/flow-id-tag.h"
+#include "ns3/string.h"
+#include "ns3/tenant-id-tag.h"
+#include "ns3/bandwidth-function.h"
+#include "ns3/bwm-queue-disc.h"
+#include "ns3/bwm-local-agent.h"
+#include "ns3/bwm-coordinator.h"
+
+#include <fstream>
+#include <map>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Each device of an agent scales the rates of its own unit flows
+ *
+ * One host has a 10 Mbps and a 20 Mbps device, each with a BwmQueueDisc
+ * linked to the same agent. Two unit flows sit on each device, all pinned
+ * at fair share 10 where their functions give 8 Mbps. The 16 Mbps of the
+ * first device exceed its limit and are scaled down to 5 Mbps per flow,
+ * the second device has room and its flows keep 8 Mbps.
+ */
+class BwmLocalAgentDeviceScalingTestCase : public TestCase
+{
+public:
+  BwmLocalAgentDeviceScalingTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Record the class created for a unit flow
+   * \param qDiscClass the class
+   */
+  void FlowCreateTrace (Ptr<BwmQueueDiscClass> qDiscClass);
+  /**
+   * Record a unit flow registered in the coordinator
+   * \param flow the unit flow
+   */
+  void UnitFlowCreateTrace (Ptr<UnitFlow> flow);
+
+  std::map<uint32_t, Ptr<BwmQueueDiscClass> > m_classes; //!< The classes by trace id
+  std::map<uint32_t, Ptr<UnitFlow> > m_flows;             //!< The unit flows by trace id
+};
+
+BwmLocalAgentDeviceScalingTestCase::BwmLocalAgentDeviceScalingTestCase ()
+  : TestCase ("Scale the rates of each device of a two-device agent to its own limit")
+{
+}
+
+void
+BwmLocalAgentDeviceScalingTestCase::FlowCreateTrace (Ptr<BwmQueueDiscClass> qDiscClass)
+{
+  m_classes[qDiscClass->GetTraceId ()] = qDiscClass;
+}
+
+void
+BwmLocalAgentDeviceScalingTestCase::UnitFlowCreateTrace (Ptr<UnitFlow> flow)
+{
+  m_flows[flow->GetTraceId ()] = flow;
+}
+
+void
+BwmLocalAgentDeviceScalingTestCase::DoRun (void)
+{
+  NodeContainer host;
+  host.Create (1);
+  InternetStackHelper internet;
+  internet.Install (host);
+  SimpleNetDeviceHelper simple;
+  Ipv4AddressHelper ipv4 ("10.1.0.0", "255.255.255.0");
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::BwmQueueDisc",
+                        "MaxSize", QueueSizeValue (QueueSize ("1000p")));
+  std::string rates[] = {"10Mbps", "20Mbps"};
+  Ptr<BwmQueueDisc> qdiscs[2];
+  Address macDsts[2];
+  for (uint32_t d = 0; d < 2; d++)
+    {
+      simple.SetDeviceAttribute ("DataRate", StringValue (rates[d]));
+      NetDeviceContainer devices = simple.Install (host);
+      devices.Get (0)->SetMtu (1500);
+      // assigning the address installs a default queue disc on a bare device
+      qdiscs[d] = DynamicCast<BwmQueueDisc> (tch.Install (devices.Get (0)).Get (0));
+      ipv4.Assign (devices);
+      ipv4.NewNetwork ();
+      qdiscs[d]->TraceConnectWithoutContext ("FlowCreate", MakeCallback (&BwmLocalAgentDeviceScalingTestCase::FlowCreateTrace, this));
+      macDsts[d] = devices.Get (0)->GetBroadcast ();
+    }
+
+  std::string tenantFile = CreateTempDirFilename ("bwm-local-agent-tenants.txt");
+  std::ofstream fout (tenantFile);
+  fout << "1\n10,50000000 20,80000000\n0,1\n";
+  fout.close ();
+  Ptr<BwmCoordinator> coordinator = CreateObject<BwmCoordinator> ();
+  coordinator->InputConfiguration (tenantFile);
+  coordinator->TraceConnectWithoutContext ("UnitFlowCreate", MakeCallback (&BwmLocalAgentDeviceScalingTestCase::UnitFlowCreateTrace, this));
+
+  Ptr<BwmLocalAgent> agent = CreateObject<BwmLocalAgent> ();
+  host.Get (0)->AddApplication (agent);
+  agent->SetQueueDisc (qdiscs[0]);
+  agent->AddQueueDisc (qdiscs[1]);
+  agent->SetCoordinator (coordinator);
+  for (uint32_t d = 0; d < 2; d++)
+    {
+      qdiscs[d]->SetupLocalAgent (agent);
+    }
+  NS_TEST_ASSERT_MSG_EQ (agent->GetNDevices (), 2, "The agent serves both devices");
+
+  // start the agent, it reads the rate limits of its devices
+  Simulator::Stop (MicroSeconds (1));
+  Simulator::Run ();
+
+  // flows 1 and 2 leave through the first device, flows 3 and 4 through the second;
+  // nothing dequeues the items, the classes stay backlogged
+  for (uint32_t flow = 1; flow <= 4; flow++)
+    {
+      uint32_t d = (flow - 1) / 2;
+      Ipv4Header header;
+      header.SetSource (Ipv4Address (Ipv4Address ("10.128.0.0").Get () + flow));
+      header.SetDestination (Ipv4Address ("10.0.0.2"));
+      header.SetProtocol (6);
+      header.SetPayloadSize (100);
+      Ptr<Packet> packet = Create<Packet> (100);
+      TenantIdTag tidTag;
+      tidTag.SetTenantId (1);
+      packet->AddPacketTag (tidTag);
+      packet->AddPacketTag (FlowIdTag (flow));
+      bool enqueued = qdiscs[d]->Enqueue (Create<Ipv4QueueDiscItem> (packet, macDsts[d], Ipv4L3Protocol::PROT_NUMBER, header));
+      NS_TEST_ASSERT_MSG_EQ (enqueued, true, "The packet of flow " << flow << " is enqueued");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_classes.size (), 4, "One class per unit flow");
+  NS_TEST_ASSERT_MSG_EQ (m_flows.size (), 4, "One registered unit flow per class");
+
+  // the functions are set once all flows joined the tenant, no later transform replaces them
+  for (auto &it : m_flows)
+    {
+      Ptr<BandwidthFunction> function = CreateObject<BandwidthFunction> ();
+      function->AddVertex (10, 8000000);
+      it.second->SetTransformedBF (function);
+      it.second->SetPinnedFS (10);
+    }
+
+  // one tune cycle, the first report comes later
+  Simulator::Stop (MicroSeconds (1500));
+  Simulator::Run ();
+
+  uint64_t expected[] = {5000000, 5000000, 8000000, 8000000};
+  for (uint32_t flow = 1; flow <= 4; flow++)
+    {
+      uint64_t rate = m_classes[flow]->GetRate ().GetBitRate ();
+      NS_TEST_ASSERT_MSG_EQ (rate, expected[flow - 1], "Rate of flow " << flow);
+    }
+
+  agent->Dispose ();
+  coordinator->Dispose ();
+  m_classes.clear ();
+  m_flows.clear ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BwmLocalAgent test suite
+ */
+static class BwmLocalAgentTestSuite : public TestSuite
+{
+public:
+  BwmLocalAgentTestSuite ()
+    : TestSuite ("bwm-local-agent", UNIT)
+  {
+    AddTestCase (new BwmLocalAgentDeviceScalingTestCase (), TestCase::QUICK);
+  }
+} g_bwmLocalAgentTestSuite; ///< the test suite
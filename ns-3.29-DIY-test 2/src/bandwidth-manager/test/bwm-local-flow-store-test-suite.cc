@@ -0,0 +1,123 @@
+#include "ns3/test.h"
+#include "ns3/bwm-local-flow-store.h"
+#include "ns3/bwm-coordinator.h"
+#include "ns3/bwm-queue-disc.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Erasing an entry moves the last entry of its tenant into the hole
+ */
+class BwmLocalFlowStoreEraseTestCase : public TestCase
+{
+public:
+  BwmLocalFlowStoreEraseTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Insert a unit flow into the store
+   * \param store the store
+   * \param tenantId Id of the tenant of the unit flow
+   * \param traceId the trace id, also used as the flow id
+   * \returns the unit flow
+   */
+  Ptr<UnitFlow> Insert (BwmLocalFlowStore &store, uint32_t tenantId, uint32_t traceId);
+};
+
+BwmLocalFlowStoreEraseTestCase::BwmLocalFlowStoreEraseTestCase ()
+  : TestCase ("Erase unit flows by swapping in the last entry of the tenant")
+{
+}
+
+Ptr<UnitFlow>
+BwmLocalFlowStoreEraseTestCase::Insert (BwmLocalFlowStore &store, uint32_t tenantId, uint32_t traceId)
+{
+  Ptr<UnitFlow> flow = CreateObject<UnitFlow> ();
+  flow->SetTenantId (tenantId);
+  flow->SetFlowId (traceId);
+  flow->SetTraceId (traceId);
+  store.Insert (flow, CreateObject<BwmQueueDiscClass> (), 0);
+  return flow;
+}
+
+void
+BwmLocalFlowStoreEraseTestCase::DoRun (void)
+{
+  BwmLocalFlowStore store;
+
+  // tenant 1 gets the trace ids 10 to 13, tenant 2 the ids 20 and 21
+  Ptr<UnitFlow> flows[4];
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      flows[i] = Insert (store, 1, 10 + i);
+    }
+  Ptr<UnitFlow> other = Insert (store, 2, 20);
+  Ptr<UnitFlow> otherLast = Insert (store, 2, 21);
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), 6, "Every unit flow was inserted");
+  NS_TEST_ASSERT_MSG_EQ (store.GetNGroups (), 2, "One group per tenant");
+  BwmLocalFlowStore::TenantGroup *group = store.GetTenantGroup (1);
+  NS_TEST_ASSERT_MSG_NE (group, 0, "Tenant 1 has a group");
+  NS_TEST_ASSERT_MSG_EQ (group->entries.size (), 4, "The group of tenant 1 holds its flows");
+  NS_TEST_ASSERT_MSG_EQ (store.GetTenantGroup (3), 0, "Tenant 3 has no group");
+
+  // erasing the second entry of tenant 1 moves its last entry there
+  store.EraseAt (0, 1);
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), 5, "One unit flow is gone");
+  NS_TEST_ASSERT_MSG_EQ (group->entries.size (), 3, "The group shrank");
+  NS_TEST_ASSERT_MSG_EQ (group->entries[1].flow, flows[3], "The last entry fills the hole");
+  NS_TEST_ASSERT_MSG_EQ (group->entries[0].flow, flows[0], "The first entry stays");
+  NS_TEST_ASSERT_MSG_EQ (group->entries[2].flow, flows[2], "The third entry stays");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (11), 0, "The erased flow is unknown");
+  BwmLocalFlowStore::Entry *moved = store.FindByTraceId (13);
+  NS_TEST_ASSERT_MSG_NE (moved, 0, "The moved flow is still found");
+  NS_TEST_ASSERT_MSG_EQ (moved, &group->entries[1], "The index follows the moved flow");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (12), &group->entries[2], "The flows that stayed keep their position");
+
+  // erasing the last entry moves nothing
+  store.EraseAt (0, 2);
+  NS_TEST_ASSERT_MSG_EQ (group->entries.size (), 2, "The group shrank again");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (12), 0, "The erased last flow is unknown");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (13), &group->entries[1], "The other flows are untouched");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (10), &group->entries[0], "The other flows are untouched");
+
+  // the other tenant is not affected
+  BwmLocalFlowStore::TenantGroup *otherGroup = store.GetTenantGroup (2);
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (20)->flow, other, "Tenant 2 keeps its first flow");
+  store.EraseAt (1, 0);
+  NS_TEST_ASSERT_MSG_EQ (otherGroup->entries.size (), 1, "Tenant 2 has one flow left");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (21), &otherGroup->entries[0], "Its last flow moved to the front");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (21)->flow, otherLast, "The moved entry is its last flow");
+
+  // an emptied group stays and takes the next flow of its tenant
+  store.EraseAt (1, 0);
+  NS_TEST_ASSERT_MSG_EQ (store.GetNGroups (), 2, "An emptied group is kept");
+  Insert (store, 2, 22);
+  NS_TEST_ASSERT_MSG_EQ (store.GetNGroups (), 2, "A returning tenant reuses its group");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (22), &store.GetTenantGroup (2)->entries[0], "The new flow is found");
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), 3, "Three unit flows are left");
+
+  store.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (store.GetSize (), 0, "A cleared store is empty");
+  NS_TEST_ASSERT_MSG_EQ (store.GetNGroups (), 0, "A cleared store has no group");
+  NS_TEST_ASSERT_MSG_EQ (store.FindByTraceId (10), 0, "A cleared store finds nothing");
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BwmLocalFlowStore test suite
+ */
+static class BwmLocalFlowStoreTestSuite : public TestSuite
+{
+public:
+  BwmLocalFlowStoreTestSuite ()
+    : TestSuite ("bwm-local-flow-store", UNIT)
+  {
+    AddTestCase (new BwmLocalFlowStoreEraseTestCase (), TestCase::QUICK);
+  }
+} g_bwmLocalFlowStoreTestSuite; ///< the test suite
@@ -0,0 +1,414 @@
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/node-container.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/traffic-control-helper.h"
+#include "ns3/ipv4-queue-disc-item.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/flow-id-tag.h"
+#include "ns3/string.h"
+#include "ns3/tenant-id-tag.h"
+#include "ns3/bwm-queue-disc.h"
+#include "ns3/bwm-local-agent.h"
+#include "ns3/bwm-coordinator.h"
+
+#include <fstream>
+#include <map>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Drives a BwmQueueDisc by hand and records the order items leave it
+ *
+ * The queue disc sits on a SimpleNetDevice, its local agent is wired to a
+ * coordinator but never started, so the classes keep the rates the test sets.
+ */
+class BwmQueueDiscTestBase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param name the name of the test case
+   */
+  BwmQueueDiscTestBase (std::string name);
+
+protected:
+  /**
+   * Build the queue disc, the agent and a coordinator with one tenant
+   * \param rateLimiter the RateLimiter of the queue disc
+   */
+  void Setup (std::string rateLimiter);
+  /**
+   * Build one packet of a unit flow, sent from 10.128.0.0 + flow
+   * \param flow the trace id of the unit flow
+   * \param size the payload size of the packet
+   * \returns the item
+   */
+  Ptr<QueueDiscItem> BuildItem (uint32_t flow, uint32_t size);
+  /**
+   * Enqueue one packet of a unit flow and check it is accepted
+   * \param flow the trace id of the unit flow
+   * \param size the payload size of the packet
+   */
+  void Enqueue (uint32_t flow, uint32_t size);
+  /**
+   * \param flow the trace id of a unit flow
+   * \returns the class of the unit flow
+   */
+  Ptr<BwmQueueDiscClass> GetClass (uint32_t flow);
+  /**
+   * Dequeue by hand and record the item
+   * \returns the trace id of the item, or -1 if nothing is eligible
+   */
+  uint32_t Dequeue (void);
+  /**
+   * Record the class created for a unit flow, in Carousel mode the classes
+   * are not children of the queue disc
+   * \param qDiscClass the class
+   */
+  void FlowCreateTrace (Ptr<BwmQueueDiscClass> qDiscClass);
+  /**
+   * Record an item leaving the queue disc
+   * \param item the item
+   */
+  void DequeueTrace (Ptr<const QueueDiscItem> item);
+  /**
+   * Release the objects and destroy the simulator
+   */
+  void Teardown (void);
+
+  Ptr<BwmQueueDisc> m_qdisc;              //!< The queue disc under test
+  Ptr<BwmLocalAgent> m_agent;             //!< Its local agent
+  Ptr<BwmCoordinator> m_coordinator;      //!< The coordinator of the agent
+  Address m_macDst;                       //!< The destination of the items on the device
+  std::map<uint32_t, Ptr<BwmQueueDiscClass> > m_classes; //!< The classes by trace id
+  std::vector<uint32_t> m_dequeued;       //!< Trace ids of the dequeued items, in order
+  std::vector<Time> m_dequeueTimes;       //!< Times of the dequeued items
+};
+
+BwmQueueDiscTestBase::BwmQueueDiscTestBase (std::string name)
+  : TestCase (name)
+{
+}
+
+void
+BwmQueueDiscTestBase::Setup (std::string rateLimiter)
+{
+  NodeContainer nodes;
+  nodes.Create (1);
+  SimpleNetDeviceHelper simple;
+  simple.SetDeviceAttribute ("DataRate", StringValue ("10Gbps"));
+  NetDeviceContainer devices = simple.Install (nodes);
+  // the peak buckets of the classes hold one MTU
+  devices.Get (0)->SetMtu (1500);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::BwmQueueDisc",
+                        "MaxSize", QueueSizeValue (QueueSize ("1000p")),
+                        "RateLimiter", StringValue (rateLimiter));
+  m_qdisc = DynamicCast<BwmQueueDisc> (tch.Install (devices.Get (0)).Get (0));
+  m_macDst = devices.Get (0)->GetBroadcast ();
+  m_qdisc->TraceConnectWithoutContext ("FlowCreate", MakeCallback (&BwmQueueDiscTestBase::FlowCreateTrace, this));
+  m_qdisc->TraceConnectWithoutContext ("Dequeue", MakeCallback (&BwmQueueDiscTestBase::DequeueTrace, this));
+
+  std::string tenantFile = CreateTempDirFilename ("bwm-queue-disc-tenants.txt");
+  std::ofstream fout (tenantFile);
+  fout << "1\n10,50000000 20,80000000\n0,1\n";
+  fout.close ();
+  m_coordinator = CreateObject<BwmCoordinator> ();
+  m_coordinator->InputConfiguration (tenantFile);
+
+  m_agent = CreateObject<BwmLocalAgent> ();
+  m_qdisc->SetupLocalAgent (m_agent);
+  m_agent->SetQueueDisc (m_qdisc);
+  m_agent->SetCoordinator (m_coordinator);
+  m_coordinator->RegisterHost (m_agent);
+
+  // initialize the node, its traffic control layer attaches the device queue to the queue disc
+  Simulator::Stop (MicroSeconds (1));
+  Simulator::Run ();
+  m_dequeued.clear ();
+  m_dequeueTimes.clear ();
+}
+
+Ptr<QueueDiscItem>
+BwmQueueDiscTestBase::BuildItem (uint32_t flow, uint32_t size)
+{
+  Ipv4Header header;
+  header.SetSource (Ipv4Address (Ipv4Address ("10.128.0.0").Get () + flow));
+  header.SetDestination (Ipv4Address ("10.0.0.2"));
+  header.SetProtocol (6);
+  header.SetPayloadSize (size);
+  Ptr<Packet> packet = Create<Packet> (size);
+  TenantIdTag tidTag;
+  tidTag.SetTenantId (1);
+  packet->AddPacketTag (tidTag);
+  packet->AddPacketTag (FlowIdTag (flow));
+  return Create<Ipv4QueueDiscItem> (packet, m_macDst, Ipv4L3Protocol::PROT_NUMBER, header);
+}
+
+void
+BwmQueueDiscTestBase::Enqueue (uint32_t flow, uint32_t size)
+{
+  bool enqueued = m_qdisc->Enqueue (BuildItem (flow, size));
+  NS_TEST_ASSERT_MSG_EQ (enqueued, true, "The packet of flow " << flow << " is enqueued");
+}
+
+Ptr<BwmQueueDiscClass>
+BwmQueueDiscTestBase::GetClass (uint32_t flow)
+{
+  auto it = m_classes.find (flow);
+  return it == m_classes.end () ? 0 : it->second;
+}
+
+uint32_t
+BwmQueueDiscTestBase::Dequeue (void)
+{
+  Ptr<QueueDiscItem> item = m_qdisc->Dequeue ();
+  if (!item)
+    {
+      return -1;
+    }
+  return m_dequeued.back ();
+}
+
+void
+BwmQueueDiscTestBase::FlowCreateTrace (Ptr<BwmQueueDiscClass> qDiscClass)
+{
+  m_classes[qDiscClass->GetTraceId ()] = qDiscClass;
+}
+
+void
+BwmQueueDiscTestBase::DequeueTrace (Ptr<const QueueDiscItem> item)
+{
+  FlowIdTag fidTag;
+  item->GetPacket ()->PeekPacketTag (fidTag);
+  m_dequeued.push_back (fidTag.GetFlowId ());
+  m_dequeueTimes.push_back (Simulator::Now ());
+}
+
+void
+BwmQueueDiscTestBase::Teardown (void)
+{
+  m_coordinator->Dispose ();
+  m_agent->Dispose ();
+  m_classes.clear ();
+  m_qdisc = 0;
+  m_agent = 0;
+  m_coordinator = 0;
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Backlogged classes are served one packet at a time in round robin
+ */
+class BwmQueueDiscRoundRobinTestCase : public BwmQueueDiscTestBase
+{
+public:
+  BwmQueueDiscRoundRobinTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmQueueDiscRoundRobinTestCase::BwmQueueDiscRoundRobinTestCase ()
+  : BwmQueueDiscTestBase ("Serve the backlogged classes in round robin")
+{
+}
+
+void
+BwmQueueDiscRoundRobinTestCase::DoRun (void)
+{
+  Setup ("Tbf");
+
+  // the flows arrive in bursts, a class joins the round when it becomes backlogged;
+  // the packets are small enough for the buckets to never block them
+  for (uint32_t flow = 1; flow <= 3; flow++)
+    {
+      for (uint32_t i = 0; i < flow + 1; i++)
+        {
+          Enqueue (flow, 100);
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_qdisc->GetNQueueDiscClasses (), 4, "One class per flow besides the default one");
+
+  uint32_t expected[] = {1, 2, 3, 1, 2, 3, 2, 3, 3, (uint32_t)-1};
+  for (uint32_t i = 0; i < sizeof (expected) / sizeof (expected[0]); i++)
+    {
+      uint32_t served = Dequeue ();
+      NS_TEST_ASSERT_MSG_EQ (served, expected[i], "Dequeue " << i << " serves the next class of the round");
+    }
+
+  // an idle class that becomes backlogged again joins at the end of the round
+  Enqueue (2, 100);
+  Enqueue (1, 100);
+  Enqueue (2, 100);
+  uint32_t rejoined[] = {2, 1, 2};
+  for (uint32_t i = 0; i < sizeof (rejoined) / sizeof (rejoined[0]); i++)
+    {
+      uint32_t served = Dequeue ();
+      NS_TEST_ASSERT_MSG_EQ (served, rejoined[i], "The classes rejoin the round in the order they become backlogged");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_qdisc->GetNPackets (), 0, "All packets left");
+
+  Teardown ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief A class out of tokens is parked until it is eligible, the others keep being served
+ */
+class BwmQueueDiscThrottleTestCase : public BwmQueueDiscTestBase
+{
+public:
+  BwmQueueDiscThrottleTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmQueueDiscThrottleTestCase::BwmQueueDiscThrottleTestCase ()
+  : BwmQueueDiscTestBase ("Park throttled classes and wake them when eligible")
+{
+}
+
+void
+BwmQueueDiscThrottleTestCase::DoRun (void)
+{
+  Setup ("Tbf");
+
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Enqueue (1, 1000);
+    }
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Enqueue (2, 100);
+    }
+
+  // flow 1 gets a peak bucket of one MTU that refills at 16 Mbps, so a
+  // second back to back packet of 1020 bytes has to wait for 540 bytes of tokens
+  Ptr<BwmQueueDiscClass> limited = GetClass (1);
+  NS_TEST_ASSERT_MSG_NE (limited, 0, "Flow 1 has a class");
+  limited->SetRate (DataRate ("8Mbps"));
+
+  uint32_t served[5];
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      served[i] = Dequeue ();
+    }
+  NS_TEST_ASSERT_MSG_EQ (served[0], 1, "Flow 1 still has tokens for one packet");
+  NS_TEST_ASSERT_MSG_EQ (served[1], 2, "Flow 2 follows in the round");
+  NS_TEST_ASSERT_MSG_EQ (served[2], 2, "Flow 1 is throttled, flow 2 is served in its place");
+  NS_TEST_ASSERT_MSG_EQ (served[3], 2, "The throttled class is skipped without cost");
+  NS_TEST_ASSERT_MSG_EQ (served[4], (uint32_t)-1, "Only the throttled class is backlogged");
+  NS_TEST_ASSERT_MSG_EQ (limited->GetNPackets (), 2, "The throttled class keeps its packets");
+
+  // the wake event makes the class active again and runs the queue disc
+  Simulator::Stop (MilliSeconds (10));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_dequeued.size (), 6, "The woken class sends its packets to the device");
+  NS_TEST_ASSERT_MSG_EQ (m_dequeued[4], 1, "The fifth item is of flow 1");
+  NS_TEST_ASSERT_MSG_EQ (m_dequeued[5], 1, "The sixth item is of flow 1");
+  Time wait = DataRate ("16Mbps").CalculateBytesTxTime (1020 - (1500 - 1020));
+  NS_TEST_ASSERT_MSG_EQ (m_dequeueTimes[4], MicroSeconds (1) + wait, "The class wakes once the peak bucket holds a packet");
+  NS_TEST_ASSERT_MSG_GT (m_dequeueTimes[5], m_dequeueTimes[4], "The last packet waits for tokens again");
+  NS_TEST_ASSERT_MSG_EQ (m_qdisc->GetNPackets (), 0, "All packets left");
+
+  Teardown ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief In Carousel mode packets leave from the slot of their departure time
+ */
+class BwmQueueDiscWheelTestCase : public BwmQueueDiscTestBase
+{
+public:
+  BwmQueueDiscWheelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmQueueDiscWheelTestCase::BwmQueueDiscWheelTestCase ()
+  : BwmQueueDiscTestBase ("Pace the packets with the timing wheel")
+{
+}
+
+void
+BwmQueueDiscWheelTestCase::DoRun (void)
+{
+  Setup ("Carousel");
+
+  // the first packets of the flows depart at once, the rate paces the later ones
+  Enqueue (1, 1000);
+  Enqueue (2, 100);
+  Ptr<BwmQueueDiscClass> paced = GetClass (1);
+  NS_TEST_ASSERT_MSG_NE (paced, 0, "Flow 1 has a class");
+  NS_TEST_ASSERT_MSG_EQ (paced->GetQueueDisc (), 0, "The class has no queue disc of its own");
+  NS_TEST_ASSERT_MSG_EQ (paced->SetRate (DataRate ("8Mbps")), true, "The rate of a paced class is recorded");
+  Enqueue (1, 1000);
+  Enqueue (1, 1000);
+  NS_TEST_ASSERT_MSG_EQ (paced->GetNPackets (), 3, "The class counts its packets in the wheel");
+
+  uint32_t expected[] = {1, 2, 1, (uint32_t)-1};
+  for (uint32_t i = 0; i < sizeof (expected) / sizeof (expected[0]); i++)
+    {
+      uint32_t served = Dequeue ();
+      NS_TEST_ASSERT_MSG_EQ (served, expected[i], "Dequeue " << i << " takes the head of the due slot");
+    }
+  NS_TEST_ASSERT_MSG_EQ (paced->GetNPackets (), 1, "The last packet waits for its departure time");
+
+  // the last packet departs one transmission time of 1020 bytes after the second one,
+  // at the start of its 10us slot
+  Simulator::Stop (MilliSeconds (10));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_dequeued.size (), 4, "The wheel event sends the last packet to the device");
+  NS_TEST_ASSERT_MSG_EQ (m_dequeued[3], 1, "The fourth item is of flow 1");
+  NS_TEST_ASSERT_MSG_EQ (m_dequeueTimes[3], MicroSeconds (1020), "The packet leaves from the slot of its departure time");
+  NS_TEST_ASSERT_MSG_EQ (paced->GetNPackets (), 0, "The class is drained");
+
+  // at 8 kbps the next packet of the flow would depart beyond the horizon
+  paced->SetRate (DataRate ("8kbps"));
+  Enqueue (1, 1000);
+  bool enqueued = m_qdisc->Enqueue (BuildItem (1, 1000));
+  NS_TEST_ASSERT_MSG_EQ (enqueued, false, "A packet departing beyond the horizon is dropped");
+  NS_TEST_ASSERT_MSG_EQ (m_qdisc->GetStats ().GetNDroppedPackets ("Horizon drop"), 1, "The drop is accounted");
+  uint32_t served = Dequeue ();
+  NS_TEST_ASSERT_MSG_EQ (served, 1, "The packet within the horizon departs at once");
+  NS_TEST_ASSERT_MSG_EQ (m_qdisc->GetNPackets (), 0, "All packets left");
+
+  Teardown ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BwmQueueDisc test suite
+ */
+static class BwmQueueDiscTestSuite : public TestSuite
+{
+public:
+  BwmQueueDiscTestSuite ()
+    : TestSuite ("bwm-queue-disc", UNIT)
+  {
+    AddTestCase (new BwmQueueDiscRoundRobinTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmQueueDiscThrottleTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmQueueDiscWheelTestCase (), TestCase::QUICK);
+  }
+} g_bwmQueueDiscTestSuite; ///< the test suite
@@ -0,0 +1,228 @@
+#include "ns3/test.h"
+#include "ns3/bwm-scoreboard.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Inserts and finds the lines of many unit flows
+ */
+class BwmScoreboardIndexTestCase : public TestCase
+{
+public:
+  BwmScoreboardIndexTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmScoreboardIndexTestCase::BwmScoreboardIndexTestCase ()
+  : TestCase ("Insert and find scoreboard lines across index growth")
+{
+}
+
+void
+BwmScoreboardIndexTestCase::DoRun (void)
+{
+  BwmScoreboard scoreboard;
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetSize (), 0, "A new scoreboard is empty");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.Find (1), 0, "An empty scoreboard finds nothing");
+
+  // consecutive and strided trace ids, enough to grow the index several times
+  for (uint32_t i = 0; i < 500; i++)
+    {
+      uint32_t flowId = i < 250 ? i : (i << 20);
+      NS_TEST_ASSERT_MSG_EQ (scoreboard.Insert (flowId, 0x0a000000 + i), true, "Flow " << flowId << " gets a line");
+    }
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetSize (), 500, "Every flow has a line");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.Insert (7, 0), false, "A flow gets a single line");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetSize (), 500, "The duplicate is not added");
+
+  for (uint32_t i = 0; i < 500; i++)
+    {
+      uint32_t flowId = i < 250 ? i : (i << 20);
+      BwmScoreboard::Line *line = scoreboard.Find (flowId);
+      NS_TEST_ASSERT_MSG_NE (line, 0, "Flow " << flowId << " is found");
+      NS_TEST_ASSERT_MSG_EQ (line->flowId, flowId, "The line belongs to the flow");
+      NS_TEST_ASSERT_MSG_EQ (line->srcIp, 0x0a000000 + i, "The line keeps the source address");
+      NS_TEST_ASSERT_MSG_EQ (line->normalBytes + line->ceBytes + line->samples, 0, "A new line is cleared");
+      NS_TEST_ASSERT_MSG_EQ (scoreboard.GetIndex (line), i, "Lines are kept in order of creation");
+      NS_TEST_ASSERT_MSG_EQ (&scoreboard.GetLine (i), line, "The index maps back to the line");
+    }
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.Find (250), 0, "An unknown flow is not found");
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Modified lines move through the two slots of the aging wheel
+ */
+class BwmScoreboardWheelTestCase : public TestCase
+{
+public:
+  BwmScoreboardWheelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmScoreboardWheelTestCase::BwmScoreboardWheelTestCase ()
+  : TestCase ("Age scoreboard lines on the two-slot wheel")
+{
+}
+
+void
+BwmScoreboardWheelTestCase::DoRun (void)
+{
+  BwmScoreboard scoreboard;
+  for (uint32_t flowId = 0; flowId < 3; flowId++)
+    {
+      scoreboard.Insert (flowId, 0);
+    }
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetModified ().size (), 0, "A new line is in no slot");
+  uint32_t cycle = scoreboard.GetCycle ();
+  NS_TEST_ASSERT_MSG_NE (cycle, 0, "Cycle 0 is never current");
+
+  // a line is recorded once per cycle however often it is modified
+  scoreboard.Touch (scoreboard.Find (0));
+  scoreboard.Touch (scoreboard.Find (0));
+  scoreboard.Touch (scoreboard.Find (2));
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetModified ().size (), 2, "Two lines were modified");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.Find (0)->cycle, cycle, "The line remembers the cycle");
+
+  // the modified lines of the last cycle are expiring unless modified again
+  scoreboard.NextCycle ();
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetCycle (), cycle + 1, "The wheel turned");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetModified ().size (), 0, "The current slot starts empty");
+  std::vector<uint32_t> expiring = scoreboard.GetExpiring ();
+  std::sort (expiring.begin (), expiring.end ());
+  NS_TEST_ASSERT_MSG_EQ (expiring.size (), 2, "Both lines are expiring");
+  NS_TEST_ASSERT_MSG_EQ (expiring[0], 0, "Line 0 is expiring");
+  NS_TEST_ASSERT_MSG_EQ (expiring[1], 2, "Line 2 is expiring");
+
+  scoreboard.Touch (scoreboard.Find (2));
+  scoreboard.Touch (scoreboard.Find (1));
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetModified ().size (), 2, "Lines 1 and 2 are modified in the new cycle");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetExpiring ().size (), 2, "The expiring slot keeps line 2 until the next turn");
+
+  // after another turn, an idle cycle empties the wheel
+  scoreboard.NextCycle ();
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetExpiring ().size (), 2, "Lines 1 and 2 are expiring");
+  scoreboard.NextCycle ();
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetExpiring ().size (), 0, "No line was modified in the idle cycle");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetModified ().size (), 0, "No line is modified");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetSize (), 3, "Aging never drops lines");
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Removed lines leave the index and are reused by new unit flows
+ */
+class BwmScoreboardReuseTestCase : public TestCase
+{
+public:
+  BwmScoreboardReuseTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmScoreboardReuseTestCase::BwmScoreboardReuseTestCase ()
+  : TestCase ("Reuse the scoreboard lines of expired unit flows")
+{
+}
+
+void
+BwmScoreboardReuseTestCase::DoRun (void)
+{
+  // a line expires after a check cycle without modification and is removed
+  BwmScoreboard scoreboard;
+  scoreboard.Insert (1, 0x0a000001);
+  scoreboard.Insert (2, 0x0a000002);
+  scoreboard.Touch (scoreboard.Find (1));
+  scoreboard.NextCycle ();
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetExpiring ().size (), 1, "Line 0 is expiring");
+  uint32_t expired = scoreboard.GetExpiring ()[0];
+  scoreboard.Remove (expired);
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.Find (1), 0, "The expired flow has no line");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetSize (), 1, "One line is in use");
+
+  // the next flow takes the expired line, cleared
+  scoreboard.Insert (3, 0x0a000003);
+  BwmScoreboard::Line *line = scoreboard.Find (3);
+  NS_TEST_ASSERT_MSG_NE (line, 0, "The new flow is found");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetIndex (line), expired, "The new flow reuses the expired line");
+  NS_TEST_ASSERT_MSG_EQ (line->srcIp, 0x0a000003, "The reused line belongs to the new flow");
+  NS_TEST_ASSERT_MSG_EQ (line->cycle, 0, "The reused line is in no wheel slot");
+  NS_TEST_ASSERT_MSG_EQ (scoreboard.GetCapacity (), 2, "No line is added");
+  NS_TEST_ASSERT_MSG_NE (scoreboard.Find (2), 0, "The other flow keeps its line");
+
+  // removing every other line of long probe sequences keeps the others reachable,
+  // consecutive and strided ids replace the removed ones round after round
+  BwmScoreboard churn;
+  std::vector<uint32_t> flowIds;
+  for (uint32_t i = 0; i < 200; i++)
+    {
+      flowIds.push_back (i < 100 ? i : (i << 20));
+      churn.Insert (flowIds.back (), 0);
+    }
+  uint32_t capacity = churn.GetCapacity ();
+  for (uint32_t round = 1; round <= 5; round++)
+    {
+      for (uint32_t i = round % 2; i < flowIds.size (); i += 2)
+        {
+          churn.Remove (churn.GetIndex (churn.Find (flowIds[i])));
+        }
+      NS_TEST_ASSERT_MSG_EQ (churn.GetSize (), 100, "Half of the lines are in use in round " << round);
+      for (uint32_t i = 0; i < flowIds.size (); i++)
+        {
+          BwmScoreboard::Line *found = churn.Find (flowIds[i]);
+          if (i % 2 == round % 2)
+            {
+              NS_TEST_ASSERT_MSG_EQ (found, 0, "Flow " << flowIds[i] << " is removed in round " << round);
+            }
+          else
+            {
+              NS_TEST_ASSERT_MSG_NE (found, 0, "Flow " << flowIds[i] << " is still found in round " << round);
+              NS_TEST_ASSERT_MSG_EQ (found->flowId, flowIds[i], "The line belongs to flow " << flowIds[i]);
+            }
+        }
+      for (uint32_t i = round % 2; i < flowIds.size (); i += 2)
+        {
+          flowIds[i] += round * 1000;
+          churn.Insert (flowIds[i], 0);
+        }
+      NS_TEST_ASSERT_MSG_EQ (churn.GetSize (), 200, "Every removed line is replaced in round " << round);
+      NS_TEST_ASSERT_MSG_EQ (churn.GetCapacity (), capacity, "The replacements reuse the removed lines in round " << round);
+      for (uint32_t i = 0; i < flowIds.size (); i++)
+        {
+          NS_TEST_ASSERT_MSG_NE (churn.Find (flowIds[i]), 0, "Flow " << flowIds[i] << " is found after round " << round);
+        }
+    }
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BwmScoreboard test suite
+ */
+static class BwmScoreboardTestSuite : public TestSuite
+{
+public:
+  BwmScoreboardTestSuite ()
+    : TestSuite ("bwm-scoreboard", UNIT)
+  {
+    AddTestCase (new BwmScoreboardIndexTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmScoreboardWheelTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmScoreboardReuseTestCase (), TestCase::QUICK);
+  }
+} g_bwmScoreboardTestSuite; ///< the test suite
@@ -0,0 +1,267 @@
+#include "ns3/test.h"
+#include "ns3/ptr.h"
+#include "ns3/bwm-tenant-config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief A text configuration converted into the binary format reads back the same
+ */
+class BwmTenantConfigConvertTestCase : public TestCase
+{
+public:
+  BwmTenantConfigConvertTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmTenantConfigConvertTestCase::BwmTenantConfigConvertTestCase ()
+  : TestCase ("Convert a text configuration and map it back")
+{
+}
+
+void
+BwmTenantConfigConvertTestCase::DoRun (void)
+{
+  // the tenants are out of order, tenant 7 has no host weight
+  std::string textPath = CreateTempDirFilename ("bwm-tenant-config.txt");
+  std::ofstream fout (textPath);
+  fout << "12\n10,50000000 20,80000000\n0,1 3,2.5\n"
+       << "7\n0.5,1e6\n\n"
+       << "9\n1,1000 1,2000 4,2000\n4294967295,0.25\n"
+       << "\n"
+       << "13\nthe configuration ends at the empty line\n";
+  fout.close ();
+
+  std::string binaryPath = CreateTempDirFilename ("bwm-tenant-config.bin");
+  std::string error;
+  bool converted = BwmTenantConfig::Convert (textPath, binaryPath, error);
+  NS_TEST_ASSERT_MSG_EQ (converted, true, "The configuration converts: " << error);
+  NS_TEST_ASSERT_MSG_EQ (BwmTenantConfig::IsBinary (binaryPath), true, "The output is binary");
+  NS_TEST_ASSERT_MSG_EQ (BwmTenantConfig::IsBinary (textPath), false, "The input is text");
+
+  Ptr<BwmTenantConfig> config = Create<BwmTenantConfig> ();
+  bool opened = config->Open (binaryPath, error);
+  NS_TEST_ASSERT_MSG_EQ (opened, true, "The output is valid: " << error);
+  NS_TEST_ASSERT_MSG_EQ (config->GetNTenants (), 3, "Three tenants before the empty line");
+  uint32_t ids[] = {7, 9, 12};
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (config->GetEntry (i)->tenantId, ids[i], "The entries are sorted by tenant id");
+      NS_TEST_ASSERT_MSG_EQ (config->Find (ids[i]), config->GetEntry (i), "Tenant " << ids[i] << " is found");
+    }
+  NS_TEST_ASSERT_MSG_EQ (config->Find (8), 0, "An unknown tenant is not found");
+  NS_TEST_ASSERT_MSG_EQ (config->Find (13), 0, "Nothing behind the empty line is read");
+
+  const BwmTenantConfig::Entry *entry = config->Find (12);
+  NS_TEST_ASSERT_MSG_EQ (entry->vertexNum, 2, "Tenant 12 has two vertices");
+  NS_TEST_ASSERT_MSG_EQ (entry->weightNum, 2, "Tenant 12 has two host weights");
+  NS_TEST_ASSERT_MSG_EQ (entry->offset % 8, 0, "The record is aligned");
+  const BwmTenantConfig::Vertex *vertices = config->GetVertices (entry);
+  NS_TEST_ASSERT_MSG_EQ (vertices[0].fairShare, 10, "First vertex of tenant 12");
+  NS_TEST_ASSERT_MSG_EQ (vertices[0].bandwidth, 50000000, "First vertex of tenant 12");
+  NS_TEST_ASSERT_MSG_EQ (vertices[1].fairShare, 20, "Second vertex of tenant 12");
+  NS_TEST_ASSERT_MSG_EQ (vertices[1].bandwidth, 80000000, "Second vertex of tenant 12");
+  const BwmTenantConfig::HostWeight *weights = config->GetHostWeights (entry);
+  NS_TEST_ASSERT_MSG_EQ (weights[0].hostId, 0, "First host weight of tenant 12");
+  NS_TEST_ASSERT_MSG_EQ (weights[0].weight, 1, "First host weight of tenant 12");
+  NS_TEST_ASSERT_MSG_EQ (weights[1].hostId, 3, "Second host weight of tenant 12");
+  NS_TEST_ASSERT_MSG_EQ (weights[1].weight, 2.5, "Second host weight of tenant 12");
+
+  entry = config->Find (7);
+  NS_TEST_ASSERT_MSG_EQ (entry->vertexNum, 1, "Tenant 7 has one vertex");
+  NS_TEST_ASSERT_MSG_EQ (entry->weightNum, 0, "Tenant 7 has no host weight");
+  NS_TEST_ASSERT_MSG_EQ (config->GetVertices (entry)[0].bandwidth, 1e6, "The vertex of tenant 7");
+
+  // a vertical step and the largest host id survive
+  entry = config->Find (9);
+  NS_TEST_ASSERT_MSG_EQ (entry->vertexNum, 3, "Tenant 9 has three vertices");
+  NS_TEST_ASSERT_MSG_EQ (config->GetVertices (entry)[1].fairShare, 1, "The step keeps its fair share");
+  NS_TEST_ASSERT_MSG_EQ (config->GetVertices (entry)[1].bandwidth, 2000, "The step keeps its bandwidth");
+  NS_TEST_ASSERT_MSG_EQ (config->GetHostWeights (entry)[0].hostId, 4294967295u, "The largest host id");
+  NS_TEST_ASSERT_MSG_EQ (config->GetHostWeights (entry)[0].weight, 0.25, "The weight of the largest host id");
+
+  config->Close ();
+  NS_TEST_ASSERT_MSG_EQ (config->GetNTenants (), 0, "A closed configuration is empty");
+  NS_TEST_ASSERT_MSG_EQ (config->Find (7), 0, "A closed configuration finds nothing");
+
+  // malformed text is reported with its line
+  const char *malformed[][2] = {
+    {"1\n10,50000000\n0,1\nx\n", ":4: invalid tenant id"},
+    {"1\n10;50000000\n0,1\n", ":2: invalid vertex"},
+    {"1\n10,50000000 20\n0,1\n", ":2: invalid vertex"},
+    {"1\n10,50000000\n0,1 1.5,2\n", ":3: invalid host weight"},
+    {"1\n10,50000000\n-1,2\n", ":3: invalid host weight"},
+    {"1\n20,50000000 10,80000000\n0,1\n", "vertex 1 breaks"},
+    {"1\n10,50000000\n0,0\n", "host 0 has a non-positive weight"},
+    {"1\n\n0,1\n", "no bandwidth function"},
+  };
+  for (auto &text : malformed)
+    {
+      fout.open (textPath, std::ios::trunc);
+      fout << text[0];
+      fout.close ();
+      error = "";
+      converted = BwmTenantConfig::Convert (textPath, binaryPath, error);
+      NS_TEST_ASSERT_MSG_EQ (converted, false, "Malformed text is rejected: " << text[0]);
+      NS_TEST_ASSERT_MSG_NE (error.find (text[1]), std::string::npos, "Reason of the rejection: " << error);
+    }
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Every malformation of a binary configuration is rejected
+ */
+class BwmTenantConfigValidateTestCase : public TestCase
+{
+public:
+  BwmTenantConfigValidateTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Check that a configuration is rejected
+   * \param data the configuration
+   * \param size the size of the configuration in bytes
+   * \param reason a part of the expected reason
+   */
+  void CheckRejected (const std::vector<uint8_t> &data, uint64_t size, std::string reason);
+};
+
+BwmTenantConfigValidateTestCase::BwmTenantConfigValidateTestCase ()
+  : TestCase ("Reject malformed binary configurations")
+{
+}
+
+void
+BwmTenantConfigValidateTestCase::CheckRejected (const std::vector<uint8_t> &data, uint64_t size, std::string reason)
+{
+  std::string error;
+  bool valid = BwmTenantConfig::Validate (data.data (), size, error);
+  NS_TEST_ASSERT_MSG_EQ (valid, false, "Configuration rejected for " << reason);
+  NS_TEST_ASSERT_MSG_NE (error.find (reason), std::string::npos, "Reason of the rejection: " << error);
+}
+
+void
+BwmTenantConfigValidateTestCase::DoRun (void)
+{
+  std::string textPath = CreateTempDirFilename ("bwm-tenant-config.txt");
+  std::ofstream fout (textPath);
+  fout << "1\n10,50000000 20,80000000\n0,1 3,2\n2\n5,1000\n4,0.5\n";
+  fout.close ();
+  std::string binaryPath = CreateTempDirFilename ("bwm-tenant-config.bin");
+  std::string error;
+  bool converted = BwmTenantConfig::Convert (textPath, binaryPath, error);
+  NS_TEST_ASSERT_MSG_EQ (converted, true, "The configuration converts: " << error);
+  std::ifstream fin (binaryPath, std::ios::binary);
+  const std::vector<uint8_t> valid ((std::istreambuf_iterator<char> (fin)), std::istreambuf_iterator<char> ());
+  fin.close ();
+  bool accepted = BwmTenantConfig::Validate (valid.data (), valid.size (), error);
+  NS_TEST_ASSERT_MSG_EQ (accepted, true, "The original is valid: " << error);
+
+  typedef BwmTenantConfig::Header Header;
+  typedef BwmTenantConfig::Entry Entry;
+  typedef BwmTenantConfig::Vertex Vertex;
+  typedef BwmTenantConfig::HostWeight HostWeight;
+  // the fields are edited in place, restoring the copy keeps the pointers into it valid
+  std::vector<uint8_t> data = valid;
+  Header *header = reinterpret_cast<Header *> (data.data ());
+  Entry *entries = reinterpret_cast<Entry *> (data.data () + sizeof (Header));
+  Vertex *vertices = reinterpret_cast<Vertex *> (data.data () + entries[0].offset);
+  HostWeight *weights = reinterpret_cast<HostWeight *> (vertices + entries[0].vertexNum);
+
+  CheckRejected (data, sizeof (Header) - 1, "too short for the header");
+  CheckRejected (data, sizeof (Header) + sizeof (Entry), "index of 2 tenants exceeds the file");
+  CheckRejected (data, data.size () - 1, "record out of the file");
+
+  header->magic = 0x42574d54;
+  CheckRejected (data, data.size (), "bad magic");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  header->version = BwmTenantConfig::VERSION + 1;
+  CheckRejected (data, data.size (), "unsupported version 2");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  header->tenantNum = 1000;
+  CheckRejected (data, data.size (), "index of 1000 tenants exceeds the file");
+
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  entries[1].tenantId = entries[0].tenantId;
+  CheckRejected (data, data.size (), "not sorted by unique tenant id");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  entries[0].vertexNum = 0;
+  CheckRejected (data, data.size (), "no bandwidth function");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  entries[0].offset += 4;
+  CheckRejected (data, data.size (), "record out of the file");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  entries[0].offset = 0;
+  CheckRejected (data, data.size (), "record out of the file");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  entries[1].weightNum = 1000;
+  CheckRejected (data, data.size (), "record out of the file");
+
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  vertices[1].bandwidth = vertices[0].bandwidth - 1;
+  CheckRejected (data, data.size (), "tenant 1: vertex 1 breaks");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  vertices[0].fairShare = -1;
+  CheckRejected (data, data.size (), "tenant 1: vertex 0 breaks");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  vertices[1].fairShare = std::numeric_limits<double>::infinity ();
+  CheckRejected (data, data.size (), "tenant 1: vertex 1 breaks");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  vertices[0].bandwidth = std::nan ("");
+  CheckRejected (data, data.size (), "tenant 1: vertex 0 breaks");
+
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  weights[1].weight = 0;
+  CheckRejected (data, data.size (), "tenant 1: host 3 has a non-positive weight");
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  weights[0].weight = std::nan ("");
+  CheckRejected (data, data.size (), "tenant 1: host 0 has a non-positive weight");
+
+  // the same malformations are refused by Open
+  std::copy (valid.begin (), valid.end (), data.begin ());
+  entries[1].vertexNum = 0;
+  std::ofstream bout (binaryPath, std::ios::binary | std::ios::trunc);
+  bout.write (reinterpret_cast<const char *> (data.data ()), data.size ());
+  bout.close ();
+  Ptr<BwmTenantConfig> config = Create<BwmTenantConfig> ();
+  bool opened = config->Open (binaryPath, error);
+  NS_TEST_ASSERT_MSG_EQ (opened, false, "Open validates the file");
+  NS_TEST_ASSERT_MSG_NE (error.find ("tenant 2: no bandwidth function"), std::string::npos, "Reason of the rejection: " << error);
+  NS_TEST_ASSERT_MSG_EQ (config->GetNTenants (), 0, "A rejected file isn't kept mapped");
+  bout.open (binaryPath, std::ios::trunc);
+  bout.close ();
+  opened = config->Open (binaryPath, error);
+  NS_TEST_ASSERT_MSG_EQ (opened, false, "An empty file is refused");
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BwmTenantConfig test suite
+ */
+static class BwmTenantConfigTestSuite : public TestSuite
+{
+public:
+  BwmTenantConfigTestSuite ()
+    : TestSuite ("bwm-tenant-config", UNIT)
+  {
+    AddTestCase (new BwmTenantConfigConvertTestCase (), TestCase::QUICK);
+    AddTestCase (new BwmTenantConfigValidateTestCase (), TestCase::QUICK);
+  }
+} g_bwmTenantConfigTestSuite; ///< the test suite
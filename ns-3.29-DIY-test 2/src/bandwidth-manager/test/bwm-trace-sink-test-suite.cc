@@ -0,0 +1,95 @@
+#include "ns3/test.h"
+#include "ns3/uinteger.h"
+#include "ns3/bwm-trace-sink.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Records reach their stream files in order, writes after Close are dropped
+ */
+class BwmTraceSinkWriteTestCase : public TestCase
+{
+public:
+  BwmTraceSinkWriteTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BwmTraceSinkWriteTestCase::BwmTraceSinkWriteTestCase ()
+  : TestCase ("Write trace records across buffers and after closing")
+{
+}
+
+void
+BwmTraceSinkWriteTestCase::DoRun (void)
+{
+  // a small buffer hands several batches to the writer thread
+  Ptr<BwmTraceSink> sink = CreateObject<BwmTraceSink> ();
+  sink->SetAttribute ("BufferSize", UintegerValue (4));
+  std::string onePath = CreateTempDirFilename ("bwm-trace-one.bin");
+  std::string twoPath = CreateTempDirFilename ("bwm-trace-two.bin");
+  uint32_t one = sink->AddStream (onePath, 1);
+  uint32_t two = sink->AddStream (twoPath, 2, true);
+  NS_TEST_ASSERT_MSG_EQ (one, 0, "The first stream");
+  NS_TEST_ASSERT_MSG_EQ (two, 1, "The second stream");
+  uint32_t missing = sink->AddStream (CreateTempDirFilename ("no-such-dir/trace.bin"), 1);
+  NS_TEST_ASSERT_MSG_EQ (missing, (uint32_t)-1, "A file that cannot be opened gives no stream");
+
+  std::ostringstream oneExpected;
+  std::ostringstream twoExpected;
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      sink->Write (one, i * 0.5, i, i + 0.25);
+      oneExpected << i * 0.5 << "," << i << "," << i + 0.25 << "\n";
+      sink->Write (two, i, i, 100 + i, 1000 * i + 0.75);
+      twoExpected << i << "," << i << "," << 100 + i << "," << 1000 * i << "\n";
+    }
+  sink->Close ();
+
+  // the sink is closed, trace sources firing late must not touch the files
+  sink->Write (one, 20, 20, 20);
+  sink->Write (two, 20, 20, 20, 20);
+  sink->Flush ();
+  sink->Close ();
+
+  std::string error;
+  std::string csvPath = CreateTempDirFilename ("bwm-trace.csv");
+  std::string paths[] = {onePath, twoPath};
+  std::string expected[] = {oneExpected.str (), twoExpected.str ()};
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      bool converted = BwmTraceSink::ConvertToCsv (paths[i], csvPath, error);
+      NS_TEST_ASSERT_MSG_EQ (converted, true, "Stream " << i << " converts: " << error);
+      std::ifstream fin (csvPath);
+      std::ostringstream csv;
+      csv << fin.rdbuf ();
+      NS_TEST_ASSERT_MSG_EQ (csv.str (), expected[i], "Stream " << i << " holds every record written before Close");
+    }
+
+  bool converted = BwmTraceSink::ConvertToCsv (csvPath, csvPath + ".csv", error);
+  NS_TEST_ASSERT_MSG_EQ (converted, false, "Text is not a trace stream");
+  sink->Dispose ();
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BwmTraceSink test suite
+ */
+static class BwmTraceSinkTestSuite : public TestSuite
+{
+public:
+  BwmTraceSinkTestSuite ()
+    : TestSuite ("bwm-trace-sink", UNIT)
+  {
+    AddTestCase (new BwmTraceSinkWriteTestCase (), TestCase::QUICK);
+  }
+} g_bwmTraceSinkTestSuite; ///< the test suite
@@ -0,0 +1,95 @@
+#include "ns3/test.h"
+#include "ns3/bwm-worker-pool.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief Every task of a batch runs once, also after the pool is restarted
+ *
+ * A restart happens when the WorkerThreads attribute of the coordinator
+ * changes between two batches. The workers of the new threads must only
+ * join the batches posted after they were started.
+ */
+class BwmWorkerPoolRestartTestCase : public TestCase
+{
+public:
+  BwmWorkerPoolRestartTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Run batches of tasks and check that each task runs exactly once
+   * \param pool the pool
+   * \param batchNum the number of batches
+   */
+  void RunBatches (BwmWorkerPool &pool, uint32_t batchNum);
+};
+
+BwmWorkerPoolRestartTestCase::BwmWorkerPoolRestartTestCase ()
+  : TestCase ("Run every task once across worker pool restarts")
+{
+}
+
+void
+BwmWorkerPoolRestartTestCase::RunBatches (BwmWorkerPool &pool, uint32_t batchNum)
+{
+  for (uint32_t batch = 0; batch < batchNum; batch++)
+    {
+      uint32_t taskNum = 1 + batch % 64;
+      std::vector<std::atomic<uint32_t> > runs (taskNum);
+      for (auto &run : runs)
+        {
+          run = 0;
+        }
+      pool.Run (taskNum, [&runs] (uint32_t i) { runs[i]++; });
+      // Run has returned, no task may still be running
+      for (uint32_t i = 0; i < taskNum; i++)
+        {
+          uint32_t count = runs[i];
+          NS_TEST_ASSERT_MSG_EQ (count, 1, "Task " << i << " of batch " << batch << " runs once");
+        }
+    }
+}
+
+void
+BwmWorkerPoolRestartTestCase::DoRun (void)
+{
+  BwmWorkerPool pool;
+  RunBatches (pool, 10);
+  NS_TEST_ASSERT_MSG_EQ (pool.GetNThreads (), 0, "No thread before the pool is started");
+
+  uint32_t threadNums[] = {2, 3, 1, 4};
+  for (uint32_t threadNum : threadNums)
+    {
+      // the new workers see batches posted before the restart
+      pool.Start (threadNum);
+      NS_TEST_ASSERT_MSG_EQ (pool.GetNThreads (), threadNum, "The pool runs " << threadNum << " threads");
+      RunBatches (pool, 200);
+    }
+
+  pool.Stop ();
+  NS_TEST_ASSERT_MSG_EQ (pool.GetNThreads (), 0, "The threads are joined");
+  RunBatches (pool, 10);
+}
+
+/**
+ * \ingroup bandwidth-manager-test
+ * \ingroup tests
+ *
+ * \brief BwmWorkerPool test suite
+ */
+static class BwmWorkerPoolTestSuite : public TestSuite
+{
+public:
+  BwmWorkerPoolTestSuite ()
+    : TestSuite ("bwm-worker-pool", UNIT)
+  {
+    AddTestCase (new BwmWorkerPoolRestartTestCase (), TestCase::QUICK);
+  }
+} g_bwmWorkerPoolTestSuite; ///< the test suite
@@ -0,0 +1,353 @@
+#include "bwm-control-header.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BwmControlHeader");
+
+NS_OBJECT_ENSURE_REGISTERED (BwmUsageReportHeader);
+
+TypeId
+BwmUsageReportHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BwmUsageReportHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("BandwidthManager")
+    .AddConstructor<BwmUsageReportHeader> ()
+  ;
+  return tid;
+}
+TypeId
+BwmUsageReportHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+uint32_t
+BwmUsageReportHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return 16 + RECORD_SIZE * m_records.size ();
+}
+void
+BwmUsageReportHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  i.WriteHtonU32 (m_hostId);
+  i.WriteHtonU32 (m_reportId);
+  i.WriteHtonU16 (m_segmentIndex);
+  i.WriteHtonU16 (m_segmentCount);
+  i.WriteHtonU16 (m_records.size ());
+  i.WriteHtonU16 (m_replyRequested ? 1 : 0);
+  for (auto record : m_records)
+    {
+      i.WriteHtonU32 (record.tenantId);
+      i.WriteHtonU32 (record.flowId);
+      i.WriteHtonU32 (record.usage);
+    }
+}
+uint32_t
+BwmUsageReportHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  m_hostId = i.ReadNtohU32 ();
+  m_reportId = i.ReadNtohU32 ();
+  m_segmentIndex = i.ReadNtohU16 ();
+  m_segmentCount = i.ReadNtohU16 ();
+  uint16_t recordNum = i.ReadNtohU16 ();
+  m_replyRequested = (i.ReadNtohU16 () & 1) != 0;
+  m_records.resize (recordNum);
+  for (auto &record : m_records)
+    {
+      record.tenantId = i.ReadNtohU32 ();
+      record.flowId = i.ReadNtohU32 ();
+      record.usage = i.ReadNtohU32 ();
+    }
+  return GetSerializedSize ();
+}
+void
+BwmUsageReportHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this << &os);
+  os << "HostId=" << m_hostId << " ReportId=" << m_reportId
+     << " Segment=" << m_segmentIndex << "/" << m_segmentCount
+     << " Records=" << m_records.size () << " Reply=" << m_replyRequested;
+}
+BwmUsageReportHeader::BwmUsageReportHeader ()
+  : m_hostId (0),
+    m_reportId (0),
+    m_segmentIndex (0),
+    m_segmentCount (1),
+    m_replyRequested (true)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BwmUsageReportHeader::SetHostId (uint32_t hostId)
+{
+  NS_LOG_FUNCTION (this << hostId);
+  m_hostId = hostId;
+}
+uint32_t
+BwmUsageReportHeader::GetHostId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_hostId;
+}
+void
+BwmUsageReportHeader::SetReportId (uint32_t reportId)
+{
+  NS_LOG_FUNCTION (this << reportId);
+  m_reportId = reportId;
+}
+uint32_t
+BwmUsageReportHeader::GetReportId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_reportId;
+}
+void
+BwmUsageReportHeader::SetSegment (uint16_t index, uint16_t count)
+{
+  NS_LOG_FUNCTION (this << index << count);
+  NS_ASSERT (index < count);
+  m_segmentIndex = index;
+  m_segmentCount = count;
+}
+uint16_t
+BwmUsageReportHeader::GetSegmentIndex (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_segmentIndex;
+}
+uint16_t
+BwmUsageReportHeader::GetSegmentCount (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_segmentCount;
+}
+void
+BwmUsageReportHeader::SetReplyRequested (bool reply)
+{
+  NS_LOG_FUNCTION (this << reply);
+  m_replyRequested = reply;
+}
+bool
+BwmUsageReportHeader::IsReplyRequested (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_replyRequested;
+}
+bool
+BwmUsageReportHeader::AddRecord (uint32_t tenantId, uint32_t flowId, double usage)
+{
+  NS_LOG_FUNCTION (this << tenantId << flowId << usage);
+  if (m_records.size () >= MAX_RECORDS)
+    {
+      return false;
+    }
+
+  // quantize the usage and saturate at the largest representable value
+  double units = std::round (std::max (usage, 0.0) / USAGE_QUANTUM);
+  Record record;
+  record.tenantId = tenantId;
+  record.flowId = flowId;
+  record.usage = units >= std::numeric_limits<uint32_t>::max () ? std::numeric_limits<uint32_t>::max () : static_cast<uint32_t> (units);
+  m_records.push_back (record);
+  return true;
+}
+uint32_t
+BwmUsageReportHeader::GetNRecords (void) const
+{
+  return m_records.size ();
+}
+uint32_t
+BwmUsageReportHeader::GetTenantId (uint32_t index) const
+{
+  NS_ASSERT (index < m_records.size ());
+  return m_records[index].tenantId;
+}
+uint32_t
+BwmUsageReportHeader::GetFlowId (uint32_t index) const
+{
+  NS_ASSERT (index < m_records.size ());
+  return m_records[index].flowId;
+}
+double
+BwmUsageReportHeader::GetUsage (uint32_t index) const
+{
+  NS_ASSERT (index < m_records.size ());
+  return static_cast<double> (m_records[index].usage) * USAGE_QUANTUM;
+}
+
+NS_OBJECT_ENSURE_REGISTERED (BwmTargetStatusHeader);
+
+TypeId
+BwmTargetStatusHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BwmTargetStatusHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("BandwidthManager")
+    .AddConstructor<BwmTargetStatusHeader> ()
+  ;
+  return tid;
+}
+TypeId
+BwmTargetStatusHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+uint32_t
+BwmTargetStatusHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return 8;
+}
+void
+BwmTargetStatusHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this << &start);
+  // carry the exact bit pattern of the double
+  uint64_t bits;
+  std::memcpy (&bits, &m_targetStatus, sizeof (bits));
+  start.WriteHtonU64 (bits);
+}
+uint32_t
+BwmTargetStatusHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this << &start);
+  uint64_t bits = start.ReadNtohU64 ();
+  std::memcpy (&m_targetStatus, &bits, sizeof (bits));
+  return GetSerializedSize ();
+}
+void
+BwmTargetStatusHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this << &os);
+  os << "TargetStatus=" << m_targetStatus;
+}
+BwmTargetStatusHeader::BwmTargetStatusHeader ()
+  : m_targetStatus (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BwmTargetStatusHeader::SetTargetStatus (double targetStatus)
+{
+  NS_LOG_FUNCTION (this << targetStatus);
+  m_targetStatus = targetStatus;
+}
+double
+BwmTargetStatusHeader::GetTargetStatus (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_targetStatus;
+}
+
+NS_OBJECT_ENSURE_REGISTERED (BwmCongestionFeedbackHeader);
+
+TypeId
+BwmCongestionFeedbackHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BwmCongestionFeedbackHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("BandwidthManager")
+    .AddConstructor<BwmCongestionFeedbackHeader> ()
+  ;
+  return tid;
+}
+TypeId
+BwmCongestionFeedbackHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+uint32_t
+BwmCongestionFeedbackHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return 2 + RECORD_SIZE * m_records.size ();
+}
+void
+BwmCongestionFeedbackHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  i.WriteHtonU16 (m_records.size ());
+  for (auto record : m_records)
+    {
+      // carry the exact bit pattern of the float
+      uint32_t bits;
+      std::memcpy (&bits, &record.factor, sizeof (bits));
+      i.WriteHtonU32 (record.traceId);
+      i.WriteHtonU32 (bits);
+    }
+}
+uint32_t
+BwmCongestionFeedbackHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  uint16_t recordNum = i.ReadNtohU16 ();
+  m_records.resize (recordNum);
+  for (auto &record : m_records)
+    {
+      record.traceId = i.ReadNtohU32 ();
+      uint32_t bits = i.ReadNtohU32 ();
+      std::memcpy (&record.factor, &bits, sizeof (bits));
+    }
+  return GetSerializedSize ();
+}
+void
+BwmCongestionFeedbackHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this << &os);
+  os << "Records=" << m_records.size ();
+}
+BwmCongestionFeedbackHeader::BwmCongestionFeedbackHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+BwmCongestionFeedbackHeader::AddRecord (uint32_t traceId, float factor)
+{
+  NS_LOG_FUNCTION (this << traceId << factor);
+  if (m_records.size () >= MAX_RECORDS)
+    {
+      return false;
+    }
+
+  Record record;
+  record.traceId = traceId;
+  record.factor = factor;
+  m_records.push_back (record);
+  return true;
+}
+uint32_t
+BwmCongestionFeedbackHeader::GetNRecords (void) const
+{
+  return m_records.size ();
+}
+uint32_t
+BwmCongestionFeedbackHeader::GetTraceId (uint32_t index) const
+{
+  NS_ASSERT (index < m_records.size ());
+  return m_records[index].traceId;
+}
+float
+BwmCongestionFeedbackHeader::GetFactor (uint32_t index) const
+{
+  NS_ASSERT (index < m_records.size ());
+  return m_records[index].factor;
+}
+
+} // namespace ns3
+
@@ -0,0 +1,229 @@
+#ifndef BWM_CONTROL_HEADER_H
+#define BWM_CONTROL_HEADER_H
+
+#include "ns3/header.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief A header carrying a batch of usage reports from a host to the coordinator
+ *
+ * Each record has a fixed width of 12 bytes: tenant id, flow id and
+ * the usage quantized to USAGE_QUANTUM bps. A report that doesn't fit
+ * into one packet is split into several segments; each segment carries the
+ * id of the report and its index and the number of segments sent to the
+ * same coordinator, so that the receiver can tell when it has all of them
+ * even if they are reordered.
+ */
+class BwmUsageReportHeader : public Header
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+  BwmUsageReportHeader ();
+
+  /**
+   *  Sets the id of the reporting host
+   *  \param hostId Id of the host
+   */
+  void SetHostId (uint32_t hostId);
+  /**
+   *  Gets the id of the reporting host
+   *  \returns the host id
+   */
+  uint32_t GetHostId (void) const;
+  /**
+   *  Sets the id of the report, increasing with every report of a host
+   *  \param reportId Id of the report
+   */
+  void SetReportId (uint32_t reportId);
+  /**
+   *  \returns the id of the report
+   */
+  uint32_t GetReportId (void) const;
+  /**
+   *  Sets the position of this segment among the segments of the report
+   *  sent to the same coordinator
+   *  \param index Index of the segment, below count
+   *  \param count Number of segments
+   */
+  void SetSegment (uint16_t index, uint16_t count);
+  /**
+   *  \returns the index of the segment
+   */
+  uint16_t GetSegmentIndex (void) const;
+  /**
+   *  \returns the number of segments sent to the same coordinator
+   */
+  uint16_t GetSegmentCount (void) const;
+  /**
+   *  Marks whether the receiver replies a new target status once it has all segments
+   *  \param reply true if a reply is requested
+   */
+  void SetReplyRequested (bool reply);
+  /**
+   *  \returns true if a reply is requested
+   */
+  bool IsReplyRequested (void) const;
+  /**
+   *  Appends a usage record, the usage is quantized to USAGE_QUANTUM
+   *  \param tenantId Id of the tenant of the unit flow
+   *  \param flowId Id of the unit flow
+   *  \param usage Usage of the unit flow in bps
+   *  \returns false if the header is already full
+   */
+  bool AddRecord (uint32_t tenantId, uint32_t flowId, double usage);
+  /**
+   *  \returns the number of records
+   */
+  uint32_t GetNRecords (void) const;
+  /**
+   *  \param index Index of the record
+   *  \returns the tenant id of the record
+   */
+  uint32_t GetTenantId (uint32_t index) const;
+  /**
+   *  \param index Index of the record
+   *  \returns the flow id of the record
+   */
+  uint32_t GetFlowId (uint32_t index) const;
+  /**
+   *  \param index Index of the record
+   *  \returns the dequantized usage of the record in bps
+   */
+  double GetUsage (uint32_t index) const;
+
+  static const uint32_t USAGE_QUANTUM = 1000; //!< Resolution of the usage in bps
+  static const uint32_t MAX_RECORDS = 100; //!< Number of records that fit into a 1500 bytes packet
+  static const uint32_t RECORD_SIZE = 12; //!< Serialized size of a record in bytes
+
+private:
+  /**
+   * \brief A fixed-width usage record
+   */
+  struct Record
+  {
+    uint32_t tenantId; //!< Tenant id
+    uint32_t flowId; //!< Unit flow id
+    uint32_t usage; //!< Usage in USAGE_QUANTUM
+  };
+
+  uint32_t m_hostId; //!< Id of the reporting host
+  uint32_t m_reportId; //!< Id of the report
+  uint16_t m_segmentIndex; //!< Index of the segment
+  uint16_t m_segmentCount; //!< Number of segments sent to the same coordinator
+  bool m_replyRequested; //!< Whether the receiver replies once it has all segments
+  std::vector<Record> m_records; //!< Usage records
+};
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief A header carrying a new target status from the coordinator to a host
+ */
+class BwmTargetStatusHeader : public Header
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+  BwmTargetStatusHeader ();
+
+  /**
+   *  Sets the target status, ie the fair share shared by all tenants
+   *  \param targetStatus The new target status
+   */
+  void SetTargetStatus (double targetStatus);
+  /**
+   *  \returns the target status
+   */
+  double GetTargetStatus (void) const;
+
+private:
+  double m_targetStatus; //!< The new target status
+};
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief A header carrying a batch of CAWC congestion factors from a receiver to a sender host
+ *
+ * Each record has a fixed width of 8 bytes: the trace id of the unit flow
+ * and the bit pattern of its congestion factor as a float. The receiver
+ * sends such a header instead of one 4-byte feedback packet per unit flow
+ * when feedback coalescing is enabled.
+ */
+class BwmCongestionFeedbackHeader : public Header
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+  BwmCongestionFeedbackHeader ();
+
+  /**
+   *  Appends a congestion factor record
+   *  \param traceId Trace id of the unit flow
+   *  \param factor Congestion factor of the unit flow
+   *  \returns false if the header is already full
+   */
+  bool AddRecord (uint32_t traceId, float factor);
+  /**
+   *  \returns the number of records
+   */
+  uint32_t GetNRecords (void) const;
+  /**
+   *  \param index Index of the record
+   *  \returns the trace id of the record
+   */
+  uint32_t GetTraceId (uint32_t index) const;
+  /**
+   *  \param index Index of the record
+   *  \returns the congestion factor of the record
+   */
+  float GetFactor (uint32_t index) const;
+
+  static const uint32_t MAX_RECORDS = 180; //!< Number of records that fit into a 1500 bytes packet
+  static const uint32_t RECORD_SIZE = 8; //!< Serialized size of a record in bytes
+
+private:
+  /**
+   * \brief A fixed-width congestion factor record
+   */
+  struct Record
+  {
+    uint32_t traceId; //!< Trace id of the unit flow
+    float factor; //!< Congestion factor
+  };
+
+  std::vector<Record> m_records; //!< Congestion factor records
+};
+
+} // namespace ns3
+
+#endif /* BWM_CONTROL_HEADER_H */
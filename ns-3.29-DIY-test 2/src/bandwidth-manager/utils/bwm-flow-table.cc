@@ -0,0 +1,133 @@
+#include "bwm-flow-table.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BwmFlowTable");
+
+BwmFlowTable::BwmFlowTable ()
+  : m_mask (0),
+    m_size (0)
+{
+  Rehash (16);
+}
+
+void
+BwmFlowTable::Reserve (uint32_t flowNum)
+{
+  uint32_t capacity = m_mask + 1;
+  while (capacity / 8 * 7 < flowNum)
+    {
+      capacity <<= 1;
+    }
+  if (capacity != m_mask + 1)
+    {
+      Rehash (capacity);
+    }
+}
+
+BwmQueueDiscClass*
+BwmFlowTable::Find (uint32_t flowId, uint32_t tenantId) const
+{
+  uint32_t pos = flowId & m_mask;
+  for (uint32_t distance = 1; ; distance++)
+    {
+      const Slot &slot = m_slots[pos];
+      if (slot.distance < distance)
+        {
+          // an empty slot or a flow closer to its home, the flow can't be further
+          return NULL;
+        }
+      if (slot.flowId == flowId && slot.tenantId == tenantId)
+        {
+          return slot.qDiscClass;
+        }
+      pos = (pos + 1) & m_mask;
+    }
+}
+
+void
+BwmFlowTable::Insert (uint32_t flowId, uint32_t tenantId, BwmQueueDiscClass *qDiscClass)
+{
+  if ((m_size + 1) > (m_mask + 1) / 8 * 7)
+    {
+      Rehash ((m_mask + 1) << 1);
+    }
+
+  Slot entry = {flowId, tenantId, 1, qDiscClass};
+  uint32_t pos = flowId & m_mask;
+  while (m_slots[pos].distance != 0)
+    {
+      if (m_slots[pos].distance < entry.distance)
+        {
+          // take the slot from the richer flow and carry it on
+          std::swap (m_slots[pos], entry);
+        }
+      pos = (pos + 1) & m_mask;
+      entry.distance++;
+    }
+  m_slots[pos] = entry;
+  m_size++;
+}
+
+bool
+BwmFlowTable::Erase (uint32_t flowId, const BwmQueueDiscClass *qDiscClass)
+{
+  uint32_t pos = flowId & m_mask;
+  for (uint32_t distance = 1; m_slots[pos].qDiscClass != qDiscClass; distance++)
+    {
+      if (m_slots[pos].distance < distance)
+        {
+          return false;
+        }
+      pos = (pos + 1) & m_mask;
+    }
+
+  // shift the following displaced flows one slot back towards their homes
+  uint32_t next = (pos + 1) & m_mask;
+  while (m_slots[next].distance > 1)
+    {
+      m_slots[pos] = m_slots[next];
+      m_slots[pos].distance--;
+      pos = next;
+      next = (next + 1) & m_mask;
+    }
+  m_slots[pos].distance = 0;
+  m_slots[pos].qDiscClass = NULL;
+  m_size--;
+  return true;
+}
+
+uint32_t
+BwmFlowTable::GetSize (void) const
+{
+  return m_size;
+}
+
+uint32_t
+BwmFlowTable::GetCapacity (void) const
+{
+  return m_mask + 1;
+}
+
+void
+BwmFlowTable::Rehash (uint32_t capacity)
+{
+  NS_LOG_DEBUG ("Resize the flow table from " << m_slots.size () << " to " << capacity << " slots");
+
+  std::vector<Slot> oldSlots (capacity, Slot {0, 0, 0, NULL});
+  oldSlots.swap (m_slots);
+  m_mask = capacity - 1;
+  m_size = 0;
+  for (auto &slot : oldSlots)
+    {
+      if (slot.distance != 0)
+        {
+          Insert (slot.flowId, slot.tenantId, slot.qDiscClass);
+        }
+    }
+}
+
+}
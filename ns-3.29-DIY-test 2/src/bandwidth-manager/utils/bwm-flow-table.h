@@ -0,0 +1,88 @@
+#ifndef BWM_FLOW_TABLE_H
+#define BWM_FLOW_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+class BwmQueueDiscClass;
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief An open-addressing table from unit flows to queue disc classes
+ *
+ * Flow id, tenant id and class pointer of a unit flow are kept together in
+ * one slot of a flat array. Collisions are resolved by Robin Hood linear
+ * probing with backward-shift deletion, so lookups touch few adjacent slots
+ * and no tombstones accumulate. The table doubles once it is 7/8 full.
+ *
+ * The table doesn't own the classes, they are held by the queue disc.
+ */
+class BwmFlowTable
+{
+public:
+  BwmFlowTable ();
+
+  /**
+   *  Makes room for a number of flows without growing
+   *  \param flowNum the expected number of flows
+   */
+  void Reserve (uint32_t flowNum);
+  /**
+   *  Looks up the class of a unit flow
+   *  \param flowId Id of the unit flow
+   *  \param tenantId Id of the tenant of the unit flow
+   *  \returns the class, or NULL if the flow is unknown
+   */
+  BwmQueueDiscClass* Find (uint32_t flowId, uint32_t tenantId) const;
+  /**
+   *  Inserts a unit flow that is not in the table yet
+   *  \param flowId Id of the unit flow
+   *  \param tenantId Id of the tenant of the unit flow
+   *  \param qDiscClass the class of the unit flow
+   */
+  void Insert (uint32_t flowId, uint32_t tenantId, BwmQueueDiscClass *qDiscClass);
+  /**
+   *  Removes the slot holding a class
+   *  \param flowId Id of the unit flow the class was inserted with
+   *  \param qDiscClass the class to remove
+   *  \returns false if the class is not in the table
+   */
+  bool Erase (uint32_t flowId, const BwmQueueDiscClass *qDiscClass);
+  /**
+   *  \returns the number of flows in the table
+   */
+  uint32_t GetSize (void) const;
+  /**
+   *  \returns the number of slots of the table
+   */
+  uint32_t GetCapacity (void) const;
+
+private:
+  /**
+   * \brief A slot of the table
+   */
+  struct Slot
+  {
+    uint32_t flowId;                //!< Id of the unit flow
+    uint32_t tenantId;              //!< Id of the tenant of the unit flow
+    uint32_t distance;              //!< 1 + distance from the home slot, 0 if empty
+    BwmQueueDiscClass *qDiscClass;  //!< The class of the unit flow
+  };
+
+  /**
+   *  Resizes the table and re-inserts all flows
+   *  \param capacity the new number of slots, a power of two
+   */
+  void Rehash (uint32_t capacity);
+
+  std::vector<Slot> m_slots; //!< The slots, the number of them is a power of two
+  uint32_t m_mask;           //!< Number of slots - 1
+  uint32_t m_size;           //!< Number of flows in the table
+};
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include "bwm-local-flow-store.h"
+#include "ns3/log.h"
+#include "ns3/bwm-coordinator.h"
+#include "ns3/bwm-queue-disc.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BwmLocalFlowStore");
+
+BwmLocalFlowStore::BwmLocalFlowStore ()
+  : m_size (0)
+{
+}
+
+BwmLocalFlowStore::~BwmLocalFlowStore ()
+{
+}
+
+BwmLocalFlowStore::Entry*
+BwmLocalFlowStore::Insert (Ptr<UnitFlow> flow, Ptr<BwmQueueDiscClass> qDiscClass, uint32_t device)
+{
+  uint32_t tenantId = flow->GetTenantId ();
+  auto tenant = m_tenantIndex.find (tenantId);
+  if (tenant == m_tenantIndex.end ())
+    {
+      tenant = m_tenantIndex.insert (std::make_pair (tenantId, (uint32_t)m_groups.size ())).first;
+      m_groups.push_back (TenantGroup ());
+      m_groups.back ().tenantId = tenantId;
+    }
+
+  Location location;
+  location.group = tenant->second;
+  std::vector<Entry> &entries = m_groups[location.group].entries;
+  location.index = entries.size ();
+  Entry entry;
+  entry.flow = flow;
+  entry.qDiscClass = qDiscClass;
+  entry.device = device;
+  entries.push_back (entry);
+
+  // trace ids identify unit flows in the whole network, a duplicate would shadow its twin
+  if (!m_traceIndex.insert (std::make_pair (flow->GetTraceId (), location)).second)
+    {
+      NS_LOG_WARN ("Duplicate trace id " << flow->GetTraceId ());
+    }
+  m_size++;
+  return &entries.back ();
+}
+
+BwmLocalFlowStore::Entry*
+BwmLocalFlowStore::FindByTraceId (uint32_t traceId)
+{
+  auto it = m_traceIndex.find (traceId);
+  if (it == m_traceIndex.end ())
+    {
+      return NULL;
+    }
+  return &m_groups[it->second.group].entries[it->second.index];
+}
+
+BwmLocalFlowStore::TenantGroup*
+BwmLocalFlowStore::GetTenantGroup (uint32_t tenantId)
+{
+  auto it = m_tenantIndex.find (tenantId);
+  if (it == m_tenantIndex.end ())
+    {
+      return NULL;
+    }
+  return &m_groups[it->second];
+}
+
+void
+BwmLocalFlowStore::EraseAt (uint32_t group, uint32_t index)
+{
+  NS_ASSERT (group < m_groups.size () && index < m_groups[group].entries.size ());
+  std::vector<Entry> &entries = m_groups[group].entries;
+  Ptr<UnitFlow> flow = entries[index].flow;
+
+  auto trace = m_traceIndex.find (flow->GetTraceId ());
+  if (trace != m_traceIndex.end () && trace->second.group == group && trace->second.index == index)
+    {
+      m_traceIndex.erase (trace);
+    }
+
+  // fill the hole with the last entry of the tenant
+  uint32_t last = entries.size () - 1;
+  if (index != last)
+    {
+      entries[index] = entries[last];
+      Ptr<UnitFlow> moved = entries[index].flow;
+      trace = m_traceIndex.find (moved->GetTraceId ());
+      if (trace != m_traceIndex.end () && trace->second.group == group && trace->second.index == last)
+        {
+          trace->second.index = index;
+        }
+    }
+  entries.pop_back ();
+  m_size--;
+}
+
+uint32_t
+BwmLocalFlowStore::GetNGroups (void) const
+{
+  return m_groups.size ();
+}
+
+BwmLocalFlowStore::TenantGroup&
+BwmLocalFlowStore::GetGroup (uint32_t group)
+{
+  return m_groups[group];
+}
+
+uint32_t
+BwmLocalFlowStore::GetSize (void) const
+{
+  return m_size;
+}
+
+void
+BwmLocalFlowStore::Clear (void)
+{
+  m_groups.clear ();
+  m_tenantIndex.clear ();
+  m_traceIndex.clear ();
+  m_size = 0;
+}
+
+}
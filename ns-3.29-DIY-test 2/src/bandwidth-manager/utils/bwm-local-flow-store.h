@@ -0,0 +1,113 @@
+#ifndef BWM_LOCAL_FLOW_STORE_H
+#define BWM_LOCAL_FLOW_STORE_H
+
+#include "ns3/ptr.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+class UnitFlow;
+class BwmQueueDiscClass;
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief The unit flows of a local agent, grouped by tenant
+ *
+ * Each tenant keeps its unit flows in one contiguous array, so sibling
+ * operations and periodic passes walk adjacent entries. A hash index maps the
+ * trace ids carried in the packets to the position of an entry.
+ * Erasing moves the last entry of the tenant into the hole, so positions
+ * are only stable until the next erase of the same tenant.
+ */
+class BwmLocalFlowStore
+{
+public:
+  /**
+   * \brief A unit flow and the queue disc class enforcing its rate
+   */
+  struct Entry
+  {
+    Ptr<UnitFlow> flow;                   //!< The unit flow
+    Ptr<BwmQueueDiscClass> qDiscClass;    //!< The class of the unit flow
+    uint32_t device;                      //!< Index of the device the unit flow leaves by
+  };
+
+  /**
+   * \brief The unit flows of one tenant
+   */
+  struct TenantGroup
+  {
+    uint32_t tenantId;            //!< Id of the tenant
+    std::vector<Entry> entries;   //!< The unit flows, in insertion order until one is erased
+  };
+
+  BwmLocalFlowStore ();
+  ~BwmLocalFlowStore ();
+
+  /**
+   *  Adds a unit flow to the group of its tenant
+   *  \param flow the unit flow
+   *  \param qDiscClass the class of the unit flow
+   *  \param device index of the device the unit flow leaves by
+   *  \returns the new entry, valid until the next insert or erase
+   */
+  Entry* Insert (Ptr<UnitFlow> flow, Ptr<BwmQueueDiscClass> qDiscClass, uint32_t device);
+  /**
+   *  Looks up a unit flow by the trace id carried in its packets
+   *  \param traceId the trace id
+   *  \returns the entry, or NULL if no unit flow has the trace id
+   */
+  Entry* FindByTraceId (uint32_t traceId);
+  /**
+   *  Looks up the unit flows of a tenant
+   *  \param tenantId Id of the tenant
+   *  \returns the group, or NULL if the tenant never had a unit flow here
+   */
+  TenantGroup* GetTenantGroup (uint32_t tenantId);
+  /**
+   *  Removes a unit flow, the last entry of its tenant takes its position
+   *  \param group index of the tenant group
+   *  \param index position of the entry in the group
+   */
+  void EraseAt (uint32_t group, uint32_t index);
+  /**
+   *  \returns the number of tenant groups, including emptied ones
+   */
+  uint32_t GetNGroups (void) const;
+  /**
+   *  \param group index of the tenant group
+   *  \returns the tenant group
+   */
+  TenantGroup& GetGroup (uint32_t group);
+  /**
+   *  \returns the number of unit flows
+   */
+  uint32_t GetSize (void) const;
+  /**
+   *  Removes all unit flows and tenant groups
+   */
+  void Clear (void);
+
+private:
+  /**
+   * \brief The position of an entry
+   */
+  struct Location
+  {
+    uint32_t group;   //!< Index of the tenant group
+    uint32_t index;   //!< Position in the group
+  };
+
+  std::vector<TenantGroup> m_groups;                          //!< The tenant groups in order of appearance
+  std::unordered_map<uint32_t, uint32_t> m_tenantIndex;       //!< Tenant id to tenant group
+  std::unordered_map<uint32_t, Location> m_traceIndex;        //!< Trace id to entry
+  uint32_t m_size;                                            //!< Number of unit flows
+};
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+#include "bwm-profiler.h"
+
+namespace ns3 {
+
+bool BwmProfiler::s_enabled = false;
+BwmProfiler::Component BwmProfiler::s_current = BwmProfiler::NONE;
+std::chrono::steady_clock::time_point BwmProfiler::s_lastSwitch;
+int64_t BwmProfiler::s_elapsed[BwmProfiler::COMPONENT_NUM] = {0};
+
+void
+BwmProfiler::Enable (bool enable)
+{
+  s_enabled = enable;
+  s_current = NONE;
+  s_lastSwitch = std::chrono::steady_clock::now ();
+  if (enable)
+    {
+      for (uint32_t i = 0; i < COMPONENT_NUM; i++)
+        {
+          s_elapsed[i] = 0;
+        }
+    }
+}
+
+double
+BwmProfiler::GetSeconds (Component component)
+{
+  return s_elapsed[component] * 1e-9;
+}
+
+BwmProfiler::Component
+BwmProfiler::Switch (Component component)
+{
+  auto now = std::chrono::steady_clock::now ();
+  s_elapsed[s_current] += std::chrono::duration_cast<std::chrono::nanoseconds> (now - s_lastSwitch).count ();
+  s_lastSwitch = now;
+  Component previous = s_current;
+  s_current = component;
+  return previous;
+}
+
+}
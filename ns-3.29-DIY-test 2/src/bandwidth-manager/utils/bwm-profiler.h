@@ -0,0 +1,94 @@
+#ifndef BWM_PROFILER_H
+#define BWM_PROFILER_H
+
+#include <stdint.h>
+#include <chrono>
+
+namespace ns3 {
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief Wall-clock time spent in the components of the bandwidth manager
+ *
+ * Entry points of the coordinator, the local agents and the queue discs open
+ * a Scope of their component. Time is charged exclusively: when a scope is
+ * entered from another one, for example a queue disc registering a unit flow
+ * at its agent, the time of the inner scope is not charged to the outer one.
+ * The profiler is disabled by default, then a scope costs one branch. It is
+ * meant for the simulator thread only.
+ */
+class BwmProfiler
+{
+public:
+  /**
+   * \brief The profiled components
+   */
+  enum Component
+  {
+    NONE,           //!< Outside of any bandwidth manager code
+    COORDINATOR,    //!< The coordinator and its tenants
+    AGENT,          //!< The local agents
+    QDISC,          //!< The bandwidth manager queue discs
+    COMPONENT_NUM   //!< The number of components
+  };
+
+  /**
+   * \brief Charges the time until its destruction to a component
+   */
+  class Scope
+  {
+  public:
+    /**
+     *  \param component the component running in this scope
+     */
+    Scope (Component component)
+      : m_active (s_enabled),
+        m_previous (NONE)
+    {
+      if (m_active)
+        {
+          m_previous = Switch (component);
+        }
+    }
+    ~Scope ()
+    {
+      if (m_active)
+        {
+          Switch (m_previous);
+        }
+    }
+
+  private:
+    bool m_active;            //!< Whether the profiler was enabled when the scope opened
+    Component m_previous;     //!< The component of the enclosing scope
+  };
+
+  /**
+   *  Enables or disables the profiler, enabling resets the accumulated times
+   *  \param enable whether to profile
+   */
+  static void Enable (bool enable);
+  /**
+   *  \param component the component
+   *  \returns the seconds charged to the component since the profiler was enabled
+   */
+  static double GetSeconds (Component component);
+
+private:
+  /**
+   *  Charges the time since the last switch to the current component and makes another one current
+   *  \param component the new current component
+   *  \returns the previous current component
+   */
+  static Component Switch (Component component);
+
+  static bool s_enabled;                                          //!< Whether the profiler is enabled
+  static Component s_current;                                     //!< The running component
+  static std::chrono::steady_clock::time_point s_lastSwitch;     //!< When the running component started
+  static int64_t s_elapsed[COMPONENT_NUM];                        //!< Nanoseconds charged to each component
+};
+
+}
+
+#endif
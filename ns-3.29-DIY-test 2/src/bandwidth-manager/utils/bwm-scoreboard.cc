@@ -0,0 +1,196 @@
+#include "bwm-scoreboard.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BwmScoreboard");
+
+BwmScoreboard::BwmScoreboard ()
+  : m_shift (32),
+    m_cycle (1)
+{
+  Rehash (16);
+}
+
+uint32_t
+BwmScoreboard::Home (uint32_t flowId) const
+{
+  // trace ids are mostly consecutive, spread them with Fibonacci hashing
+  return (flowId * 0x9e3779b9U) >> m_shift;
+}
+
+BwmScoreboard::Line*
+BwmScoreboard::Find (uint32_t flowId)
+{
+  uint32_t mask = m_slots.size () - 1;
+  for (uint32_t pos = Home (flowId); m_slots[pos] != 0; pos = (pos + 1) & mask)
+    {
+      Line &line = m_lines[m_slots[pos] - 1];
+      if (line.flowId == flowId)
+        {
+          return &line;
+        }
+    }
+  return NULL;
+}
+
+bool
+BwmScoreboard::Insert (uint32_t flowId, uint32_t srcIp)
+{
+  if (Find (flowId) != NULL)
+    {
+      return false;
+    }
+  if (GetSize () + 1 > m_slots.size () / 8 * 7)
+    {
+      Rehash (m_slots.size () << 1);
+    }
+
+  // cycle 0 is never current, the new line is in no wheel slot
+  Line line = {flowId, srcIp, 0, 0, 0, 0, 0, 0, false, true};
+  uint32_t index;
+  if (m_free.empty ())
+    {
+      index = m_lines.size ();
+      m_lines.push_back (line);
+    }
+  else
+    {
+      index = m_free.back ();
+      m_free.pop_back ();
+      m_lines[index] = line;
+    }
+  uint32_t mask = m_slots.size () - 1;
+  uint32_t pos = Home (flowId);
+  while (m_slots[pos] != 0)
+    {
+      pos = (pos + 1) & mask;
+    }
+  m_slots[pos] = index + 1;
+  return true;
+}
+
+void
+BwmScoreboard::Remove (uint32_t index)
+{
+  NS_ASSERT (index < m_lines.size () && m_lines[index].used);
+  NS_ASSERT (m_lines[index].cycle != m_cycle);
+
+  uint32_t mask = m_slots.size () - 1;
+  uint32_t hole = Home (m_lines[index].flowId);
+  while (m_slots[hole] != index + 1)
+    {
+      hole = (hole + 1) & mask;
+    }
+
+  // shift the following lines of the probe sequence back, each one moves into
+  // the hole unless that would put it before its home slot
+  for (uint32_t pos = (hole + 1) & mask; m_slots[pos] != 0; pos = (pos + 1) & mask)
+    {
+      uint32_t home = Home (m_lines[m_slots[pos] - 1].flowId);
+      if (((pos - home) & mask) >= ((pos - hole) & mask))
+        {
+          m_slots[hole] = m_slots[pos];
+          hole = pos;
+        }
+    }
+  m_slots[hole] = 0;
+
+  m_lines[index].used = false;
+  m_free.push_back (index);
+}
+
+void
+BwmScoreboard::Touch (Line *line)
+{
+  if (line->cycle != m_cycle)
+    {
+      line->cycle = m_cycle;
+      m_modified.push_back (GetIndex (line));
+    }
+}
+
+const std::vector<uint32_t>&
+BwmScoreboard::GetModified (void) const
+{
+  return m_modified;
+}
+
+const std::vector<uint32_t>&
+BwmScoreboard::GetExpiring (void) const
+{
+  return m_expiring;
+}
+
+BwmScoreboard::Line&
+BwmScoreboard::GetLine (uint32_t index)
+{
+  return m_lines[index];
+}
+
+uint32_t
+BwmScoreboard::GetIndex (const Line *line) const
+{
+  return line - &m_lines[0];
+}
+
+uint32_t
+BwmScoreboard::GetCycle (void) const
+{
+  return m_cycle;
+}
+
+void
+BwmScoreboard::NextCycle (void)
+{
+  m_expiring.swap (m_modified);
+  m_modified.clear ();
+  m_cycle++;
+  if (m_cycle == 0)
+    {
+      // skip the cycle of the untouched lines on wrap-around
+      m_cycle = 1;
+    }
+}
+
+uint32_t
+BwmScoreboard::GetSize (void) const
+{
+  return m_lines.size () - m_free.size ();
+}
+
+uint32_t
+BwmScoreboard::GetCapacity (void) const
+{
+  return m_lines.size ();
+}
+
+void
+BwmScoreboard::Rehash (uint32_t capacity)
+{
+  NS_LOG_DEBUG ("Resize the scoreboard index from " << m_slots.size () << " to " << capacity << " slots");
+
+  m_slots.assign (capacity, 0);
+  m_shift = 32;
+  while ((1U << (32 - m_shift)) < capacity)
+    {
+      m_shift--;
+    }
+  uint32_t mask = capacity - 1;
+  for (uint32_t i = 0; i < m_lines.size (); i++)
+    {
+      if (!m_lines[i].used)
+        {
+          continue;
+        }
+      uint32_t pos = Home (m_lines[i].flowId);
+      while (m_slots[pos] != 0)
+        {
+          pos = (pos + 1) & mask;
+        }
+      m_slots[pos] = i + 1;
+    }
+}
+
+}
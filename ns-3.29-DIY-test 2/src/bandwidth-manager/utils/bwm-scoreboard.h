@@ -0,0 +1,130 @@
+#ifndef BWM_SCOREBOARD_H
+#define BWM_SCOREBOARD_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief The CAWC receiver scoreboard of the incoming unit flows
+ *
+ * The lines are fixed-width records in one dense array, and an
+ * open-addressing index with linear probing maps flow ids to them. A removed
+ * line leaves the index by backward-shift deletion and goes to a free list,
+ * the next inserted line takes its place, so the array and the index only
+ * grow with the number of flows seen at the same time.
+ *
+ * Aging runs on a two-slot timing wheel with one slot per check cycle: the
+ * lines modified in the current cycle and those modified in the previous
+ * one. A line that is not modified again expires one cycle later, so a
+ * check only visits the lines of these two slots and never the idle ones.
+ */
+class BwmScoreboard
+{
+public:
+  /**
+   * \brief A scoreboard line of an incoming unit flow
+   */
+  struct Line
+  {
+    uint32_t flowId;          //!< Id carried in the flow id tag of the unit flow
+    uint32_t srcIp;           //!< Source IP address of the unit flow
+    uint32_t samples;         //!< Sample counter since the last feedback
+    uint32_t cycle;           //!< The check cycle of the last modification
+    uint64_t normalBytes;     //!< Bytes received without congestion mark
+    uint64_t ceBytes;         //!< Bytes received with congestion encountered
+    int64_t lastModified;     //!< Last modified time in ns
+    float pendingFactor;      //!< Congestion factor waiting for a coalesced feedback
+    bool feedbackPending;     //!< Whether pendingFactor waits for the next feedback
+    bool used;                //!< Whether the line belongs to a unit flow or is free
+  };
+
+  BwmScoreboard ();
+
+  /**
+   *  Looks up the line of a unit flow
+   *  \param flowId Id of the unit flow
+   *  \returns the line, or NULL if the flow has no line
+   */
+  Line* Find (uint32_t flowId);
+  /**
+   *  Adds a cleared line for a unit flow without one
+   *  \param flowId Id of the unit flow
+   *  \param srcIp source IP address of the unit flow
+   *  \returns false if the flow already has a line
+   */
+  bool Insert (uint32_t flowId, uint32_t srcIp);
+  /**
+   *  Frees a line, its index is reused by the next inserted line. The line
+   *  must not be in the wheel slot of the current cycle.
+   *  \param index the index of the line
+   */
+  void Remove (uint32_t index);
+  /**
+   *  Records that a line was modified in the current cycle
+   *  \param line the line
+   */
+  void Touch (Line *line);
+  /**
+   *  \returns the indexes of the lines modified in the current cycle
+   */
+  const std::vector<uint32_t>& GetModified (void) const;
+  /**
+   *  \returns the indexes of the lines modified in the previous cycle, some
+   *  of them may have been modified again in the current cycle
+   */
+  const std::vector<uint32_t>& GetExpiring (void) const;
+  /**
+   *  \param index the index of a line
+   *  \returns the line
+   */
+  Line& GetLine (uint32_t index);
+  /**
+   *  \param line a line of the scoreboard
+   *  \returns the index of the line
+   */
+  uint32_t GetIndex (const Line *line) const;
+  /**
+   *  \returns the current check cycle
+   */
+  uint32_t GetCycle (void) const;
+  /**
+   *  Turns the wheel at the end of a check, the current cycle becomes the previous one
+   */
+  void NextCycle (void);
+  /**
+   *  \returns the number of lines in use
+   */
+  uint32_t GetSize (void) const;
+  /**
+   *  \returns the number of lines in use or free
+   */
+  uint32_t GetCapacity (void) const;
+
+private:
+  /**
+   *  \param flowId Id of a unit flow
+   *  \returns the home slot of the flow
+   */
+  uint32_t Home (uint32_t flowId) const;
+  /**
+   *  Resizes the index and re-inserts all lines
+   *  \param capacity the new number of slots, a power of two
+   */
+  void Rehash (uint32_t capacity);
+
+  std::vector<Line> m_lines;        //!< The lines, a free line keeps its place
+  std::vector<uint32_t> m_free;     //!< Indexes of the free lines
+  std::vector<uint32_t> m_slots;    //!< Index of the lines, 1 + line index or 0 if empty
+  uint32_t m_shift;                 //!< 32 - log2 of the number of slots
+  uint32_t m_cycle;                 //!< The current check cycle
+  std::vector<uint32_t> m_modified; //!< Wheel slot of the current cycle
+  std::vector<uint32_t> m_expiring; //!< Wheel slot of the previous cycle
+};
+
+}
+
+#endif
@@ -0,0 +1,412 @@
+#include "bwm-tenant-config.h"
+#include "ns3/log.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BwmTenantConfig");
+
+const uint32_t BwmTenantConfig::MAGIC;
+const uint32_t BwmTenantConfig::VERSION;
+
+namespace {
+
+/**
+ * A tenant read from a text configuration.
+ */
+struct TextTenant
+{
+  uint32_t tenantId;
+  std::vector<BwmTenantConfig::Vertex> vertices;
+  std::vector<BwmTenantConfig::HostWeight> weights;
+};
+
+/**
+ * Splits "a,b" into two numbers, the whole token must be consumed.
+ */
+bool
+ParsePair (const std::string &token, double &first, double &second)
+{
+  const char *str = token.c_str ();
+  char *end;
+  errno = 0;
+  first = std::strtod (str, &end);
+  if (end == str || *end != ',')
+    {
+      return false;
+    }
+  str = end + 1;
+  second = std::strtod (str, &end);
+  return end != str && *end == '\0' && errno == 0;
+}
+
+/**
+ * Parses a non-negative integer, the whole string must be consumed.
+ */
+bool
+ParseId (const std::string &str, uint32_t &id)
+{
+  char *end;
+  errno = 0;
+  unsigned long value = std::strtoul (str.c_str (), &end, 10);
+  if (str.empty () || str[0] == '-' || *end != '\0' || errno != 0 || value > UINT32_MAX)
+    {
+      return false;
+    }
+  id = value;
+  return true;
+}
+
+}
+
+BwmTenantConfig::BwmTenantConfig ()
+  : m_data (NULL),
+    m_size (0)
+{
+}
+
+BwmTenantConfig::~BwmTenantConfig ()
+{
+  Close ();
+}
+
+bool
+BwmTenantConfig::Open (std::string filePath, std::string &error)
+{
+  Close ();
+
+  int fd = open (filePath.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      error = "cannot open " + filePath + ": " + std::strerror (errno);
+      return false;
+    }
+  struct stat st;
+  if (fstat (fd, &st) != 0 || st.st_size == 0)
+    {
+      error = "cannot map an empty file " + filePath;
+      close (fd);
+      return false;
+    }
+  void *data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+    {
+      error = "cannot map " + filePath + ": " + std::strerror (errno);
+      return false;
+    }
+
+  m_data = static_cast<const uint8_t *> (data);
+  m_size = st.st_size;
+  if (!Validate (m_data, m_size, error))
+    {
+      Close ();
+      return false;
+    }
+  NS_LOG_INFO ("Mapped " << GetNTenants () << " tenants from " << filePath);
+  return true;
+}
+
+void
+BwmTenantConfig::Close (void)
+{
+  if (m_data != NULL)
+    {
+      munmap (const_cast<uint8_t *> (m_data), m_size);
+      m_data = NULL;
+      m_size = 0;
+    }
+}
+
+uint32_t
+BwmTenantConfig::GetNTenants (void) const
+{
+  if (m_data == NULL)
+    {
+      return 0;
+    }
+  return reinterpret_cast<const Header *> (m_data)->tenantNum;
+}
+
+const BwmTenantConfig::Entry*
+BwmTenantConfig::GetEntry (uint32_t index) const
+{
+  NS_ASSERT (index < GetNTenants ());
+  return reinterpret_cast<const Entry *> (m_data + sizeof (Header)) + index;
+}
+
+const BwmTenantConfig::Entry*
+BwmTenantConfig::Find (uint32_t tenantId) const
+{
+  if (m_data == NULL)
+    {
+      return NULL;
+    }
+  const Entry *begin = GetEntry (0);
+  const Entry *end = begin + GetNTenants ();
+  const Entry *it = std::lower_bound (begin, end, tenantId,
+                                      [] (const Entry &entry, uint32_t id) { return entry.tenantId < id; });
+  if (it == end || it->tenantId != tenantId)
+    {
+      return NULL;
+    }
+  return it;
+}
+
+const BwmTenantConfig::Vertex*
+BwmTenantConfig::GetVertices (const Entry *entry) const
+{
+  return reinterpret_cast<const Vertex *> (m_data + entry->offset);
+}
+
+const BwmTenantConfig::HostWeight*
+BwmTenantConfig::GetHostWeights (const Entry *entry) const
+{
+  return reinterpret_cast<const HostWeight *> (m_data + entry->offset + entry->vertexNum * sizeof (Vertex));
+}
+
+bool
+BwmTenantConfig::IsBinary (std::string filePath)
+{
+  std::ifstream fin (filePath, std::ios::binary);
+  uint32_t magic = 0;
+  fin.read (reinterpret_cast<char *> (&magic), sizeof (magic));
+  return fin.good () && magic == MAGIC;
+}
+
+bool
+BwmTenantConfig::Validate (const uint8_t *data, uint64_t size, std::string &error)
+{
+  std::ostringstream reason;
+  if (size < sizeof (Header))
+    {
+      error = "file too short for the header";
+      return false;
+    }
+  const Header *header = reinterpret_cast<const Header *> (data);
+  if (header->magic != MAGIC)
+    {
+      error = "bad magic, not a binary tenant configuration";
+      return false;
+    }
+  if (header->version != VERSION)
+    {
+      reason << "unsupported version " << header->version;
+      error = reason.str ();
+      return false;
+    }
+
+  uint64_t indexEnd = sizeof (Header) + static_cast<uint64_t> (header->tenantNum) * sizeof (Entry);
+  if (indexEnd > size)
+    {
+      reason << "index of " << header->tenantNum << " tenants exceeds the file";
+      error = reason.str ();
+      return false;
+    }
+
+  const Entry *entries = reinterpret_cast<const Entry *> (data + sizeof (Header));
+  for (uint32_t i = 0; i < header->tenantNum; i++)
+    {
+      const Entry &entry = entries[i];
+      reason << "tenant " << entry.tenantId << ": ";
+      if (i > 0 && entry.tenantId <= entries[i - 1].tenantId)
+        {
+          reason << "entries not sorted by unique tenant id";
+          error = reason.str ();
+          return false;
+        }
+      if (entry.vertexNum == 0)
+        {
+          reason << "no bandwidth function";
+          error = reason.str ();
+          return false;
+        }
+      uint64_t recordSize = static_cast<uint64_t> (entry.vertexNum) * sizeof (Vertex)
+        + static_cast<uint64_t> (entry.weightNum) * sizeof (HostWeight);
+      if (entry.offset % 8 != 0 || entry.offset < indexEnd || entry.offset > size || size - entry.offset < recordSize)
+        {
+          reason << "record out of the file";
+          error = reason.str ();
+          return false;
+        }
+
+      // the vertices extend the origin of a monotone function
+      const Vertex *vertices = reinterpret_cast<const Vertex *> (data + entry.offset);
+      Vertex last = {0, 0};
+      for (uint32_t v = 0; v < entry.vertexNum; v++)
+        {
+          if (!std::isfinite (vertices[v].fairShare) || !std::isfinite (vertices[v].bandwidth)
+              || vertices[v].fairShare < last.fairShare || vertices[v].bandwidth < last.bandwidth)
+            {
+              reason << "vertex " << v << " breaks a non-decreasing bandwidth function";
+              error = reason.str ();
+              return false;
+            }
+          last = vertices[v];
+        }
+
+      const HostWeight *weights = reinterpret_cast<const HostWeight *> (vertices + entry.vertexNum);
+      for (uint32_t w = 0; w < entry.weightNum; w++)
+        {
+          if (!std::isfinite (weights[w].weight) || weights[w].weight <= 0)
+            {
+              reason << "host " << weights[w].hostId << " has a non-positive weight";
+              error = reason.str ();
+              return false;
+            }
+        }
+      reason.str ("");
+    }
+  return true;
+}
+
+bool
+BwmTenantConfig::Convert (std::string textPath, std::string binaryPath, std::string &error)
+{
+  std::ifstream fin (textPath);
+  if (fin.fail ())
+    {
+      error = "cannot open " + textPath;
+      return false;
+    }
+
+  // parse the three lines of every tenant
+  std::vector<TextTenant> tenants;
+  std::string input;
+  uint32_t lineNum = 0;
+  std::ostringstream reason;
+  while (std::getline (fin, input) && input.length () > 0)
+    {
+      lineNum++;
+      TextTenant tenant;
+      if (!ParseId (input, tenant.tenantId))
+        {
+          reason << textPath << ":" << lineNum << ": invalid tenant id '" << input << "'";
+          error = reason.str ();
+          return false;
+        }
+
+      lineNum++;
+      std::getline (fin, input);
+      if (!ParseVertices (input, tenant.vertices, error))
+        {
+          reason << textPath << ":" << lineNum << ": " << error;
+          error = reason.str ();
+          return false;
+        }
+
+      lineNum++;
+      std::getline (fin, input);
+      if (!ParseHostWeights (input, tenant.weights, error))
+        {
+          reason << textPath << ":" << lineNum << ": " << error;
+          error = reason.str ();
+          return false;
+        }
+      tenants.push_back (tenant);
+    }
+  std::sort (tenants.begin (), tenants.end (),
+             [] (const TextTenant &left, const TextTenant &right) { return left.tenantId < right.tenantId; });
+
+  // lay the index out first, then the records
+  std::vector<uint8_t> data (sizeof (Header) + tenants.size () * sizeof (Entry));
+  Header header = {MAGIC, VERSION, static_cast<uint32_t> (tenants.size ()), 0};
+  std::memcpy (data.data (), &header, sizeof (header));
+  for (uint32_t i = 0; i < tenants.size (); i++)
+    {
+      const TextTenant &tenant = tenants[i];
+      Entry entry = {tenant.tenantId, static_cast<uint32_t> (tenant.vertices.size ()),
+                     static_cast<uint32_t> (tenant.weights.size ()), 0, data.size ()};
+      std::memcpy (data.data () + sizeof (Header) + i * sizeof (Entry), &entry, sizeof (entry));
+      const uint8_t *vertices = reinterpret_cast<const uint8_t *> (tenant.vertices.data ());
+      data.insert (data.end (), vertices, vertices + tenant.vertices.size () * sizeof (Vertex));
+      const uint8_t *weights = reinterpret_cast<const uint8_t *> (tenant.weights.data ());
+      data.insert (data.end (), weights, weights + tenant.weights.size () * sizeof (HostWeight));
+    }
+
+  // refuse to write what Open would reject
+  if (!Validate (data.data (), data.size (), error))
+    {
+      error = textPath + ": " + error;
+      return false;
+    }
+
+  std::ofstream fout (binaryPath, std::ios::binary | std::ios::trunc);
+  fout.write (reinterpret_cast<const char *> (data.data ()), data.size ());
+  if (!fout.good ())
+    {
+      error = "cannot write " + binaryPath;
+      return false;
+    }
+  return true;
+}
+
+bool
+BwmTenantConfig::ParseVertices (std::string line, std::vector<Vertex> &vertices, std::string &error)
+{
+  std::istringstream sin (line);
+  std::string token;
+  Vertex last = {0, 0};
+  for (uint32_t v = 0; sin >> token; v++)
+    {
+      Vertex vertex;
+      if (!ParsePair (token, vertex.fairShare, vertex.bandwidth))
+        {
+          error = "invalid vertex '" + token + "'";
+          return false;
+        }
+      if (!std::isfinite (vertex.fairShare) || !std::isfinite (vertex.bandwidth)
+          || vertex.fairShare < last.fairShare || vertex.bandwidth < last.bandwidth)
+        {
+          std::ostringstream reason;
+          reason << "vertex " << v << " breaks a non-decreasing bandwidth function";
+          error = reason.str ();
+          return false;
+        }
+      vertices.push_back (vertex);
+      last = vertex;
+    }
+  return true;
+}
+
+bool
+BwmTenantConfig::ParseHostWeights (std::string line, std::vector<HostWeight> &weights, std::string &error)
+{
+  std::istringstream sin (line);
+  std::string token;
+  while (sin >> token)
+    {
+      double hostId;
+      HostWeight weight;
+      if (!ParsePair (token, hostId, weight.weight) || hostId < 0 || hostId > UINT32_MAX || hostId != std::floor (hostId))
+        {
+          error = "invalid host weight '" + token + "'";
+          return false;
+        }
+      weight.hostId = hostId;
+      weight.reserved = 0;
+      if (!std::isfinite (weight.weight) || weight.weight <= 0)
+        {
+          std::ostringstream reason;
+          reason << "host " << weight.hostId << " has a non-positive weight";
+          error = reason.str ();
+          return false;
+        }
+      weights.push_back (weight);
+    }
+  return true;
+}
+
+}
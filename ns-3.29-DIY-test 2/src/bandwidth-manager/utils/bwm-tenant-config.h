@@ -0,0 +1,165 @@
+#ifndef BWM_TENANT_CONFIG_H
+#define BWM_TENANT_CONFIG_H
+
+#include "ns3/simple-ref-count.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief A read-only, memory-mapped binary tenant configuration
+ *
+ * The file starts with a Header, followed by one Entry per tenant sorted by
+ * tenant id, followed by the records of the tenants. The record of a tenant
+ * holds its bandwidth function as Vertex structs, then its host weight table
+ * as HostWeight structs. All fields are in host byte order and 8 byte aligned,
+ * so the records are used in place without any parsing. A tenant is found by
+ * a binary search over the entries, only the pages it touches are read.
+ *
+ * Convert writes this format from the text format read by
+ * BwmCoordinator::InputConfiguration, Open validates a file before use.
+ */
+class BwmTenantConfig : public SimpleRefCount<BwmTenantConfig>
+{
+public:
+  static const uint32_t MAGIC = 0x544d5742;   //!< "BWMT" in a little-endian file
+  static const uint32_t VERSION = 1;          //!< The version of the layout
+
+  /**
+   * \brief The start of the file
+   */
+  struct Header
+  {
+    uint32_t magic;       //!< MAGIC
+    uint32_t version;     //!< VERSION
+    uint32_t tenantNum;   //!< Number of entries
+    uint32_t reserved;    //!< Zero
+  };
+
+  /**
+   * \brief The index entry of a tenant
+   */
+  struct Entry
+  {
+    uint32_t tenantId;    //!< Id of the tenant
+    uint32_t vertexNum;   //!< Number of vertices of the bandwidth function, the origin excluded
+    uint32_t weightNum;   //!< Number of host weights
+    uint32_t reserved;    //!< Zero
+    uint64_t offset;      //!< File offset of the record of the tenant
+  };
+
+  /**
+   * \brief A vertex of a bandwidth function
+   */
+  struct Vertex
+  {
+    double fairShare;     //!< Fair share of the vertex
+    double bandwidth;     //!< Bandwidth of the vertex in bps
+  };
+
+  /**
+   * \brief The weight of a host
+   */
+  struct HostWeight
+  {
+    uint32_t hostId;      //!< Id of the host
+    uint32_t reserved;    //!< Zero
+    double weight;        //!< Weight of the host
+  };
+
+  BwmTenantConfig ();
+  ~BwmTenantConfig ();
+
+  /**
+   *  Maps a binary configuration and validates it, closing the current one first
+   *  \param filePath the file to map
+   *  \param error set to the reason of a failure
+   *  \returns false if the file cannot be mapped or is malformed
+   */
+  bool Open (std::string filePath, std::string &error);
+  /**
+   *  Unmaps the configuration
+   */
+  void Close (void);
+  /**
+   *  \returns the number of tenants of the configuration
+   */
+  uint32_t GetNTenants (void) const;
+  /**
+   *  \param index the index of an entry, smaller than GetNTenants
+   *  \returns the entry, in tenant id order
+   */
+  const Entry* GetEntry (uint32_t index) const;
+  /**
+   *  Looks up the entry of a tenant
+   *  \param tenantId the id of the tenant
+   *  \returns the entry, or NULL if the tenant isn't configured
+   */
+  const Entry* Find (uint32_t tenantId) const;
+  /**
+   *  \param entry an entry of this configuration
+   *  \returns the vertexNum vertices of the bandwidth function
+   */
+  const Vertex* GetVertices (const Entry *entry) const;
+  /**
+   *  \param entry an entry of this configuration
+   *  \returns the weightNum host weights
+   */
+  const HostWeight* GetHostWeights (const Entry *entry) const;
+
+  /**
+   *  Checks whether a file starts like a binary configuration
+   *  \param filePath the file to check
+   *  \returns true if the file starts with MAGIC
+   */
+  static bool IsBinary (std::string filePath);
+  /**
+   *  Checks the layout and the contents of a binary configuration
+   *  \param data the configuration
+   *  \param size the size of the configuration in bytes
+   *  \param error set to the first problem found
+   *  \returns false if the configuration is malformed
+   */
+  static bool Validate (const uint8_t *data, uint64_t size, std::string &error);
+  /**
+   *  Converts a text configuration into a binary one
+   *
+   *  The text format holds three lines per tenant: the tenant id, the vertices
+   *  of the bandwidth function as "fs,bw fs,bw ..." and the host weights as
+   *  "host,weight host,weight ...". An empty line ends the configuration.
+   *  \param textPath the text configuration
+   *  \param binaryPath the binary configuration to write
+   *  \param error set to the reason of a failure, with the line number
+   *  \returns false if the text is malformed or a file cannot be accessed
+   */
+  static bool Convert (std::string textPath, std::string binaryPath, std::string &error);
+  /**
+   *  Parses the bandwidth function line of a text configuration
+   *  \param line the vertices as "fs,bw fs,bw ..."
+   *  \param vertices the vertices to append to
+   *  \param error set to the first problem found
+   *  \returns false if a vertex is malformed or the function decreases
+   */
+  static bool ParseVertices (std::string line, std::vector<Vertex> &vertices, std::string &error);
+  /**
+   *  Parses the host weight line of a text configuration
+   *  \param line the host weights as "host,weight host,weight ..."
+   *  \param weights the host weights to append to
+   *  \param error set to the first problem found
+   *  \returns false if a host weight is malformed or not positive
+   */
+  static bool ParseHostWeights (std::string line, std::vector<HostWeight> &weights, std::string &error);
+
+private:
+  const uint8_t *m_data;    //!< The mapped file, NULL if none is open
+  uint64_t m_size;          //!< The size of the mapped file
+};
+
+}
+
+#endif
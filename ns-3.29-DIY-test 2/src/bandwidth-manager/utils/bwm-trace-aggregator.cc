@@ -0,0 +1,160 @@
+#include "bwm-trace-aggregator.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BwmTraceAggregator");
+
+NS_OBJECT_ENSURE_REGISTERED (BwmTraceAggregator);
+
+TypeId
+BwmTraceAggregator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BwmTraceAggregator")
+    .SetParent<Object> ()
+    .SetGroupName ("BandwidthManager")
+    .AddConstructor<BwmTraceAggregator> ()
+    .AddAttribute ("SampleInterval",
+                   "Time between two samples of the sources",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&BwmTraceAggregator::m_sampleInterval),
+                   MakeTimeChecker (NanoSeconds (1)))
+    .AddAttribute ("Interval",
+                   "Time between two summaries, rounded up to whole sample intervals",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&BwmTraceAggregator::m_interval),
+                   MakeTimeChecker (NanoSeconds (1)))
+    .AddTraceSource ("Summary",
+                     "The min, max, mean and last sample of a source in an interval",
+                     MakeTraceSourceAccessor (&BwmTraceAggregator::m_summaryTrace),
+                     "ns3::BwmTraceAggregator::SummaryTracedCallback")
+  ;
+  return tid;
+}
+
+BwmTraceAggregator::BwmTraceAggregator ()
+  : m_sampleInterval (MilliSeconds (10)),
+    m_interval (MilliSeconds (100))
+{
+}
+
+BwmTraceAggregator::~BwmTraceAggregator ()
+{
+}
+
+void
+BwmTraceAggregator::DoDispose (void)
+{
+  Simulator::Cancel (m_sampleEvent);
+  m_sources.clear ();
+  Object::DoDispose ();
+}
+
+void
+BwmTraceAggregator::AddSource (Ptr<Object> owner, Callback<double> sample, uint32_t id)
+{
+  AddSource (owner, sample, MakeBoundCallback (&BwmTraceAggregator::GetFixedId, id));
+}
+
+void
+BwmTraceAggregator::AddSource (Ptr<Object> owner, Callback<double> sample, Callback<uint32_t> id)
+{
+  Source source;
+  source.owner = owner;
+  source.sample = sample;
+  source.id = id;
+  source.sampleNum = 0;
+  source.min = source.max = source.sum = source.last = 0;
+  m_sources.push_back (source);
+
+  if (!m_sampleEvent.IsRunning ())
+    {
+      // the intervals start with the first source
+      m_nextReport = Simulator::Now () + m_interval;
+      m_sampleEvent = Simulator::Schedule (m_sampleInterval, &BwmTraceAggregator::Sample, this);
+    }
+}
+
+void
+BwmTraceAggregator::AddDataRateSource (Ptr<Object> owner, Callback<DataRate> sample, Callback<uint32_t> id)
+{
+  AddSource (owner, MakeBoundCallback (&BwmTraceAggregator::GetBitRate, sample), id);
+}
+
+void
+BwmTraceAggregator::RemoveSources (Ptr<Object> owner)
+{
+  m_sources.erase (std::remove_if (m_sources.begin (), m_sources.end (),
+                                   [owner] (const Source &source) { return source.owner == owner; }),
+                   m_sources.end ());
+  if (m_sources.empty ())
+    {
+      Simulator::Cancel (m_sampleEvent);
+    }
+}
+
+uint32_t
+BwmTraceAggregator::GetNSources (void) const
+{
+  return m_sources.size ();
+}
+
+void
+BwmTraceAggregator::Sample (void)
+{
+  for (auto &source : m_sources)
+    {
+      double value = source.sample ();
+      if (source.sampleNum == 0)
+        {
+          source.min = source.max = value;
+        }
+      else
+        {
+          source.min = std::min (source.min, value);
+          source.max = std::max (source.max, value);
+        }
+      source.sum += value;
+      source.last = value;
+      source.sampleNum++;
+    }
+
+  if (Simulator::Now () >= m_nextReport)
+    {
+      Report ();
+      m_nextReport += m_interval;
+    }
+  m_sampleEvent = Simulator::Schedule (m_sampleInterval, &BwmTraceAggregator::Sample, this);
+}
+
+void
+BwmTraceAggregator::Report (void)
+{
+  for (auto &source : m_sources)
+    {
+      if (source.sampleNum == 0)
+        {
+          continue;
+        }
+      m_summaryTrace (source.id (), source.min, source.max, source.sum / source.sampleNum, source.last);
+      source.sampleNum = 0;
+      source.sum = 0;
+    }
+}
+
+uint32_t
+BwmTraceAggregator::GetFixedId (uint32_t id)
+{
+  return id;
+}
+
+double
+BwmTraceAggregator::GetBitRate (Callback<DataRate> rate)
+{
+  return rate ().GetBitRate ();
+}
+
+}
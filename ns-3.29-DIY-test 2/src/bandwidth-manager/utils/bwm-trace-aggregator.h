@@ -0,0 +1,127 @@
+#ifndef BWM_TRACE_AGGREGATOR_H
+#define BWM_TRACE_AGGREGATOR_H
+
+#include "ns3/object.h"
+#include "ns3/callback.h"
+#include "ns3/data-rate.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief Samples traced values on a timer and reports them per interval
+ *
+ * A TracedValue like UnitFlow::m_usage changes with every report of every
+ * flow, and BwmQueueDiscClass::m_rate with every tuning pass, so a sink
+ * connected to them fires as often. The aggregator reads its sources
+ * through getters every SampleInterval instead and fires Summary once per
+ * Interval and source with the min, max, mean and last of the samples taken
+ * in that interval. Its cost grows with the simulated time and the number of
+ * sources, not with the number of packets; a change that is undone between
+ * two samples is not seen.
+ */
+class BwmTraceAggregator : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BwmTraceAggregator ();
+  ~BwmTraceAggregator ();
+
+  /**
+   *  Starts sampling a value
+   *  \param owner the object the value belongs to, used by RemoveSources
+   *  \param sample the getter of the value
+   *  \param id the id reported with the value
+   */
+  void AddSource (Ptr<Object> owner, Callback<double> sample, uint32_t id);
+  /**
+   *  As AddSource, with an id that is looked up whenever a summary is reported
+   */
+  void AddSource (Ptr<Object> owner, Callback<double> sample, Callback<uint32_t> id);
+  /**
+   *  Starts sampling a DataRate, reported in bps
+   */
+  void AddDataRateSource (Ptr<Object> owner, Callback<DataRate> sample, Callback<uint32_t> id);
+  /**
+   *  Stops sampling the values of an object, the samples of the current interval are dropped
+   *  \param owner the object given to AddSource
+   */
+  void RemoveSources (Ptr<Object> owner);
+  /**
+   *  \returns the number of sampled values
+   */
+  uint32_t GetNSources (void) const;
+
+  /**
+   * TracedCallback signature for the summary of a source.
+   *
+   * \param [in] id The id of the source.
+   * \param [in] min The smallest sample of the interval.
+   * \param [in] max The largest sample of the interval.
+   * \param [in] mean The mean of the samples of the interval.
+   * \param [in] last The last sample of the interval.
+   */
+  typedef void (* SummaryTracedCallback)
+    (uint32_t id, double min, double max, double mean, double last);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief A sampled value and the statistics of the current interval
+   */
+  struct Source
+  {
+    Ptr<Object> owner;            //!< The object the value belongs to
+    Callback<double> sample;      //!< The getter of the value
+    Callback<uint32_t> id;        //!< The getter of the reported id
+    uint32_t sampleNum;           //!< Number of samples in the interval
+    double min;                   //!< The smallest sample
+    double max;                   //!< The largest sample
+    double sum;                   //!< The sum of the samples
+    double last;                  //!< The last sample
+  };
+
+  /**
+   *  Samples every source and reports them at the end of an interval
+   */
+  void Sample (void);
+  /**
+   *  Fires Summary for the sources sampled in the interval and resets them
+   */
+  void Report (void);
+
+  /**
+   *  The id getter of a source with a fixed id
+   */
+  static uint32_t GetFixedId (uint32_t id);
+  /**
+   *  The getter of a DataRate source
+   */
+  static double GetBitRate (Callback<DataRate> rate);
+
+  Time m_sampleInterval;                  //!< Time between two samples
+  Time m_interval;                        //!< Time between two summaries
+  std::vector<Source> m_sources;          //!< The sampled values
+  EventId m_sampleEvent;                  //!< The next sample, pending while there are sources
+  Time m_nextReport;                      //!< The end of the current interval
+
+  TracedCallback<uint32_t, double, double, double, double> m_summaryTrace; //!< Trace of the summary of a source
+};
+
+}
+
+#endif
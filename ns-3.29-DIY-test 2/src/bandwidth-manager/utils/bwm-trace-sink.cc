@@ -0,0 +1,296 @@
+#include "bwm-trace-sink.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BwmTraceSink");
+
+NS_OBJECT_ENSURE_REGISTERED (BwmTraceSink);
+
+const uint32_t BwmTraceSink::MAGIC;
+const uint32_t BwmTraceSink::VERSION;
+
+TypeId
+BwmTraceSink::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BwmTraceSink")
+    .SetParent<Object> ()
+    .SetGroupName ("BandwidthManager")
+    .AddConstructor<BwmTraceSink> ()
+    .AddAttribute ("BufferSize",
+                   "Number of records buffered per stream before they are handed to the writer thread",
+                   UintegerValue (8192),
+                   MakeUintegerAccessor (&BwmTraceSink::m_bufferSize),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+BwmTraceSink::BwmTraceSink ()
+  : m_bufferSize (8192),
+    m_writing (false),
+    m_stopping (false)
+{
+}
+
+BwmTraceSink::~BwmTraceSink ()
+{
+  Close ();
+}
+
+void
+BwmTraceSink::DoDispose (void)
+{
+  Close ();
+  Object::DoDispose ();
+}
+
+uint32_t
+BwmTraceSink::AddStream (std::string filePath, uint32_t idNum, bool integral)
+{
+  NS_ASSERT (idNum == 1 || idNum == 2);
+  std::unique_ptr<Stream> stream (new Stream);
+  stream->file.open (filePath, std::ios::binary | std::ios::trunc);
+  if (stream->file.fail ())
+    {
+      NS_LOG_WARN ("Cannot open trace stream " << filePath);
+      return -1;
+    }
+  Header header = {MAGIC, VERSION, idNum, sizeof (Record), integral, 0};
+  stream->file.write (reinterpret_cast<const char *> (&header), sizeof (header));
+  stream->buffer.reserve (m_bufferSize);
+
+  std::lock_guard<std::mutex> lock (m_mutex);
+  if (!m_writer.joinable ())
+    {
+      m_stopping = false;
+      m_writer = std::thread (&BwmTraceSink::Work, this);
+    }
+  m_streams.push_back (std::move (stream));
+  return m_streams.size () - 1;
+}
+
+void
+BwmTraceSink::Write (uint32_t stream, double time, uint32_t id, double value)
+{
+  Write (stream, time, id, 0, value);
+}
+
+void
+BwmTraceSink::Write (uint32_t stream, double time, uint32_t id0, uint32_t id1, double value)
+{
+  if (m_streams.empty ())
+    {
+      // closed, a trace source may still fire while the simulation is torn down
+      return;
+    }
+  NS_ASSERT (stream < m_streams.size ());
+  Stream *target = m_streams[stream].get ();
+  target->buffer.push_back ({time, id0, id1, value});
+  if (target->buffer.size () >= m_bufferSize)
+    {
+      Submit (target);
+    }
+}
+
+void
+BwmTraceSink::Submit (Stream *stream)
+{
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_queue.push_back ({stream, std::move (stream->buffer)});
+    if (m_freeBuffers.empty ())
+      {
+        stream->buffer = std::vector<Record> ();
+      }
+    else
+      {
+        stream->buffer = std::move (m_freeBuffers.back ());
+        m_freeBuffers.pop_back ();
+      }
+  }
+  m_wake.notify_one ();
+  stream->buffer.reserve (m_bufferSize);
+}
+
+void
+BwmTraceSink::Flush (void)
+{
+  for (auto &stream : m_streams)
+    {
+      if (!stream->buffer.empty ())
+        {
+          Submit (stream.get ());
+        }
+    }
+
+  std::unique_lock<std::mutex> lock (m_mutex);
+  m_idle.wait (lock, [this] { return m_queue.empty () && !m_writing; });
+  for (auto &stream : m_streams)
+    {
+      stream->file.flush ();
+    }
+}
+
+void
+BwmTraceSink::Close (void)
+{
+  if (!m_writer.joinable ())
+    {
+      return;
+    }
+
+  Flush ();
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_one ();
+  m_writer.join ();
+  m_streams.clear ();
+  m_freeBuffers.clear ();
+}
+
+void
+BwmTraceSink::Work (void)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+  while (true)
+    {
+      m_wake.wait (lock, [this] { return m_stopping || !m_queue.empty (); });
+      if (m_queue.empty ())
+        {
+          // stopping, and Close flushed everything before
+          return;
+        }
+
+      Batch batch = std::move (m_queue.front ());
+      m_queue.pop_front ();
+      m_writing = true;
+      lock.unlock ();
+
+      batch.stream->file.write (reinterpret_cast<const char *> (batch.records.data ()),
+                                batch.records.size () * sizeof (Record));
+      batch.records.clear ();
+
+      lock.lock ();
+      m_freeBuffers.push_back (std::move (batch.records));
+      m_writing = false;
+      if (m_queue.empty ())
+        {
+          m_idle.notify_all ();
+        }
+    }
+}
+
+uint32_t
+BwmTraceSink::GetFixedId (uint32_t id)
+{
+  return id;
+}
+
+void
+BwmTraceSink::DoubleChanged (Ptr<BwmTraceSink> sink, uint32_t stream, Callback<uint32_t> id,
+                             double oldValue, double newValue)
+{
+  sink->Write (stream, Simulator::Now ().GetSeconds (), id (), newValue);
+}
+
+void
+BwmTraceSink::DataRateChanged (Ptr<BwmTraceSink> sink, uint32_t stream, Callback<uint32_t> id,
+                               DataRate oldValue, DataRate newValue)
+{
+  sink->Write (stream, Simulator::Now ().GetSeconds (), id (), (double)newValue.GetBitRate ());
+}
+
+bool
+BwmTraceSink::ConnectDouble (Ptr<Object> object, std::string traceName, uint32_t stream, uint32_t id)
+{
+  return ConnectDouble (object, traceName, stream, MakeBoundCallback (&BwmTraceSink::GetFixedId, id));
+}
+
+bool
+BwmTraceSink::ConnectDouble (Ptr<Object> object, std::string traceName, uint32_t stream, Callback<uint32_t> id)
+{
+  return object->TraceConnectWithoutContext (traceName, MakeBoundCallback (&BwmTraceSink::DoubleChanged,
+                                                                           Ptr<BwmTraceSink> (this), stream, id));
+}
+
+bool
+BwmTraceSink::ConnectDataRate (Ptr<Object> object, std::string traceName, uint32_t stream, uint32_t id)
+{
+  return ConnectDataRate (object, traceName, stream, MakeBoundCallback (&BwmTraceSink::GetFixedId, id));
+}
+
+bool
+BwmTraceSink::ConnectDataRate (Ptr<Object> object, std::string traceName, uint32_t stream, Callback<uint32_t> id)
+{
+  return object->TraceConnectWithoutContext (traceName, MakeBoundCallback (&BwmTraceSink::DataRateChanged,
+                                                                           Ptr<BwmTraceSink> (this), stream, id));
+}
+
+bool
+BwmTraceSink::ConvertToCsv (std::string binaryPath, std::string csvPath, std::string &error)
+{
+  std::ifstream fin (binaryPath, std::ios::binary);
+  if (fin.fail ())
+    {
+      error = "cannot open " + binaryPath;
+      return false;
+    }
+  Header header;
+  fin.read (reinterpret_cast<char *> (&header), sizeof (header));
+  if (!fin.good () || header.magic != MAGIC)
+    {
+      error = binaryPath + " is not a trace stream";
+      return false;
+    }
+  if (header.version != VERSION || header.recordSize != sizeof (Record) || (header.idNum != 1 && header.idNum != 2)
+      || header.integral > 1)
+    {
+      error = binaryPath + " has an unsupported layout";
+      return false;
+    }
+
+  std::ofstream fout (csvPath);
+  if (fout.fail ())
+    {
+      error = "cannot open " + csvPath;
+      return false;
+    }
+
+  // the lines match the ones bwm-test writes in text mode
+  std::vector<Record> records (8192);
+  while (fin)
+    {
+      fin.read (reinterpret_cast<char *> (records.data ()), records.size () * sizeof (Record));
+      uint64_t bytes = fin.gcount ();
+      if (bytes % sizeof (Record) != 0)
+        {
+          error = binaryPath + " ends with a truncated record";
+          return false;
+        }
+      for (uint64_t i = 0; i < bytes / sizeof (Record); i++)
+        {
+          const Record &record = records[i];
+          fout << record.time << "," << record.id0 << ",";
+          if (header.idNum == 2)
+            {
+              fout << record.id1 << ",";
+            }
+          if (header.integral)
+            {
+              fout << static_cast<uint64_t> (record.value) << "\n";
+            }
+          else
+            {
+              fout << record.value << "\n";
+            }
+        }
+    }
+  return fout.good ();
+}
+
+}
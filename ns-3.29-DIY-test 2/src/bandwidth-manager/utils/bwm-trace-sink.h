@@ -0,0 +1,189 @@
+#ifndef BWM_TRACE_SINK_H
+#define BWM_TRACE_SINK_H
+
+#include "ns3/object.h"
+#include "ns3/callback.h"
+#include "ns3/data-rate.h"
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief A buffered sink writing trace records to binary files
+ *
+ * Every stream is a file of fixed-width Record structs behind a Header.
+ * Records are appended to a buffer of their stream; a full buffer is handed
+ * to a background thread that writes it while the simulation goes on, so a
+ * trace callback never touches the file. Flush writes the partial buffers
+ * and waits for the writer, Close also closes the files.
+ *
+ * ConvertToCsv turns a stream into the "time,id,value" or
+ * "time,id0,id1,value" text lines the scratch scripts wrote before.
+ * The Connect methods attach the double and DataRate trace sources of the
+ * bandwidth manager, such as Rate, Usage, AllocatedFairShare and
+ * ActualFairShare, to a stream. Records written after Close are dropped.
+ */
+class BwmTraceSink : public Object
+{
+public:
+  static const uint32_t MAGIC = 0x52545742;   //!< "BWTR" in a little-endian file
+  static const uint32_t VERSION = 1;          //!< The version of the layout
+
+  /**
+   * \brief The start of a stream file
+   */
+  struct Header
+  {
+    uint32_t magic;       //!< MAGIC
+    uint32_t version;     //!< VERSION
+    uint32_t idNum;       //!< Number of id columns written to CSV, 1 or 2
+    uint32_t recordSize;  //!< sizeof (Record)
+    uint32_t integral;    //!< Whether the values are written to CSV as integers, 0 or 1
+    uint32_t reserved;    //!< Zero
+  };
+
+  /**
+   * \brief A trace record
+   */
+  struct Record
+  {
+    double time;          //!< Simulation time in seconds
+    uint32_t id0;         //!< The first id, such as a trace id
+    uint32_t id1;         //!< The second id, zero in streams with one id
+    double value;         //!< The traced value
+  };
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BwmTraceSink ();
+  ~BwmTraceSink ();
+
+  /**
+   *  Opens a new stream file
+   *  \param filePath the file to write
+   *  \param idNum the number of id columns of the stream, 1 or 2
+   *  \param integral whether the values are integers, such as a congestion window
+   *  \returns the index of the stream, or -1 if the file cannot be opened
+   */
+  uint32_t AddStream (std::string filePath, uint32_t idNum, bool integral = false);
+  /**
+   *  Appends a record to a stream with one id, does nothing once the sink is closed
+   */
+  void Write (uint32_t stream, double time, uint32_t id, double value);
+  /**
+   *  Appends a record to a stream with two ids, does nothing once the sink is closed
+   */
+  void Write (uint32_t stream, double time, uint32_t id0, uint32_t id1, double value);
+  /**
+   *  Writes all buffered records and waits until they reached the files
+   */
+  void Flush (void);
+  /**
+   *  Flushes, stops the writer thread and closes the files
+   */
+  void Close (void);
+
+  /**
+   *  Writes the current time, the id and the new value of a double trace source to a stream
+   *  \returns whether the trace source was found
+   */
+  bool ConnectDouble (Ptr<Object> object, std::string traceName, uint32_t stream, uint32_t id);
+  /**
+   *  As ConnectDouble, with an id that is looked up whenever the source fires
+   */
+  bool ConnectDouble (Ptr<Object> object, std::string traceName, uint32_t stream, Callback<uint32_t> id);
+  /**
+   *  Writes the current time, the id and the new bit rate of a DataRate trace source to a stream
+   *  \returns whether the trace source was found
+   */
+  bool ConnectDataRate (Ptr<Object> object, std::string traceName, uint32_t stream, uint32_t id);
+  /**
+   *  As ConnectDataRate, with an id that is looked up whenever the source fires
+   */
+  bool ConnectDataRate (Ptr<Object> object, std::string traceName, uint32_t stream, Callback<uint32_t> id);
+
+  /**
+   *  Converts a stream file into CSV lines
+   *  \param binaryPath the stream file
+   *  \param csvPath the text file to write
+   *  \param error set to the reason of a failure
+   *  \returns false if the stream is malformed or a file cannot be accessed
+   */
+  static bool ConvertToCsv (std::string binaryPath, std::string csvPath, std::string &error);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief An open stream file
+   */
+  struct Stream
+  {
+    std::ofstream file;               //!< The file, written by the writer thread only
+    std::vector<Record> buffer;       //!< Records not handed to the writer yet
+  };
+
+  /**
+   * \brief A full buffer waiting for the writer
+   */
+  struct Batch
+  {
+    Stream *stream;                   //!< The stream to write to
+    std::vector<Record> records;      //!< The records
+  };
+
+  /**
+   *  Hands the buffer of a stream to the writer and gives the stream an empty one
+   */
+  void Submit (Stream *stream);
+  /**
+   *  The loop of the writer thread
+   */
+  void Work (void);
+
+  /**
+   *  The id getter of a connection with a fixed id
+   */
+  static uint32_t GetFixedId (uint32_t id);
+  /**
+   *  The sink of the double trace sources connected by ConnectDouble
+   */
+  static void DoubleChanged (Ptr<BwmTraceSink> sink, uint32_t stream, Callback<uint32_t> id,
+                             double oldValue, double newValue);
+  /**
+   *  The sink of the DataRate trace sources connected by ConnectDataRate
+   */
+  static void DataRateChanged (Ptr<BwmTraceSink> sink, uint32_t stream, Callback<uint32_t> id,
+                               DataRate oldValue, DataRate newValue);
+
+  uint32_t m_bufferSize;                            //!< Records per buffer
+  std::vector<std::unique_ptr<Stream> > m_streams;  //!< The open streams
+  std::thread m_writer;                             //!< The writer thread, started with the first stream
+  std::mutex m_mutex;                               //!< Protects the queue, the free buffers and the flags
+  std::condition_variable m_wake;                   //!< Wakes the writer for a batch or stop
+  std::condition_variable m_idle;                   //!< Wakes Flush when the writer ran out of batches
+  std::deque<Batch> m_queue;                        //!< Batches waiting for the writer
+  std::vector<std::vector<Record> > m_freeBuffers;  //!< Written buffers kept for reuse
+  bool m_writing;                                   //!< Whether the writer is writing a batch
+  bool m_stopping;                                  //!< Whether the writer should exit
+};
+
+}
+
+#endif
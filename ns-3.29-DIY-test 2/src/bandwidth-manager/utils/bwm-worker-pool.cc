@@ -0,0 +1,136 @@
+#include "bwm-worker-pool.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BwmWorkerPool");
+
+BwmWorkerPool::BwmWorkerPool ()
+  : m_task (NULL),
+    m_taskNum (0),
+    m_next (0),
+    m_busy (0),
+    m_batch (0),
+    m_stopping (false)
+{
+}
+
+BwmWorkerPool::~BwmWorkerPool ()
+{
+  Stop ();
+}
+
+void
+BwmWorkerPool::Start (uint32_t threadNum)
+{
+  Stop ();
+  NS_LOG_DEBUG ("Start " << threadNum << " worker threads");
+  // batches are posted by this thread, none is in flight; a worker started
+  // by a restart must not take the last batch for a new one
+  uint64_t batch;
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_stopping = false;
+    batch = m_batch;
+  }
+  for (uint32_t i = 0; i < threadNum; i++)
+    {
+      m_threads.push_back (std::thread (&BwmWorkerPool::Work, this, batch));
+    }
+}
+
+void
+BwmWorkerPool::Stop (void)
+{
+  if (m_threads.empty ())
+    {
+      return;
+    }
+
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all ();
+  for (auto &thread : m_threads)
+    {
+      thread.join ();
+    }
+  m_threads.clear ();
+}
+
+uint32_t
+BwmWorkerPool::GetNThreads (void) const
+{
+  return m_threads.size ();
+}
+
+void
+BwmWorkerPool::Run (uint32_t taskNum, const Task &task)
+{
+  if (m_threads.empty () || taskNum <= 1)
+    {
+      // nothing to share, run the batch in the calling thread
+      for (uint32_t i = 0; i < taskNum; i++)
+        {
+          task (i);
+        }
+      return;
+    }
+
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_task = &task;
+    m_taskNum = taskNum;
+    m_next = 0;
+    m_busy = m_threads.size ();
+    m_batch++;
+  }
+  m_wake.notify_all ();
+
+  // the calling thread works on the batch as well
+  Drain ();
+
+  std::unique_lock<std::mutex> lock (m_mutex);
+  m_done.wait (lock, [this] { return m_busy == 0; });
+  m_task = NULL;
+}
+
+void
+BwmWorkerPool::Work (uint64_t batch)
+{
+  while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock (m_mutex);
+        m_wake.wait (lock, [this, batch] { return m_stopping || m_batch != batch; });
+        if (m_stopping)
+          {
+            return;
+          }
+        batch = m_batch;
+      }
+
+      Drain ();
+
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        NS_ASSERT_MSG (m_busy > 0, "A worker finished a batch it did not join");
+        m_busy--;
+      }
+      m_done.notify_one ();
+    }
+}
+
+void
+BwmWorkerPool::Drain (void)
+{
+  uint32_t i;
+  while ((i = m_next.fetch_add (1)) < m_taskNum)
+    {
+      (*m_task) (i);
+    }
+}
+
+}
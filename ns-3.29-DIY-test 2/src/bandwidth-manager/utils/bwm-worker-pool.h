@@ -0,0 +1,82 @@
+#ifndef BWM_WORKER_POOL_H
+#define BWM_WORKER_POOL_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup bandwidth-manager
+ *
+ * \brief A fixed set of threads running independent tasks of one simulator event
+ *
+ * Run hands the indexes of a batch to the workers and the calling thread,
+ * which take them one by one until the batch is exhausted, and returns once
+ * every task has finished. Tasks must only touch state owned by their index
+ * and write their results to per-index slots; the caller then merges the
+ * slots in index order, so results do not depend on the scheduling.
+ */
+class BwmWorkerPool
+{
+public:
+  /**
+   * \brief A task of a batch, called with the index of the task
+   */
+  typedef std::function<void (uint32_t)> Task;
+
+  BwmWorkerPool ();
+  ~BwmWorkerPool ();
+
+  /**
+   *  Starts the worker threads, stopping the current ones first
+   *  \param threadNum the number of worker threads besides the calling thread
+   */
+  void Start (uint32_t threadNum);
+  /**
+   *  Stops and joins the worker threads
+   */
+  void Stop (void);
+  /**
+   *  \returns the number of worker threads besides the calling thread
+   */
+  uint32_t GetNThreads (void) const;
+  /**
+   *  Runs task (i) for every i in [0, taskNum) and waits until all have finished
+   *  \param taskNum the number of tasks
+   *  \param task the task
+   */
+  void Run (uint32_t taskNum, const Task &task);
+
+private:
+  /**
+   *  The loop of a worker thread
+   *  \param batch the sequence number of the last batch posted before the
+   *  thread was started, the worker only joins later ones
+   */
+  void Work (uint64_t batch);
+  /**
+   *  Takes and runs tasks of the current batch until none is left
+   */
+  void Drain (void);
+
+  std::vector<std::thread> m_threads;   //!< The worker threads
+  std::mutex m_mutex;                   //!< Protects the batch state below
+  std::condition_variable m_wake;       //!< Wakes the workers for a new batch or stop
+  std::condition_variable m_done;       //!< Wakes the caller when the last worker finished
+  const Task *m_task;                   //!< The task of the current batch
+  uint32_t m_taskNum;                   //!< The number of tasks of the current batch
+  std::atomic<uint32_t> m_next;         //!< The next task index to take
+  uint32_t m_busy;                      //!< Workers still working on the current batch
+  uint64_t m_batch;                     //!< Sequence number of the current batch
+  bool m_stopping;                      //!< Whether the workers should exit
+};
+
+}
+
+#endif
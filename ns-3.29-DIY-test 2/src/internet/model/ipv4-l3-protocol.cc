@@ -97,6 +97,12 @@ Ipv4L3Protocol::GetTypeId (void)
                      "and is being forwarded to another node",
                      MakeTraceSourceAccessor (&Ipv4L3Protocol::m_unicastForwardTrace),
                      "ns3::Ipv4L3Protocol::SentTracedCallback")
+    .AddTraceSource ("RxHeader",
+                     "An IPv4 packet with a valid header was received "
+                     "from an incoming interface, the header is passed "
+                     "parsed and removed from the packet",
+                     MakeTraceSourceAccessor (&Ipv4L3Protocol::m_rxHeaderTrace),
+                     "ns3::Ipv4L3Protocol::SentTracedCallback")
     .AddTraceSource ("LocalDeliver",
                      "An IPv4 packet was received by/for this node, "
                      "and it is being forward up the stack",
@@ -592,6 +598,8 @@ Ipv4L3Protocol::Receive ( Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t p
       return;
     }
 
+  m_rxHeaderTrace (ipHeader, packet, interface);
+
   // the packet is valid, we update the ARP cache entry (if present)
   Ptr<ArpCache> arpCache = ipv4Interface->GetArpCache ();
   if (arpCache)
@@ -472,6 +472,8 @@ private:
   TracedCallback<const Ipv4Header &, Ptr<const Packet>, uint32_t> m_unicastForwardTrace;
   /// Trace of locally delivered packets
   TracedCallback<const Ipv4Header &, Ptr<const Packet>, uint32_t> m_localDeliverTrace;
+  /// Trace of received packets with a valid header, passed without the header
+  TracedCallback<const Ipv4Header &, Ptr<const Packet>, uint32_t> m_rxHeaderTrace;
 
   // The following two traces pass a packet with an IP header
   /// Trace of transmitted packets
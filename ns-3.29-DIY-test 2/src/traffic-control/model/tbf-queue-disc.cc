@@ -93,7 +93,7 @@ TypeId TbfQueueDisc::GetTypeId (void)
 
 TbfQueueDisc::TbfQueueDisc ()
   : QueueDisc (QueueDiscSizePolicy::SINGLE_CHILD_QUEUE_DISC),
-    m_qdiscClass (0)
+    m_throttled (false)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -107,6 +107,7 @@ void
 TbfQueueDisc::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  m_throttleCallback = MakeNullCallback<void, Time> ();
   QueueDisc::DoDispose ();
 }
 
@@ -145,7 +146,7 @@ TbfQueueDisc::SetRate (DataRate rate)
   DataRate oldRate = rate;
   m_rate = rate;
 
-  if (m_id.IsExpired () == false)
+  if (m_id.IsExpired () == false || m_throttled)
     {
       /* If there exists a scheduled event, we need to make a change */
       Ptr<const QueueDiscItem> itemPeek = GetQueueDiscClass (0)->GetQueueDisc ()->Peek ();
@@ -175,7 +176,12 @@ TbfQueueDisc::SetRate (DataRate rate)
       int64_t ptoks = m_ptokens - pktSize;
       Time requiredDelayTime;
       requiredDelayTime = std::max (m_rate.CalculateBytesTxTime (-btoks), m_peakRate.CalculateBytesTxTime (-ptoks));
-      if (requiredDelayTime == 0)
+      if (m_throttled)
+        {
+          m_throttleCallback (now + requiredDelayTime);
+          NS_LOG_LOGIC ("Eligible again in " << requiredDelayTime);
+        }
+      else if (requiredDelayTime == 0)
         {
           QueueDisc::Run ();
           NS_LOG_LOGIC ("Immediately Run");
@@ -202,7 +208,7 @@ TbfQueueDisc::SetPeakRate (DataRate peakRate)
   DataRate oldPeakRate = m_peakRate;
   m_peakRate = peakRate;
 
-  if (m_id.IsExpired () == false)
+  if (m_id.IsExpired () == false || m_throttled)
     {
       /* If there exists a scheduled event, we need to make a change */
       Ptr<const QueueDiscItem> itemPeek = GetQueueDiscClass (0)->GetQueueDisc ()->Peek ();
@@ -232,7 +238,12 @@ TbfQueueDisc::SetPeakRate (DataRate peakRate)
       int64_t ptoks = m_ptokens - pktSize;
       Time requiredDelayTime;
       requiredDelayTime = std::max (m_rate.CalculateBytesTxTime (-btoks), m_peakRate.CalculateBytesTxTime (-ptoks));
-      if (requiredDelayTime == 0)
+      if (m_throttled)
+        {
+          m_throttleCallback (now + requiredDelayTime);
+          NS_LOG_LOGIC ("Eligible again in " << requiredDelayTime);
+        }
+      else if (requiredDelayTime == 0)
         {
           QueueDisc::Run ();
           NS_LOG_LOGIC ("Immediately Run");
@@ -335,14 +346,10 @@ TbfQueueDisc::DoDequeue (void)
           m_timeCheckPoint = now;
           m_btokens = btoks;
           m_ptokens = ptoks;
+          m_throttled = false;
 
           NS_LOG_LOGIC (m_btokens << " btokens and " << m_ptokens << " ptokens after packet dequeue");
           NS_LOG_LOGIC ("Current queue size: " << GetNPackets () << " packets, " << GetNBytes () << " bytes");
-          if (m_qdiscClass)
-            {
-              NS_LOG_INFO ("Qdisc Class existed, adding usage");
-              //m_qdiscClass->AddUsage (item->GetSize ());
-            }
           return item;
         }
 
@@ -351,7 +358,16 @@ TbfQueueDisc::DoDequeue (void)
       both the ptoks and btoks are less than zero. In that case we have to 
       schedule the waking of queue when enough tokens are available. */
 
-      if (m_id.IsExpired () == true)
+      if (!m_throttleCallback.IsNull ())
+        {
+          // the parent wakes the queue disc when enough tokens are available
+          Time requiredDelayTime;
+          requiredDelayTime = std::max (m_rate.CalculateBytesTxTime (-btoks), m_peakRate.CalculateBytesTxTime (-ptoks));
+          m_throttled = true;
+          m_throttleCallback (now + requiredDelayTime);
+          NS_LOG_LOGIC ("Eligible again in " << requiredDelayTime);
+        }
+      else if (m_id.IsExpired () == true)
         {
           Time requiredDelayTime;
           requiredDelayTime = std::max (m_rate.CalculateBytesTxTime (-btoks), m_peakRate.CalculateBytesTxTime (-ptoks));
@@ -439,12 +455,13 @@ TbfQueueDisc::InitializeParams (void)
   // Initialising other variables to 0.
   m_timeCheckPoint = Seconds (0);
   m_id = EventId ();
+  m_throttled = false;
 }
 
 void
-TbfQueueDisc::SetBwmQdiscClass (Ptr<ns3::BwmQueueDiscClass> qdiscClass)
+TbfQueueDisc::SetThrottleCallback (Callback<void, Time> cb)
 {
-  m_qdiscClass = qdiscClass;
+  m_throttleCallback = cb;
 }
 
 } // namespace ns3
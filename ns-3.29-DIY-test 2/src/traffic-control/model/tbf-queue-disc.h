@@ -40,9 +40,6 @@
 
 namespace ns3 {
 
-
-class BwmQueueDiscClass;
-
 /**
  * \ingroup traffic-control
  *
@@ -143,9 +140,15 @@ public:
   uint32_t GetSecondBucketTokens (void) const;
 
   /**
-    * \brief Configure the designated qdisc class
+    * \brief Hand the waking of this queue disc over to its parent.
+    *
+    * Once set, a blocked dequeue, or a rate change while blocked, reports the
+    * time the head packet becomes eligible to the callback instead of
+    * scheduling a waking event that runs this queue disc.
+    *
+    * \param cb The callback taking the next eligible time.
     */
-  void SetBwmQdiscClass (Ptr<ns3::BwmQueueDiscClass> qdiscClass);
+  void SetThrottleCallback (Callback<void, Time> cb);
 
 protected:
   /**
@@ -171,9 +174,8 @@ private:
   TracedValue<uint32_t> m_ptokens; //!< Current number of tokens in second bucket
   Time m_timeCheckPoint;           //!< Time check-point
   EventId m_id;                    //!< EventId of the scheduled queue waking event when enough tokens are available
-
-  /* extra control path parameters for BwM components*/
-  Ptr<ns3::BwmQueueDiscClass> m_qdiscClass; //!< The pointer to the qdisc class
+  Callback<void, Time> m_throttleCallback; //!< Callback reporting the next eligible time, replaces the waking event
+  bool m_throttled;                //!< Whether the parent has been told the queue disc is blocked
 };
 
 } // namespace ns3